@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/ptrace.h>
+#endif
+
+#include "remind.h"
+
+#define MAX_PATH_SIZE 512
+
+// Colors
+#define GREEN "\033[0;32m"
+#define YELLOW "\033[1;33m"
+#define NC "\033[0m"
+
+static char binary_path[PATH_MAX] = "./bin/remind";
+static char output_path[MAX_PATH_SIZE] = "./bin/bench.json";
+static char bench_home[MAX_PATH_SIZE];
+static char remind_file[MAX_PATH_SIZE + 64];
+static long max_lines = 1000000;
+static long search_lines = 0;
+/// Where the measured program's stdout goes. GNU grep stops at the first
+/// match when it sees /dev/null there, so search comparisons use a file.
+static char stdout_path[MAX_PATH_SIZE + 64] = "/dev/null";
+
+/// The pristine list lives in a template file next to the real one rather
+/// than in memory: forked children inherit our RSS until they exec, which
+/// would otherwise show up in their ru_maxrss.
+static char template_file[MAX_PATH_SIZE + 64];
+static size_t list_size;
+static long list_lines;
+
+typedef struct {
+    const char *name;
+    double *samples_us;
+    int count;
+    long max_rss_kb;
+    long syscalls;
+} Result;
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/// Generates `lines` reminders with lengths between 8 and 120 characters
+/// from a fixed seed, so every run measures the same bytes
+void generate_list(long lines) {
+    FILE *fp = fopen(template_file, "w");
+    if (!fp) {
+        perror(template_file);
+        exit(1);
+    }
+    static const char words[] = "review deploy call email write fix check buy plan read ship test ";
+    uint32_t seed = 2463534242u;
+    char line[160];
+    list_size = 0;
+    for (long i = 0; i < lines; i++) {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        int length = 8 + (int) (seed % 113);
+        int prefix = sprintf(line, "item %ld ", i + 1);
+        for (int j = prefix; j < length; j++) {
+            line[j] = words[(seed + j) % (sizeof(words) - 1)];
+        }
+        int total = length > prefix ? length : prefix;
+        line[total++] = '\n';
+        fwrite(line, 1, total, fp);
+        list_size += total;
+    }
+    fclose(fp);
+    list_lines = lines;
+}
+
+/// Deletes the file kept beside the list under suffix
+void remove_sidecar(const char *suffix) {
+    char path[sizeof(remind_file) + 16];
+    snprintf(path, sizeof(path), "%s%s", remind_file, suffix);
+    unlink(path);
+}
+
+/// Copies the pristine list back, dating it an hour back so remind treats
+/// it as settled and is willing to cache it
+void restore_list() {
+    int in = open(template_file, O_RDONLY);
+    int out = open(remind_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (in < 0 || out < 0) {
+        perror("open");
+        exit(1);
+    }
+    char buf[64 * 1024];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, n) != n) {
+            perror("write");
+            exit(1);
+        }
+    }
+    close(in);
+    close(out);
+    // Tombstones name the inode, which the rewrite above keeps
+    remove_sidecar(".tomb");
+
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 3600;
+    times[1] = times[0];
+    utimes(remind_file, times);
+}
+
+/// Runs program (remind, or a tool to compare it with) once with stdin and
+/// stdout on /dev/null. Returns the wall time in microseconds and the
+/// child's peak RSS in kilobytes.
+double run_once(const char *program, char *const args[], long *rss_kb) {
+    double start = now_us();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        int out_fd = open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        execvp(program, args);
+        _exit(127);
+    }
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    double elapsed = now_us() - start;
+#ifdef __APPLE__
+    *rss_kb = usage.ru_maxrss / 1024;
+#else
+    *rss_kb = usage.ru_maxrss;
+#endif
+    return elapsed;
+}
+
+/// Counts the system calls made by one run by stopping the child at every
+/// syscall entry and exit with ptrace. Not timed: tracing is far too slow.
+long count_syscalls(const char *program, char *const args[]) {
+#ifdef __linux__
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        int out_fd = open(stdout_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        ptrace(PTRACE_TRACEME, 0, NULL, NULL);
+        raise(SIGSTOP);
+        execvp(program, args);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFSTOPPED(status)) return -1;
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *) PTRACE_O_TRACESYSGOOD);
+
+    long stops = 0;
+    for (;;) {
+        if (ptrace(PTRACE_SYSCALL, pid, NULL, NULL) != 0) break;
+        if (waitpid(pid, &status, 0) < 0 || WIFEXITED(status) || WIFSIGNALED(status)) break;
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80)) stops++;
+    }
+    // Every call stops on entry and exit except the final exit_group; the
+    // execv that starts the binary is not remind's own and is dropped
+    return (stops + 1) / 2 - 1;
+#else
+    (void) program;
+    (void) args;
+    return -1;
+#endif
+}
+
+int compare_doubles(const void *a, const void *b) {
+    double da = *(const double *) a, db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+double percentile(const Result *r, double p) {
+    int index = (int) (p * (r->count - 1) + 0.5);
+    return r->samples_us[index];
+}
+
+typedef enum {
+    PREP_NONE,          // state carries over between iterations
+    PREP_RESTORE,       // fresh list every iteration
+    PREP_DROP_CACHE,    // same list, render cache removed
+    PREP_DROP_COUNT     // same list, stored count removed
+} Prep;
+
+void prepare(Prep prep) {
+    switch (prep) {
+        case PREP_NONE: break;
+        case PREP_RESTORE: restore_list(); break;
+        case PREP_DROP_CACHE: remove_sidecar(".cache"); break;
+        case PREP_DROP_COUNT: remove_sidecar(".count"); break;
+    }
+}
+
+/// Times `iterations` runs of one program; prep runs before each one and
+/// is not included in the measurement
+Result bench_program(const char *name, const char *program, char *const args[], Prep prep, int iterations) {
+    Result r = { .name = name, .count = iterations };
+    r.samples_us = malloc(iterations * sizeof(double));
+
+    // Warm-up run so the page cache and any derived files are in place
+    prepare(prep);
+    long rss;
+    run_once(program, args, &rss);
+
+    for (int i = 0; i < iterations; i++) {
+        prepare(prep);
+        r.samples_us[i] = run_once(program, args, &rss);
+        if (rss > r.max_rss_kb) r.max_rss_kb = rss;
+    }
+    qsort(r.samples_us, r.count, sizeof(double), compare_doubles);
+
+    prepare(prep);
+    r.syscalls = count_syscalls(program, args);
+    return r;
+}
+
+void report(FILE *json, const Result *r);
+
+Result bench_op(const char *name, char *const args[], Prep prep, int iterations) {
+    return bench_program(name, binary_path, args, prep, iterations);
+}
+
+/// remind -s against grep -n over the same list, for a literal, a
+/// case-insensitive literal and a regex. The patterns match a handful of
+/// lines, so the scan rather than the output is what gets measured.
+void bench_search(FILE *json, int iterations) {
+    const char *literal = "77777";
+    const char *folded = "ITEM 77777";
+    const char *regex = "^item [0-9]*7777 (review|deploy)";
+    char *search[] = { "remind", "-s", (char *) literal, NULL };
+    char *search_icase[] = { "remind", "-s", (char *) folded, "-i", NULL };
+    char *search_regex[] = { "remind", "-s", (char *) regex, NULL };
+    char *grep[] = { "grep", "-n", (char *) literal, remind_file, NULL };
+    char *grep_icase[] = { "grep", "-n", "-i", (char *) folded, remind_file, NULL };
+    char *grep_regex[] = { "grep", "-n", "-E", (char *) regex, remind_file, NULL };
+
+    // grep in the C locale, as remind matches bytes
+    snprintf(stdout_path, sizeof(stdout_path), "%s/search.out", bench_home);
+    setenv("LC_ALL", "C", 1);
+    Result results[8] = {
+        bench_op("search", search, PREP_NONE, iterations),
+        bench_op("search_icase", search_icase, PREP_NONE, iterations),
+        bench_op("search_regex", search_regex, PREP_NONE, iterations),
+        bench_program("grep", "grep", grep, PREP_NONE, iterations),
+        bench_program("grep_icase", "grep", grep_icase, PREP_NONE, iterations),
+        bench_program("grep_regex", "grep", grep_regex, PREP_NONE, iterations),
+    };
+    // The same literals through reminders.trigrams, built by the warm-up run
+    setenv("REMIND_TRIGRAMS", "1", 1);
+    results[6] = bench_op("search_trigram", search, PREP_NONE, iterations);
+    results[7] = bench_op("search_tri_icase", search_icase, PREP_NONE, iterations);
+    unsetenv("REMIND_TRIGRAMS");
+    remove_sidecar(".trigrams");
+    unsetenv("LC_ALL");
+    snprintf(stdout_path, sizeof(stdout_path), "/dev/null");
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        report(json, &results[i]);
+        free(results[i].samples_us);
+    }
+}
+
+typedef enum {
+    LIB_RENDER,
+    LIB_COUNT_LINES,
+    LIB_FIND_MIDDLE,
+    LIB_SEEK_MIDDLE,
+    LIB_ITERATE
+} LibOp;
+
+/// Times one libremind function in-process on the mapped list, with no
+/// process start-up or I/O in the measurement
+Result bench_lib(const char *name, const RemindList *list, LibOp op, int iterations) {
+    Result r = { .name = name, .count = iterations, .max_rss_kb = -1, .syscalls = -1 };
+    r.samples_us = malloc(iterations * sizeof(double));
+    volatile uint64_t sink = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        double start = now_us();
+        switch (op) {
+            case LIB_RENDER: {
+                Output out = { .fd = -1 };
+                remind_render(&out, list->data, list->size);
+                sink += out.len;
+                output_free(&out);
+                break;
+            }
+            case LIB_COUNT_LINES:
+                sink += remind_count_lines(list->data, list->size);
+                break;
+            case LIB_FIND_MIDDLE: {
+                size_t begin, end;
+                remind_find_line(list->data, list->size, (list_lines + 1) / 2, &begin, &end);
+                sink += begin;
+                break;
+            }
+            case LIB_SEEK_MIDDLE: {
+                // Through reminders.index, built on the first iteration
+                RemindLine line;
+                long target = (list_lines + 1) / 2;
+                remind_seek_line(list, remind_file, target, &line);
+                while (line.number < target && remind_next_line(list, &line)) {}
+                sink += line.len;
+                break;
+            }
+            case LIB_ITERATE: {
+                RemindLine line = {0};
+                while (remind_next_line(list, &line)) sink += line.len;
+                break;
+            }
+        }
+        r.samples_us[i] = now_us() - start;
+    }
+    qsort(r.samples_us, r.count, sizeof(double), compare_doubles);
+    return r;
+}
+
+void report(FILE *json, const Result *r) {
+    printf("  %-16s %10.1f %10.1f %10.1f %10ld %9ld\n", r->name,
+           r->samples_us[0], percentile(r, 0.5), percentile(r, 0.99),
+           r->max_rss_kb, r->syscalls);
+    fprintf(json,
+            "{\"lines\":%ld,\"bytes\":%zu,\"op\":\"%s\",\"iterations\":%d,"
+            "\"min_us\":%.1f,\"median_us\":%.1f,\"p99_us\":%.1f,"
+            "\"max_rss_kb\":%ld,\"syscalls\":%ld}\n",
+            list_lines, list_size, r->name, r->count,
+            r->samples_us[0], percentile(r, 0.5), percentile(r, 0.99),
+            r->max_rss_kb, r->syscalls);
+    fflush(json);
+}
+
+/// Fewer iterations for bigger lists keeps a full run to a few minutes
+int iterations_for(long lines) {
+    if (lines <= 1000) return 200;
+    if (lines <= 10000) return 100;
+    if (lines <= 100000) return 30;
+    return 10;
+}
+
+void bench_size(FILE *json, long lines) {
+    generate_list(lines);
+    restore_list();
+    remove_sidecar(".cache");
+    remove_sidecar(".count");
+
+    int iterations = iterations_for(lines);
+    printf(YELLOW "%ld lines (%zu bytes), %d iterations" NC "\n", lines, list_size, iterations);
+    printf("  %-16s %10s %10s %10s %10s %9s\n", "op", "min us", "median us", "p99 us", "rss kb", "syscalls");
+
+    char middle[32], last[32];
+    snprintf(middle, sizeof(middle), "%ld", (lines + 1) / 2);
+    snprintf(last, sizeof(last), "%ld", lines);
+
+    char *check[] = { "remind", "-c", NULL };
+    char *count[] = { "remind", "--count", NULL };
+    char *quiet[] = { "remind", "-q", NULL };
+    char *add[] = { "remind", "-a", "benchmark reminder", NULL };
+    char *delete_first[] = { "remind", "-d", "1", NULL };
+    char *delete_middle[] = { "remind", "-d", middle, NULL };
+    char *delete_last[] = { "remind", "-d", last, NULL };
+
+    Result results[] = {
+        bench_op("check", check, PREP_NONE, iterations),
+        bench_op("check_uncached", check, PREP_DROP_CACHE, iterations),
+        bench_op("count", count, PREP_NONE, iterations),
+        bench_op("count_uncached", count, PREP_DROP_COUNT, iterations),
+        bench_op("quiet", quiet, PREP_NONE, iterations),
+        bench_op("delete_first", delete_first, PREP_RESTORE, iterations),
+        bench_op("delete_middle", delete_middle, PREP_RESTORE, iterations),
+        bench_op("delete_last", delete_last, PREP_RESTORE, iterations),
+        bench_op("add", add, PREP_NONE, iterations),
+    };
+    // The optional storage engines. Chunked deletes carry on from the
+    // previous one so the one-off import stays in the warm-up run.
+    Result storage_results[2];
+    setenv("REMIND_STORAGE", "log", 1);
+    storage_results[0] = bench_op("delete_mid_log", delete_middle, PREP_RESTORE, iterations);
+    setenv("REMIND_STORAGE", "chunked", 1);
+    restore_list();
+    storage_results[1] = bench_op("delete_mid_chunk", delete_middle, PREP_NONE, iterations);
+    unsetenv("REMIND_STORAGE");
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+        report(json, &results[i]);
+        free(results[i].samples_us);
+    }
+    for (size_t i = 0; i < sizeof(storage_results) / sizeof(storage_results[0]); i++) {
+        report(json, &storage_results[i]);
+        free(storage_results[i].samples_us);
+    }
+    restore_list();
+    bench_search(json, iterations);
+
+    // The same list through libremind directly, to profile the hot paths
+    restore_list();
+    RemindList list;
+    if (remind_list_open(&list, remind_file) == 0) {
+        Result lib_results[] = {
+            bench_lib("lib_render", &list, LIB_RENDER, iterations),
+            bench_lib("lib_count", &list, LIB_COUNT_LINES, iterations),
+            bench_lib("lib_find_mid", &list, LIB_FIND_MIDDLE, iterations),
+            bench_lib("lib_seek_mid", &list, LIB_SEEK_MIDDLE, iterations),
+            bench_lib("lib_iterate", &list, LIB_ITERATE, iterations),
+        };
+        for (size_t i = 0; i < sizeof(lib_results) / sizeof(lib_results[0]); i++) {
+            report(json, &lib_results[i]);
+            free(lib_results[i].samples_us);
+        }
+        remind_list_close(&list);
+    }
+    printf("\n");
+}
+
+void print_usage() {
+    printf("Usage: bench_remind [-b BINARY] [-o OUTPUT] [-n MAX_LINES] [-g LINES]\n\n");
+    printf("    -b BINARY     remind binary to measure (default ./bin/remind)\n");
+    printf("    -o OUTPUT     JSON lines results file (default ./bin/bench.json)\n");
+    printf("    -n MAX_LINES  largest list size to run (default 1000000)\n");
+    printf("    -g LINES      also compare -s with grep on a list of LINES lines\n");
+    printf("                  (5000000 is about 320 MB)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    while ((opt = getopt(argc, argv, "b:o:n:g:h")) != -1) {
+        switch (opt) {
+            case 'b': snprintf(binary_path, sizeof(binary_path), "%s", optarg); break;
+            case 'o': snprintf(output_path, sizeof(output_path), "%s", optarg); break;
+            case 'n': max_lines = strtol(optarg, NULL, 10); break;
+            case 'g': search_lines = strtol(optarg, NULL, 10); break;
+            default: print_usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (access(binary_path, X_OK) != 0) {
+        fprintf(stderr, "Error: %s not found. Run 'make' first.\n", binary_path);
+        return 1;
+    }
+    // Report the binary by its full path so result files are unambiguous
+    char resolved[PATH_MAX];
+    if (realpath(binary_path, resolved)) {
+        snprintf(binary_path, sizeof(binary_path), "%s", resolved);
+    }
+
+    snprintf(bench_home, sizeof(bench_home), "/tmp/remind_bench_%d", getpid());
+    snprintf(remind_file, sizeof(remind_file), "%s/.local/state/remind/reminders", bench_home);
+    snprintf(template_file, sizeof(template_file), "%s/template", bench_home);
+    char cmd[MAX_PATH_SIZE + 32];
+    snprintf(cmd, sizeof(cmd), "mkdir -p %s/.local/state/remind", bench_home);
+    if (system(cmd) != 0 || setenv("HOME", bench_home, 1) != 0) {
+        fprintf(stderr, "Failed to set up benchmark home\n");
+        return 1;
+    }
+
+    FILE *json = fopen(output_path, "w");
+    if (!json) {
+        perror(output_path);
+        return 1;
+    }
+
+    printf("Benchmarks for %s\n", binary_path);
+    printf("==============================================\n");
+    static const long sizes[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && sizes[i] <= max_lines; i++) {
+        bench_size(json, sizes[i]);
+    }
+    if (search_lines > 0) {
+        generate_list(search_lines);
+        restore_list();
+        printf(YELLOW "%ld lines (%zu bytes), search only, 5 iterations" NC "\n", list_lines, list_size);
+        printf("  %-16s %10s %10s %10s %10s %9s\n", "op", "min us", "median us", "p99 us", "rss kb", "syscalls");
+        bench_search(json, 5);
+        printf("\n");
+    }
+    fclose(json);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", bench_home);
+    system(cmd);
+    printf(GREEN "Results written to %s" NC "\n", output_path);
+    return 0;
+}
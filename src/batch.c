@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/file.h>
+
+#include "remind.h"
+
+/*
+ * remind --batch: runs a script of commands against one copy of the list.
+ *
+ *     add TEXT          append TEXT as a new reminder
+ *     delete SPEC       delete reminders, SPEC as for -d (2 or 1,4,7-9)
+ *     move N M          move reminder N so that it becomes reminder M
+ *     edit N TEXT       replace the text of reminder N
+ *     check             print the list as it stands, as -c would
+ *
+ * Blank lines and lines starting with # are skipped. Every command sees the
+ * list as the commands before it left it, exactly as if each had been run
+ * as its own remind command; within one delete, all numbers refer to the
+ * list before that delete, as with -d.
+ *
+ * The list is loaded once under the exclusive lock, every command works on
+ * an array of lines in memory, and the result is written with a single
+ * write() and rename()d into place before the lock is released; a chunked
+ * list is written back as chunks, and a batch that changes nothing writes
+ * nothing. A batch is all or nothing: a command that fails stops it with
+ * nothing written, and the output of its check commands is held back
+ * until every command has succeeded, so none is printed either.
+ */
+
+/// One reminder of the list being edited. New text lives in the batch's
+/// own buffer, which may move as it grows, so it is kept as an offset.
+typedef struct {
+    const char *text;   // in the mapped list, or NULL when added
+    size_t offset;      // into Batch.added when text is NULL
+    size_t len;
+} BatchLine;
+
+typedef struct {
+    BatchLine *lines;
+    size_t count;
+    size_t cap;
+    Output added;
+    Output checks;      // check output, printed once the batch succeeds
+    bool changed;
+} Batch;
+
+static const char *line_text(const Batch *batch, const BatchLine *line) {
+    return line->text ? line->text : batch->added.data + line->offset;
+}
+
+static bool reserve_lines(Batch *batch, size_t extra) {
+    if (batch->count + extra <= batch->cap) return true;
+    size_t cap = batch->cap ? batch->cap : 64;
+    while (cap < batch->count + extra) cap *= 2;
+    remind_trace.allocations++;
+    BatchLine *lines = realloc(batch->lines, cap * sizeof(*lines));
+    if (!lines) {
+        perror("realloc");
+        return false;
+    }
+    batch->lines = lines;
+    batch->cap = cap;
+    return true;
+}
+
+/// Formats text like -a does and points line at it
+static bool store_text(Batch *batch, const char *text, size_t len, BatchLine *line) {
+    size_t offset = batch->added.len;
+    remind_format(&batch->added, text, len);
+    if (batch->added.len == offset) return false;
+    *line = (BatchLine) { .text = NULL, .offset = offset, .len = batch->added.len - offset - 1 };
+    return true;
+}
+
+/// Joins the lines back into list text, each ending in a newline
+static void join_lines(const Batch *batch, Output *out) {
+    size_t total = 0;
+    for (size_t i = 0; i < batch->count; i++) total += batch->lines[i].len + 1;
+    if (!output_reserve(out, total)) return;
+    for (size_t i = 0; i < batch->count; i++) {
+        output_append(out, line_text(batch, &batch->lines[i]), batch->lines[i].len);
+        output_append(out, "\n", 1);
+    }
+}
+
+/// Adds what -c would show for the list as it stands to the batch's output
+static int batch_check(Batch *batch) {
+    Output text = { .fd = -1 };
+    join_lines(batch, &text);
+
+    // Scheduled lines are judged directly: the heap belongs to the file
+    remind_trace.allocations++;
+    uint32_t *hidden = malloc((batch->count ? batch->count : 1) * sizeof(*hidden));
+    if (!hidden) {
+        perror("malloc");
+        output_free(&text);
+        return -1;
+    }
+    size_t hidden_count = 0;
+    int64_t now = (int64_t) time(NULL);
+    for (size_t i = 0; i < batch->count; i++) {
+        Schedule schedule;
+        int64_t change;
+        const BatchLine *line = &batch->lines[i];
+        if (remind_schedule_parse(line_text(batch, line), line->len, &schedule) &&
+            !remind_schedule_shown(&schedule, now, &change)) {
+            hidden[hidden_count++] = (uint32_t) (i + 1);
+        }
+    }
+
+    RemindList list = { .data = text.data, .size = text.len, .lock_fd = -1 };
+    if (text.len > 0) remind_render_shown(&batch->checks, &list, hidden, hidden_count);
+    free(hidden);
+    output_free(&text);
+    return 0;
+}
+
+/// Parses a reminder number that must exist in the list as it stands
+static bool parse_number(const Batch *batch, const char **s, size_t *index) {
+    char *end;
+    errno = 0;
+    long n = strtol(*s, &end, 10);
+    if (end == *s || errno != 0 || n < 1 || (size_t) n > batch->count) return false;
+    *index = (size_t) n - 1;
+    *s = end;
+    return true;
+}
+
+static const char *skip_space(const char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    return s;
+}
+
+/// Applies one command line (NUL-terminated, without its newline). Returns
+/// an error message, or NULL when the command succeeded.
+static const char *run_command(Batch *batch, const char *command) {
+    const char *args = command;
+    while (*args && *args != ' ' && *args != '\t') args++;
+    size_t name_len = (size_t) (args - command);
+    args = skip_space(args);
+
+    if (name_len == 3 && strncmp(command, "add", 3) == 0) {
+        if (!reserve_lines(batch, 1)) return "out of memory";
+        if (*args == '\0' || !store_text(batch, args, strlen(args), &batch->lines[batch->count])) {
+            return "add needs some text";
+        }
+        batch->count++;
+    } else if (name_len == 6 && strncmp(command, "delete", 6) == 0) {
+        LineSet set = {0};
+        if (!line_set_parse(&set, args)) return "delete needs line numbers, as for -d";
+        if (set.count > 0 && set.ranges[set.count - 1].last > (long) batch->count) {
+            line_set_free(&set);
+            return "no such reminder";
+        }
+        // Every number refers to the list before this delete
+        size_t kept = 0;
+        int r = 0;
+        for (size_t i = 0; i < batch->count; i++) {
+            long number = (long) i + 1;
+            while (r < set.count && set.ranges[r].last < number) r++;
+            if (r < set.count && set.ranges[r].first <= number) continue;
+            batch->lines[kept++] = batch->lines[i];
+        }
+        line_set_free(&set);
+        batch->count = kept;
+    } else if (name_len == 4 && strncmp(command, "move", 4) == 0) {
+        size_t from, to;
+        if (!parse_number(batch, &args, &from)) return "move needs the number of a reminder";
+        args = skip_space(args);
+        if (!parse_number(batch, &args, &to) || *skip_space(args) != '\0') return "move needs a number to move it to";
+        BatchLine moved = batch->lines[from];
+        if (from < to) {
+            memmove(&batch->lines[from], &batch->lines[from + 1], (to - from) * sizeof(moved));
+        } else {
+            memmove(&batch->lines[to + 1], &batch->lines[to], (from - to) * sizeof(moved));
+        }
+        batch->lines[to] = moved;
+    } else if (name_len == 4 && strncmp(command, "edit", 4) == 0) {
+        size_t index;
+        if (!parse_number(batch, &args, &index)) return "edit needs the number of a reminder";
+        if (*args != ' ' && *args != '\t') return "edit needs some text";
+        args = skip_space(args);
+        if (*args == '\0' || !store_text(batch, args, strlen(args), &batch->lines[index])) {
+            return "edit needs some text";
+        }
+    } else if (name_len == 5 && strncmp(command, "check", 5) == 0 && *args == '\0') {
+        if (batch_check(batch) != 0) return "could not print the list";
+        return NULL;
+    } else {
+        return "unknown command";
+    }
+    batch->changed = true;
+    return NULL;
+}
+
+/// Loads the live lines of a list opened under the lock
+static bool load_lines(Batch *batch, const RemindList *list) {
+    RemindLine line = {0};
+    while (remind_next_line(list, &line)) {
+        if (!reserve_lines(batch, 1)) return false;
+        batch->lines[batch->count++] = (BatchLine) { .text = line.text, .len = line.len };
+    }
+    return true;
+}
+
+/// Writes the batch's list in place of the old one, in the layout it was
+/// read from, and retires anything that described the old one
+static int save_lines(const Batch *batch, const char *file_path, bool chunked) {
+    Output text = { .fd = -1 };
+    join_lines(batch, &text);
+    int rc;
+    if (chunked) {
+        rc = remind_chunks_replace(file_path, text.data, text.len);
+    } else {
+        struct iovec part = { text.data, text.len };
+        rc = remind_replace_file(file_path, &part, 1, true);
+    }
+    output_free(&text);
+    if (rc != 0 || chunked) return rc != 0 ? -1 : 0;
+
+    // The new inode already orphans the tombstones; drop the file as well
+    char tomb_path[PATH_MAX];
+    if (remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb") &&
+        TRACED(unlink(tomb_path)) != 0 && errno != ENOENT) {
+        perror(tomb_path);
+    }
+    return 0;
+}
+
+/// Runs the commands in script (see above) against the list, printing the
+/// output of check commands to out_fd once they have all succeeded.
+/// Returns -1, with nothing changed or printed, when any command fails.
+int remind_batch(const char *file_path, const char *script, size_t len, int out_fd) {
+    // Commands work on the live lines of whichever layout the list is in;
+    // tombstones need no step of their own, since the list is rewritten
+    int lock_fd = remind_lock(file_path, LOCK_EX);
+    if (lock_fd < 0) {
+        fprintf(stderr, "remind: could not lock %s\n", file_path);
+        fprintf(stderr, "remind: nothing was changed\n");
+        return -1;
+    }
+    struct stat st;
+    // Chunks are only read while there is no plain file (see chunks.c)
+    bool chunked = TRACED(stat(file_path, &st)) != 0 && remind_chunks_stat(file_path, &st) == 0;
+    RemindList list = { .lock_fd = -1 };
+    if (remind_list_stat(file_path, &st) == 0 && remind_list_open_locked(&list, file_path) != 0) {
+        remind_unlock(lock_fd);
+        return -1;
+    }
+
+    Batch batch = { .added = { .fd = -1 }, .checks = { .fd = -1 } };
+    int rc = load_lines(&batch, &list) ? 0 : -1;
+    char *command = NULL;
+    size_t command_cap = 0;
+    long lineno = 0;
+    const char *stop = script + len;
+    for (const char *p = script; rc == 0 && p < stop; ) {
+        const char *nl = memchr(p, '\n', stop - p);
+        const char *line_end = nl ? nl : stop;
+        size_t line_len = (size_t) (line_end - p);
+        if (line_len > 0 && p[line_len - 1] == '\r') line_len--;
+        lineno++;
+
+        // A NUL-terminated copy, so commands can use the string functions
+        if (line_len + 1 > command_cap) {
+            command_cap = line_len + 1;
+            remind_trace.allocations++;
+            char *grown = realloc(command, command_cap);
+            if (!grown) {
+                perror("realloc");
+                rc = -1;
+                break;
+            }
+            command = grown;
+        }
+        memcpy(command, p, line_len);
+        command[line_len] = '\0';
+        p = line_end + 1;
+
+        const char *start = skip_space(command);
+        if (*start == '\0' || *start == '#') continue;
+        const char *error = run_command(&batch, start);
+        if (error) {
+            fprintf(stderr, "remind: batch line %ld: %s: %s\n", lineno, error, start);
+            fprintf(stderr, "remind: nothing was changed\n");
+            rc = -1;
+        }
+    }
+
+    if (rc == 0 && batch.changed) {
+        rc = save_lines(&batch, file_path, chunked);
+    }
+    if (rc == 0 && batch.checks.len > 0 && write_all(out_fd, batch.checks.data, batch.checks.len) != 0) {
+        perror("write");
+        rc = -1;
+    }
+    free(command);
+    free(batch.lines);
+    output_free(&batch.added);
+    output_free(&batch.checks);
+    remind_list_close(&list);
+    remind_unlock(lock_fd);
+    return rc;
+}
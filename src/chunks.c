@@ -0,0 +1,662 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "remind.h"
+
+/*
+ * Chunked storage. With REMIND_STORAGE=chunked the list moves from the
+ * single reminders file into reminders.chunks/: numbered chunk files of
+ * about CHUNK_TARGET_SIZE bytes, each holding whole lines, and a manifest
+ * giving their order, line counts and sizes. A delete finds the chunks
+ * that hold its lines from the running line totals and rewrites only
+ * those, so its cost no longer depends on how long the list is.
+ *
+ * The manifest is the commit point. A rewritten chunk is written under a
+ * fresh id and the manifest renamed over the old one before the old chunk
+ * is removed, and appends extend the last chunk in place but readers only
+ * ever read the byte count the manifest records. A crash therefore leaves
+ * either the old list or the new one.
+ *
+ * The plain reminders file, when present, always wins: chunks are only
+ * read while it is missing. Moving between the layouts removes the old one
+ * last, so an interrupted conversion just happens again.
+ */
+
+/// Header of reminders.chunks/manifest, followed by one ChunkEntry per chunk
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t count;
+    uint32_t next_id;
+} ChunkHeader;
+
+typedef struct {
+    uint32_t id;
+    uint32_t lines;
+    uint64_t bytes;
+} ChunkEntry;
+
+typedef struct {
+    ChunkHeader header;
+    ChunkEntry *entries;
+    int cap;
+} Manifest;
+
+#define CHUNK_MAGIC "RMDCHUNK"
+#define CHUNK_VERSION 1
+
+/// True when REMIND_STORAGE asks for the chunked layout
+bool remind_chunked_storage(void) {
+    const char *v = getenv("REMIND_STORAGE");
+    return v && strcmp(v, "chunked") == 0;
+}
+
+static bool chunk_dir_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".chunks");
+}
+
+static bool manifest_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".chunks/manifest");
+}
+
+static bool chunk_path(char *out, size_t out_size, const char *file_path, uint32_t id) {
+    return snprintf(out, out_size, "%s.chunks/%08x", file_path, id) < (int) out_size;
+}
+
+/// Stats the manifest of a chunked list. st_size is reduced to the size of
+/// the chunk table, so like a plain list 0 means there is nothing to show,
+/// and the rest of the stamp changes with every rewrite of the manifest.
+int remind_chunks_stat(const char *file_path, struct stat *st) {
+    char path[PATH_MAX];
+    if (!manifest_path(path, sizeof(path), file_path) || TRACED(stat(path, st)) != 0) {
+        return -1;
+    }
+    st->st_size = st->st_size > (off_t) sizeof(ChunkHeader) ? st->st_size - (off_t) sizeof(ChunkHeader) : 0;
+    return 0;
+}
+
+static void manifest_free(Manifest *m) {
+    free(m->entries);
+    m->entries = NULL;
+    m->cap = 0;
+}
+
+static bool manifest_push(Manifest *m, ChunkEntry entry) {
+    if ((int) m->header.count == m->cap) {
+        int cap = m->cap ? m->cap * 2 : 16;
+        remind_trace.allocations++;
+        ChunkEntry *entries = realloc(m->entries, cap * sizeof(*entries));
+        if (!entries) {
+            perror("realloc");
+            return false;
+        }
+        m->entries = entries;
+        m->cap = cap;
+    }
+    m->entries[m->header.count++] = entry;
+    return true;
+}
+
+static void manifest_init(Manifest *m, uint32_t next_id) {
+    memset(m, 0, sizeof(*m));
+    memcpy(m->header.magic, CHUNK_MAGIC, sizeof(m->header.magic));
+    m->header.version = CHUNK_VERSION;
+    m->header.header_size = sizeof(m->header);
+    m->header.next_id = next_id;
+}
+
+/// Loads the manifest. Returns 1 when there is none, so callers can tell a
+/// plain list from a damaged chunked one (-1).
+static int manifest_load(Manifest *m, const char *file_path, struct stat *st) {
+    char path[PATH_MAX];
+    if (!manifest_path(path, sizeof(path), file_path)) return -1;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        if (errno == ENOENT) return 1;
+        perror(path);
+        return -1;
+    }
+
+    struct stat manifest_st;
+    if (TRACED(fstat(fd, &manifest_st)) != 0) {
+        perror("fstat");
+        TRACED(close(fd));
+        return -1;
+    }
+    size_t size = (size_t) manifest_st.st_size;
+    manifest_init(m, 0);
+    ChunkHeader header = { 0 };
+    ssize_t n = TRACED(read(fd, &header, sizeof(header)));
+    m->header = header;
+    size_t table = (size_t) m->header.count * sizeof(ChunkEntry);
+    if (n != (ssize_t) sizeof(m->header) ||
+        memcmp(m->header.magic, CHUNK_MAGIC, sizeof(m->header.magic)) != 0 ||
+        m->header.version != CHUNK_VERSION ||
+        m->header.header_size != sizeof(m->header) ||
+        size != sizeof(m->header) + table) {
+        fprintf(stderr, "%s: not a chunk manifest\n", path);
+        TRACED(close(fd));
+        return -1;
+    }
+
+    m->cap = (int) m->header.count;
+    remind_trace.allocations++;
+    m->entries = malloc(table ? table : 1);
+    n = m->entries ? TRACED(read(fd, m->entries, table)) : -1;
+    TRACED(close(fd));
+    if (n != (ssize_t) table) {
+        perror(path);
+        manifest_free(m);
+        return -1;
+    }
+    remind_trace.bytes_read += sizeof(m->header) + table;
+    if (st) {
+        *st = manifest_st;
+        st->st_size = (off_t) table;
+    }
+    return 0;
+}
+
+static int manifest_save(const Manifest *m, const char *file_path) {
+    char path[PATH_MAX];
+    if (!manifest_path(path, sizeof(path), file_path)) return -1;
+    struct iovec parts[] = {
+        { (void *) &m->header, sizeof(m->header) },
+        { m->entries, m->header.count * sizeof(ChunkEntry) },
+    };
+    return remind_replace_file(path, parts, 2, true);
+}
+
+/// Reads the first `bytes` bytes of a chunk into dest
+static int chunk_read(const char *file_path, const ChunkEntry *entry, char *dest) {
+    char path[PATH_MAX];
+    if (!chunk_path(path, sizeof(path), file_path, entry->id)) return -1;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    size_t done = 0;
+    while (done < entry->bytes) {
+        ssize_t n = TRACED(read(fd, dest + done, entry->bytes - done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            fprintf(stderr, "%s: chunk is shorter than its manifest entry\n", path);
+            TRACED(close(fd));
+            return -1;
+        }
+        done += (size_t) n;
+    }
+    TRACED(close(fd));
+    remind_trace.bytes_read += done;
+    return 0;
+}
+
+/// Maps the first `bytes` bytes of a chunk read-only, or returns NULL
+static const char *chunk_map(const char *file_path, const ChunkEntry *entry) {
+    char path[PATH_MAX];
+    if (!chunk_path(path, sizeof(path), file_path, entry->id)) return NULL;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (TRACED(fstat(fd, &st)) != 0) {
+        perror("fstat");
+    } else if ((uint64_t) st.st_size < entry->bytes) {
+        fprintf(stderr, "%s: chunk is shorter than its manifest entry\n", path);
+    } else if ((data = TRACED(mmap(NULL, entry->bytes, PROT_READ, MAP_PRIVATE, fd, 0))) == MAP_FAILED) {
+        perror("mmap");
+    }
+    TRACED(close(fd));
+    if (data == MAP_FAILED) return NULL;
+    // Mapped, not read, but render touches every byte of it
+    remind_trace.bytes_read += entry->bytes;
+    return data;
+}
+
+static void chunk_unlink(const char *file_path, uint32_t id) {
+    char path[PATH_MAX];
+    if (chunk_path(path, sizeof(path), file_path, id) && TRACED(unlink(path)) != 0 && errno != ENOENT) {
+        perror(path);
+    }
+}
+
+/// Splits whole lines into new chunks of about CHUNK_TARGET_SIZE bytes and
+/// adds them to the end of the manifest
+static int chunks_write_new(Manifest *m, const char *file_path, const char *data, size_t len) {
+    const char *end = data + len;
+    for (const char *p = data; p < end; ) {
+        const char *cut = end;
+        if ((size_t) (end - p) > CHUNK_TARGET_SIZE) {
+            const char *nl = memchr(p + CHUNK_TARGET_SIZE - 1, '\n', end - (p + CHUNK_TARGET_SIZE - 1));
+            cut = nl ? nl + 1 : end;
+        }
+        ChunkEntry entry = {
+            .id = m->header.next_id++,
+            .lines = (uint32_t) remind_count_lines(p, cut - p),
+            .bytes = (uint64_t) (cut - p),
+        };
+        char path[PATH_MAX];
+        struct iovec part = { (void *) p, cut - p };
+        if (!chunk_path(path, sizeof(path), file_path, entry.id) ||
+            remind_replace_file(path, &part, 1, true) != 0 ||
+            !manifest_push(m, entry)) {
+            return -1;
+        }
+        p = cut;
+    }
+    return 0;
+}
+
+/// Reads a chunked list into one buffer so everything that walks a
+/// RemindList works unchanged; -c streams it instead (see
+/// remind_chunks_render()). Returns 1 when the list is not chunked.
+int remind_chunks_read(RemindList *list, const char *file_path) {
+    Manifest m;
+    int rc = manifest_load(&m, file_path, &list->st);
+    if (rc != 0) return rc;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < m.header.count; i++) total += m.entries[i].bytes;
+    if (total > 0) {
+        remind_trace.allocations++;
+        char *data = malloc(total);
+        if (!data) {
+            perror("malloc");
+            manifest_free(&m);
+            return -1;
+        }
+        size_t offset = 0;
+        for (uint32_t i = 0; i < m.header.count && rc == 0; i++) {
+            rc = chunk_read(file_path, &m.entries[i], data + offset);
+            offset += m.entries[i].bytes;
+        }
+        if (rc != 0) {
+            free(data);
+            manifest_free(&m);
+            return -1;
+        }
+        list->data = data;
+        list->size = total;
+        list->copied = true;
+    }
+    manifest_free(&m);
+    return 0;
+}
+
+/// Renders what -c shows of a chunked list into out, mapping one chunk at
+/// a time instead of reading the list into one buffer: a first pass sizes
+/// the banner, a second copies the shown lines. Scheduled lines are judged
+/// as they pass, since the due heap only indexes plain lists. A list small
+/// enough to cache is rendered in memory (out->fd set to -1), as
+/// remind_check() does for a plain one. The caller holds the shared lock;
+/// st gets the manifest's stamp. Returns 1 when the list is not chunked.
+int remind_chunks_render(Output *out, const char *file_path, int64_t now, int64_t *valid_until, struct stat *st) {
+    *valid_until = REMIND_NEVER;
+    Manifest m;
+    int rc = manifest_load(&m, file_path, st);
+    if (rc != 0) return rc;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < m.header.count; i++) total += m.entries[i].bytes;
+    if (total < OUTPUT_FLUSH_SIZE / 2) out->fd = -1;
+
+    size_t longest_length = 0;
+    long shown_last = 0;
+    for (int pass = 0; pass < 2 && rc == 0; pass++) {
+        TracePhase phase = pass == 0 ? TRACE_READ : TRACE_RENDER;
+        if (pass == 1) {
+            if (shown_last == 0) break;
+            char num_string[32];
+            int longest_number_length = snprintf(num_string, sizeof(num_string), "%ld", shown_last + 1) +
+                                        NUMBER_SPACING;
+            remind_render_header(out, (int) longest_length + longest_number_length);
+        }
+        TRACE_BEGIN(phase);
+        long lineno = 0;
+        for (uint32_t i = 0; i < m.header.count && rc == 0; i++) {
+            const ChunkEntry *entry = &m.entries[i];
+            if (entry->bytes == 0) continue;
+            const char *data = chunk_map(file_path, entry);
+            if (!data) {
+                rc = -1;
+                break;
+            }
+            // Chunks hold whole lines, so none continues into the next
+            const char *end = data + entry->bytes;
+            for (const char *p = data; p < end; ) {
+                const char *nl = memchr(p, '\n', end - p);
+                const char *line_end = nl ? nl : end;
+                lineno++;
+                Schedule schedule;
+                int64_t change = REMIND_NEVER;
+                bool shown = !remind_schedule_parse(p, line_end - p, &schedule) ||
+                             remind_schedule_shown(&schedule, now, &change);
+                if (pass == 0) {
+                    if (change < *valid_until) *valid_until = change;
+                    if (shown && (size_t) (line_end - p) + 1 > longest_length) longest_length = line_end - p + 1;
+                    if (shown) shown_last = lineno;
+                } else if (shown) {
+                    output_line_number(out, lineno);
+                    output_append(out, p, line_end - p);
+                    output_append(out, "\n", 1);
+                }
+                p = line_end + 1;
+            }
+            TRACED(munmap((void *) data, entry->bytes));
+        }
+        TRACE_END(phase);
+    }
+    if (rc == 0 && shown_last > 0) output_append(out, "\n", 1);
+    manifest_free(&m);
+    return rc;
+}
+
+/// Writes data as the whole chunked list, under fresh ids, in place of
+/// whatever chunks there were. The caller holds the exclusive lock. The old
+/// chunks are removed only once the manifest names the new ones.
+int remind_chunks_replace(const char *file_path, const char *data, size_t len) {
+    Manifest old, m;
+    bool had_old = manifest_load(&old, file_path, NULL) == 0;
+    manifest_init(&m, had_old ? old.header.next_id : 0);
+
+    char dir_path[PATH_MAX];
+    int rc = chunk_dir_path(dir_path, sizeof(dir_path), file_path) ? 0 : -1;
+    if (rc == 0 && TRACED(mkdir(dir_path, 0755)) != 0 && errno != EEXIST) {
+        perror(dir_path);
+        rc = -1;
+    }
+    if (rc == 0) rc = chunks_write_new(&m, file_path, data, len);
+    if (rc == 0) rc = manifest_save(&m, file_path);
+
+    if (rc == 0) {
+        for (uint32_t i = 0; had_old && i < old.header.count; i++) chunk_unlink(file_path, old.entries[i].id);
+    } else {
+        for (uint32_t i = 0; i < m.header.count; i++) chunk_unlink(file_path, m.entries[i].id);
+    }
+    if (had_old) manifest_free(&old);
+    manifest_free(&m);
+    return rc;
+}
+
+/// Moves a plain list (tombstoned lines left out) into chunks. The caller
+/// holds the exclusive lock. The plain file goes last: until then it still
+/// shadows the half-written chunks.
+int remind_chunks_import(const char *file_path) {
+    RemindList list = { .lock_fd = -1 };
+    if (remind_list_open_locked(&list, file_path) != 0) {
+        return -1;
+    }
+
+    Output live = { .fd = -1 };
+    const char *data = list.data;
+    size_t size = list.size;
+    if (list.dead_count > 0) {
+        RemindLine line = {0};
+        while (remind_next_line(&list, &line)) {
+            output_append(&live, line.text, line.len);
+            if (line.text + line.len < list.data + list.size) output_append(&live, "\n", 1);
+        }
+        data = live.data;
+        size = live.len;
+    }
+    int rc = remind_chunks_replace(file_path, data, size);
+    output_free(&live);
+    remind_list_close(&list);
+
+    if (rc == 0) {
+        char tomb_path[PATH_MAX];
+        if (TRACED(unlink(file_path)) != 0) perror(file_path);
+        if (remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) TRACED(unlink(tomb_path));
+    }
+    return rc;
+}
+
+/// Joins the chunks back into a plain list, for $EDITOR or for leaving the
+/// chunked layout. The caller holds the exclusive lock.
+int remind_chunks_export(const char *file_path) {
+    Manifest m;
+    int rc = manifest_load(&m, file_path, NULL);
+    if (rc != 0) return rc < 0 ? -1 : 0;
+
+    RemindList list = { .lock_fd = -1 };
+    rc = remind_chunks_read(&list, file_path);
+    if (rc == 0) {
+        struct iovec part = { (void *) list.data, list.size };
+        rc = remind_replace_file(file_path, &part, list.size ? 1 : 0, true);
+        free((void *) list.data);
+    }
+    if (rc == 0) {
+        char path[PATH_MAX];
+        if (manifest_path(path, sizeof(path), file_path)) TRACED(unlink(path));
+        for (uint32_t i = 0; i < m.header.count; i++) chunk_unlink(file_path, m.entries[i].id);
+        if (chunk_dir_path(path, sizeof(path), file_path)) TRACED(rmdir(path));
+    }
+    manifest_free(&m);
+    return rc;
+}
+
+/// Appends formatted reminders to the last chunk, or to new chunks once it
+/// is full. The caller holds the exclusive lock: unlike a plain append, the
+/// manifest has to be updated too.
+int remind_chunks_append(const char *file_path, const char *data, size_t len) {
+    Manifest m;
+    int rc = manifest_load(&m, file_path, NULL);
+    if (rc < 0) return -1;
+    if (rc == 1) {
+        char dir_path[PATH_MAX];
+        if (!chunk_dir_path(dir_path, sizeof(dir_path), file_path) ||
+            (TRACED(mkdir(dir_path, 0755)) != 0 && errno != EEXIST)) {
+            perror(dir_path);
+            return -1;
+        }
+        manifest_init(&m, 0);
+    }
+
+    // Top up the last chunk; whatever does not fit goes into new ones
+    ChunkEntry *last = m.header.count ? &m.entries[m.header.count - 1] : NULL;
+    size_t fill = 0;
+    if (last && last->bytes < CHUNK_TARGET_SIZE) {
+        size_t room = CHUNK_TARGET_SIZE - last->bytes;
+        const char *nl = len > room ? memchr(data + room - 1, '\n', len - (room - 1)) : NULL;
+        fill = nl ? (size_t) (nl + 1 - data) : len;
+    }
+    rc = 0;
+    if (fill > 0) {
+        char path[PATH_MAX];
+        int fd = chunk_path(path, sizeof(path), file_path, last->id)
+                 ? TRACED(open(path, O_RDWR | O_CLOEXEC)) : -1;
+        if (fd < 0) {
+            perror(path);
+            manifest_free(&m);
+            return -1;
+        }
+
+        /* Anything past the recorded size is a torn earlier append that never
+         * reached the manifest. Like a plain append, a missing final newline
+         * is repaired so the new reminder starts a line of its own.
+         */
+        char last_byte = '\n';
+        if (last->bytes > 0 && TRACED(pread(fd, &last_byte, 1, (off_t) last->bytes - 1)) != 1) last_byte = '\n';
+        Output out = { .fd = -1 };
+        if (last_byte != '\n') output_append(&out, "\n", 1);
+        output_append(&out, data, fill);
+        if (TRACED(ftruncate(fd, (off_t) last->bytes)) != 0 ||
+            TRACED(pwrite(fd, out.data, out.len, (off_t) last->bytes)) != (ssize_t) out.len ||
+            TRACED(fsync(fd)) != 0) {
+            perror(path);
+            rc = -1;
+        } else {
+            remind_trace.bytes_written += out.len;
+            last->lines += (uint32_t) remind_count_lines(data, fill);
+            last->bytes += out.len;
+        }
+        output_free(&out);
+        TRACED(close(fd));
+    }
+    if (rc == 0 && fill < len) {
+        rc = chunks_write_new(&m, file_path, data + fill, len - fill);
+    }
+
+    if (rc == 0) rc = manifest_save(&m, file_path);
+    manifest_free(&m);
+    return rc;
+}
+
+/// Deletes the lines in set, rewriting only the chunks that hold them. The
+/// chunk for line N is found from the running line totals in the manifest,
+/// without reading any chunk before it. The caller holds the exclusive lock.
+long remind_chunks_delete(const char *file_path, const LineSet *set) {
+    Manifest m;
+    int rc = manifest_load(&m, file_path, NULL);
+    if (rc != 0) {
+        if (rc == 1) fprintf(stderr, "No reminder at line %ld\n", set->ranges[0].first);
+        return rc < 0 ? -1 : 0;
+    }
+
+    Manifest next, rewritten;
+    manifest_init(&next, m.header.next_id);
+    manifest_init(&rewritten, 0);
+    long removed = 0;
+    long base = 0;   // lines in the chunks before this one
+    int r = 0;
+    for (uint32_t i = 0; i < m.header.count && rc == 0; i++) {
+        ChunkEntry entry = m.entries[i];
+        long first = base + 1, last = base + entry.lines;
+        base = last;
+        while (r < set->count && set->ranges[r].last < first) r++;
+        if (r == set->count || set->ranges[r].first > last) {
+            rc = manifest_push(&next, entry) ? 0 : -1;
+            continue;
+        }
+
+        // This chunk holds selected lines: keep the others in a new chunk
+        if (!manifest_push(&rewritten, entry)) {
+            rc = -1;
+            break;
+        }
+        remind_trace.allocations++;
+        char *data = malloc(entry.bytes ? entry.bytes : 1);
+        if (!data || chunk_read(file_path, &entry, data) != 0) {
+            free(data);
+            rc = -1;
+            break;
+        }
+        Output kept = { .fd = -1 };
+        const char *end = data + entry.bytes;
+        int rr = r;
+        long lineno = first;
+        for (const char *p = data; p < end; lineno++) {
+            const char *nl = memchr(p, '\n', end - p);
+            const char *line_end = nl ? nl + 1 : end;
+            while (rr < set->count && set->ranges[rr].last < lineno) rr++;
+            if (rr < set->count && set->ranges[rr].first <= lineno) {
+                removed++;
+            } else {
+                output_append(&kept, p, line_end - p);
+            }
+            p = line_end;
+        }
+        free(data);
+        if (kept.len > 0) {
+            // A fresh id, so the old chunk stays intact until the manifest moves on
+            rc = chunks_write_new(&next, file_path, kept.data, kept.len);
+        }
+        output_free(&kept);
+    }
+
+    // Ranges that end past the last line were cut short
+    while (r < set->count && set->ranges[r].last <= base) r++;
+    if (r < set->count) {
+        long missing = set->ranges[r].first > base ? set->ranges[r].first : base + 1;
+        fprintf(stderr, "No reminder at line %ld\n", missing);
+    }
+
+    if (rc == 0 && removed > 0) {
+        rc = manifest_save(&next, file_path);
+    }
+    // Drop whichever chunks the manifest on disk no longer names
+    if (rc == 0 && removed > 0) {
+        for (uint32_t i = 0; i < rewritten.header.count; i++) chunk_unlink(file_path, rewritten.entries[i].id);
+    } else {
+        for (uint32_t i = 0; i < next.header.count; i++) {
+            if (next.entries[i].id >= m.header.next_id) chunk_unlink(file_path, next.entries[i].id);
+        }
+    }
+    manifest_free(&m);
+    manifest_free(&next);
+    manifest_free(&rewritten);
+    return rc == 0 ? removed : -1;
+}
+
+/// Replaces line `number` with replacement, one formatted line whose newline
+/// is dropped if the line it replaces had none, rewriting only the chunk
+/// that holds it under a fresh id. As for a delete, the chunk is found from
+/// the running line totals. The caller holds the exclusive lock. Returns 1
+/// when there is no such line.
+int remind_chunks_edit(const char *file_path, long number, const char *replacement, size_t len) {
+    Manifest m;
+    int rc = manifest_load(&m, file_path, NULL);
+    if (rc != 0) return rc;
+
+    long base = 0;   // lines in the chunks before this one
+    uint32_t i = 0;
+    while (i < m.header.count && base + (long) m.entries[i].lines < number) base += m.entries[i++].lines;
+    if (number < 1 || i == m.header.count) {
+        manifest_free(&m);
+        return 1;
+    }
+
+    ChunkEntry entry = m.entries[i];
+    remind_trace.allocations++;
+    char *data = malloc(entry.bytes ? entry.bytes : 1);
+    if (!data || chunk_read(file_path, &entry, data) != 0) {
+        free(data);
+        manifest_free(&m);
+        return -1;
+    }
+    const char *end = data + entry.bytes;
+    const char *p = data;
+    for (long lineno = base + 1; lineno < number; lineno++) {
+        const char *nl = memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end;
+    }
+    const char *nl = memchr(p, '\n', end - p);
+    const char *line_end = nl ? nl + 1 : end;
+
+    Output edited = { .fd = -1 };
+    output_append(&edited, data, p - data);
+    output_append(&edited, replacement, nl ? len : len - 1);
+    output_append(&edited, line_end, end - line_end);
+    free(data);
+
+    // The old chunk stays intact until the manifest names its replacement
+    Manifest next;
+    manifest_init(&next, m.header.next_id);
+    for (uint32_t j = 0; j < i && rc == 0; j++) rc = manifest_push(&next, m.entries[j]) ? 0 : -1;
+    if (rc == 0) rc = chunks_write_new(&next, file_path, edited.data, edited.len);
+    for (uint32_t j = i + 1; j < m.header.count && rc == 0; j++) rc = manifest_push(&next, m.entries[j]) ? 0 : -1;
+    if (rc == 0) rc = manifest_save(&next, file_path);
+
+    if (rc == 0) {
+        chunk_unlink(file_path, entry.id);
+    } else {
+        for (uint32_t j = 0; j < next.header.count; j++) {
+            if (next.entries[j].id >= m.header.next_id) chunk_unlink(file_path, next.entries[j].id);
+        }
+    }
+    output_free(&edited);
+    manifest_free(&m);
+    manifest_free(&next);
+    return rc;
+}
@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+
+#include "remind.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#endif
+
+/*
+ * remind --daemon: tells the user when a scheduled reminder comes due.
+ *
+ * The due heap (see schedule.c) already knows the next instant anything
+ * appears or disappears, so the daemon arms a single timerfd for it and
+ * sleeps. On waking it asks the heap again, which re-evaluates only the
+ * rules whose time has come, and announces the lines that were hidden
+ * before and are shown now. An inotify watch on the list's directory,
+ * and on its chunk directory when it is chunked, wakes it when the list
+ * changes, for the same incremental rescan. With
+ * nothing scheduled the timer is disarmed and the daemon makes no wakeups
+ * at all.
+ *
+ * Hidden lines are remembered with a hash of their text, so a line that
+ * moved or changed under an edit is never announced by mistake.
+ */
+
+/// A line hidden at the last scan
+typedef struct {
+    uint32_t line;
+    uint32_t hash;
+} HiddenLine;
+
+typedef struct {
+    const char *file_path;
+    const char *notify;     // FIFO or shell command, NULL for stderr
+    bool notify_fifo;
+    HiddenLine *hidden;
+    size_t hidden_count;
+    int64_t next;           // when the heap's top comes due
+} Daemon;
+
+/// Reads physical line `line` through cursor, skipping tombstoned lines.
+/// False when it is not there or is dead.
+static bool read_line(const RemindList *list, LineCursor *cursor, uint32_t line, RemindLine *out) {
+    if (!list->data || !remind_cursor_seek(list, cursor, (long) line)) return false;
+    const char *text = list->data + cursor->offset;
+    const char *nl = memchr(text, '\n', list->size - cursor->offset);
+    size_t dead = remind_dead_before(list, cursor->offset);
+    if (dead < list->dead_count && list->dead[dead] == cursor->offset) return false;
+    *out = (RemindLine) {
+        .text = text,
+        .len = nl ? (size_t) (nl - text) : list->size - cursor->offset,
+        .number = cursor->line - (long) dead,
+        .next_dead = dead,
+    };
+    return true;
+}
+
+/// Hands one reminder that just came due to the configured target
+static void announce(const Daemon *daemon, const RemindLine *line) {
+    Output out = { .fd = -1 };
+    output_str(&out, "remind: ");
+    output_line_number(&out, line->number);
+    output_append(&out, line->text, line->len);
+    output_append(&out, "\n", 1);
+
+    if (!daemon->notify) {
+        write_all(STDERR_FILENO, out.data, out.len);
+    } else if (daemon->notify_fifo) {
+        // Nobody reading is not an error; the announcement is just lost
+        int fd = TRACED(open(daemon->notify, O_WRONLY | O_NONBLOCK | O_CLOEXEC));
+        if (fd >= 0) {
+            write_all(fd, out.data, out.len);
+            TRACED(close(fd));
+        }
+    } else {
+        pid_t pid = fork();
+        if (pid == 0) {
+            char number[32];
+            snprintf(number, sizeof(number), "%ld", line->number);
+            char *text = strndup(line->text, line->len);
+            setenv("REMIND_LINE", number, 1);
+            if (text) setenv("REMIND_TEXT", text, 1);
+            execl("/bin/sh", "sh", "-c", daemon->notify, (char *) NULL);
+            _exit(127);
+        } else if (pid < 0) {
+            perror("fork");
+        }
+    }
+    output_free(&out);
+}
+
+/// Asks the due heap what is hidden now, announces what was hidden at the
+/// last scan and no longer is, and remembers the new state
+static int rescan(Daemon *daemon) {
+    int64_t now = (int64_t) time(NULL);
+    RemindList list;
+    struct stat st;
+    if (remind_list_stat(daemon->file_path, &st) != 0) {
+        // No list, nothing due
+        free(daemon->hidden);
+        daemon->hidden = NULL;
+        daemon->hidden_count = 0;
+        daemon->next = REMIND_NEVER;
+        return 0;
+    }
+    if (remind_list_open(&list, daemon->file_path) != 0) return -1;
+
+    uint32_t *hidden;
+    size_t hidden_count;
+    if (remind_due_hidden(&list, daemon->file_path, now, &hidden, &hidden_count, &daemon->next) != 0) {
+        remind_list_close(&list);
+        return -1;
+    }
+
+    // Both sets are sorted by line, so one merge finds what was unhidden
+    LineCursor cursor = { .line = 1 };
+    size_t h = 0;
+    for (size_t i = 0; i < daemon->hidden_count; i++) {
+        const HiddenLine *was = &daemon->hidden[i];
+        while (h < hidden_count && hidden[h] < was->line) h++;
+        if (h < hidden_count && hidden[h] == was->line) continue;
+        RemindLine line;
+        if (read_line(&list, &cursor, was->line, &line) &&
+            remind_line_hash(line.text, line.len) == was->hash) {
+            announce(daemon, &line);
+        }
+    }
+
+    remind_trace.allocations++;
+    HiddenLine *remembered = malloc((hidden_count ? hidden_count : 1) * sizeof(*remembered));
+    size_t remembered_count = 0;
+    cursor = (LineCursor) { .line = 1 };
+    for (size_t i = 0; remembered && i < hidden_count; i++) {
+        RemindLine line;
+        if (read_line(&list, &cursor, hidden[i], &line)) {
+            remembered[remembered_count++] = (HiddenLine) {
+                .line = hidden[i],
+                .hash = remind_line_hash(line.text, line.len),
+            };
+        }
+    }
+    free(hidden);
+    remind_list_close(&list);
+    if (!remembered) {
+        perror("malloc");
+        return -1;
+    }
+    free(daemon->hidden);
+    daemon->hidden = remembered;
+    daemon->hidden_count = remembered_count;
+    return 0;
+}
+
+#ifdef __linux__
+/// Arms the timer for the next change, or disarms it when there is none.
+/// A jump of the wall clock cancels it, so the daemon rescans then too.
+static int arm_timer(int timer_fd, int64_t next) {
+    struct itimerspec spec = {0};
+    if (next != REMIND_NEVER) spec.it_value.tv_sec = (time_t) (next > 0 ? next : 1);
+    if (TRACED(timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &spec, NULL)) != 0) {
+        perror("timerfd_settime");
+        return -1;
+    }
+    return 0;
+}
+
+/// Starts watching <list>.chunks/ for manifest renames, the commit point
+/// of every chunked write. Quietly does nothing while it does not exist.
+static void watch_chunks(ListWatch *watch) {
+    char path[PATH_MAX];
+    if (watch->chunks_wd >= 0 || !remind_sidecar_path(path, sizeof(path), watch->file_path, ".chunks")) return;
+    watch->chunks_wd = TRACED(inotify_add_watch(watch->fd, path, IN_ONLYDIR | IN_MOVED_TO | IN_CLOSE_WRITE));
+}
+
+/// True when an event is about the list itself (or its tombstones or
+/// chunk manifest), not one of the sidecars we write. A chunk directory
+/// that appears is watched from then on.
+static bool event_relevant(ListWatch *watch, const struct inotify_event *event) {
+    if (event->wd == watch->chunks_wd) {
+        if (event->mask & IN_IGNORED) watch->chunks_wd = -1;
+        return event->len > 0 && strcmp(event->name, "manifest") == 0;
+    }
+    if (event->len == 0) return false;
+    size_t base_len = strlen(watch->base);
+    if (strncmp(event->name, watch->base, base_len) != 0) return false;
+    const char *suffix = event->name + base_len;
+    if (strcmp(suffix, ".chunks") == 0) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) watch_chunks(watch);
+        return true;
+    }
+    return *suffix == '\0' || strcmp(suffix, ".tomb") == 0;
+}
+
+/// Opens a non-blocking inotify watch on the directory the list lives in
+/// (creating it if need be) and on its chunk directory if there is one.
+/// Returns -1 on error.
+int remind_watch_list(ListWatch *watch, const char *file_path) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", file_path);
+    char *slash = strrchr(dir, '/');
+    *watch = (ListWatch) {
+        .fd = -1,
+        .chunks_wd = -1,
+        .file_path = file_path,
+        .base = slash ? file_path + (slash - dir) + 1 : file_path,
+    };
+    if (slash) *slash = '\0';
+    else snprintf(dir, sizeof(dir), ".");
+
+    remind_ensure_dir(file_path);
+    watch->fd = TRACED(inotify_init1(IN_CLOEXEC | IN_NONBLOCK));
+    if (watch->fd < 0 || TRACED(inotify_add_watch(watch->fd, dir, IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO |
+                                                                  IN_ATTRIB | IN_CREATE | IN_DELETE |
+                                                                  IN_MOVED_FROM)) < 0) {
+        perror("inotify");
+        if (watch->fd >= 0) TRACED(close(watch->fd));
+        return -1;
+    }
+    watch_chunks(watch);
+    return 0;
+}
+
+/// Drains the events queued on a remind_watch_list() watch and says
+/// whether any of them was about the list
+bool remind_watch_changed(ListWatch *watch) {
+    bool changed = false;
+    for (;;) {
+        char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t n = TRACED(read(watch->fd, events, sizeof(events)));
+        if (n <= 0) break;
+        for (ssize_t at = 0; at < n; ) {
+            const struct inotify_event *event = (const struct inotify_event *) (events + at);
+            changed = event_relevant(watch, event) || changed;
+            at += (ssize_t) (sizeof(*event) + event->len);
+        }
+    }
+    return changed;
+}
+
+/// Runs until killed. notify is a FIFO to write announcements to, a shell
+/// command to run for each one (with REMIND_LINE and REMIND_TEXT set), or
+/// NULL for stderr. Returns -1 when it cannot start.
+int remind_daemon(const char *file_path, const char *notify) {
+    Daemon daemon = { .file_path = file_path, .notify = notify, .next = REMIND_NEVER };
+    struct stat notify_st;
+    daemon.notify_fifo = notify && TRACED(stat(notify, &notify_st)) == 0 && S_ISFIFO(notify_st.st_mode);
+    // Hook commands are never waited for
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+
+    ListWatch watch;
+    if (remind_watch_list(&watch, file_path) != 0) return -1;
+    int timer_fd = TRACED(timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC));
+    if (timer_fd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    if (rescan(&daemon) != 0 || arm_timer(timer_fd, daemon.next) != 0) return -1;
+    for (;;) {
+        struct pollfd fds[] = {
+            { .fd = watch.fd, .events = POLLIN },
+            { .fd = timer_fd, .events = POLLIN },
+        };
+        if (TRACED(poll(fds, 2, -1)) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return -1;
+        }
+
+        bool changed = (fds[0].revents & POLLIN) && remind_watch_changed(&watch);
+        if (fds[1].revents & POLLIN) {
+            // Expired, or cancelled by a clock change (ECANCELED): rescan either way
+            uint64_t expirations;
+            TRACED(read(timer_fd, &expirations, sizeof(expirations)));
+            changed = true;
+        }
+        if (changed && rescan(&daemon) == 0) {
+            arm_timer(timer_fd, daemon.next);
+        }
+    }
+}
+#else
+int remind_daemon(const char *file_path, const char *notify) {
+    (void) file_path;
+    (void) notify;
+    fprintf(stderr, "remind --daemon needs timerfd and inotify, which this system does not have\n");
+    return -1;
+}
+#endif
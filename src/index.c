@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "remind.h"
+
+/*
+ * reminders.index holds the byte offset of every INDEX_STRIDE-th line of
+ * the list (lines 1, 65, 129, ...), tagged with the FileStamp it describes.
+ * Finding line N is then one pread() of the header, one of the entry below
+ * N, and a memchr() over at most INDEX_STRIDE - 1 lines, instead of a scan
+ * from byte 0. Lines are counted physically here, tombstoned or not; the
+ * translation to live numbers happens in remind_seek_line().
+ *
+ * The index is built on first use and rebuilt whenever it does not match
+ * the list. Appends extend it in place: new entries are written before the
+ * header that makes them valid, so a reader sees either the old index or
+ * the new one. Tombstone deletes only move the list's mtime, and restamp it.
+ */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    uint64_t lines;
+    uint32_t stride;
+    uint32_t reserved;
+} IndexHeader;
+
+#define INDEX_MAGIC "RMDINDEX"
+#define INDEX_VERSION 1
+
+static bool index_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".index");
+}
+
+static bool header_valid(const IndexHeader *header) {
+    return memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == INDEX_VERSION &&
+           header->header_size == sizeof(*header) &&
+           header->stride == INDEX_STRIDE;
+}
+
+/// Offset of the indexed line at or before target (1-based), and that
+/// line's number. Returns false when the index is missing or stale.
+static bool index_lookup(const char *file_path, const struct stat *st, long target, uint64_t *offset, long *line) {
+    char path[PATH_MAX];
+    if (!index_path(path, sizeof(path), file_path)) return false;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+
+    IndexHeader header;
+    FileStamp stamp = file_stamp(st);
+    bool found = TRACED(pread(fd, &header, sizeof(header), 0)) == (ssize_t) sizeof(header) &&
+                 header_valid(&header) && file_stamp_equal(&header.source, &stamp);
+    if (found) {
+        uint64_t last = header.lines ? header.lines : 1;
+        uint64_t entry = ((uint64_t) target <= last ? (uint64_t) target - 1 : last - 1) / INDEX_STRIDE;
+        found = TRACED(pread(fd, offset, sizeof(*offset), (off_t) (sizeof(header) + entry * sizeof(*offset)))) ==
+                (ssize_t) sizeof(*offset);
+        *line = (long) (entry * INDEX_STRIDE + 1);
+        remind_trace.bytes_read += sizeof(header) + sizeof(*offset);
+    }
+    TRACED(close(fd));
+    return found;
+}
+
+/// Builds the index for a mapped list and saves it, unless the list was
+/// modified too recently to be told apart from its next version (see
+/// file_stamp_settled())
+static void index_build(const char *file_path, const char *data, size_t size, const struct stat *st) {
+    if (!file_stamp_settled(st)) return;
+    char path[PATH_MAX];
+    if (!index_path(path, sizeof(path), file_path)) return;
+
+    IndexHeader header = {
+        .version = INDEX_VERSION,
+        .header_size = sizeof(header),
+        .source = file_stamp(st),
+        .stride = INDEX_STRIDE,
+    };
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+
+    Output entries = { .fd = -1 };
+    const char *end = data + size;
+    for (const char *p = data; p < end; header.lines++) {
+        if (header.lines % INDEX_STRIDE == 0) {
+            uint64_t offset = (uint64_t) (p - data);
+            output_append(&entries, (const char *) &offset, sizeof(offset));
+        }
+        const char *nl = memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end;
+    }
+
+    struct iovec parts[] = {
+        { &header, sizeof(header) },
+        { entries.data, entries.len },
+    };
+    remind_replace_file(path, parts, 2, false);
+    output_free(&entries);
+}
+
+/// Offset and number of the indexed physical line (tombstoned lines
+/// counted) at or before target, indexing the list first if it has no
+/// usable index. False when it cannot be indexed yet.
+bool remind_index_nearest(const RemindList *list, const char *file_path, long target, uint64_t *offset, long *line) {
+    if (!list->data || list->copied) return false;
+    if (!index_lookup(file_path, &list->st, target, offset, line)) {
+        index_build(file_path, list->data, list->size, &list->st);
+        if (!index_lookup(file_path, &list->st, target, offset, line)) return false;
+    }
+    return *offset == 0 || (*offset < list->size && list->data[*offset - 1] == '\n');
+}
+
+/// Maps the whole index for callers that look up many lines, indexing the
+/// list first if it has no usable index. False when it cannot be indexed
+/// yet; callers then walk the list themselves.
+bool remind_index_map(const RemindList *list, const char *file_path, LineIndexMap *map) {
+    memset(map, 0, sizeof(*map));
+    uint64_t offset;
+    long line;
+    char path[PATH_MAX];
+    if (!remind_index_nearest(list, file_path, 1, &offset, &line) ||
+        !index_path(path, sizeof(path), file_path)) {
+        return false;
+    }
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+    struct stat st;
+    IndexHeader header;
+    FileStamp stamp = file_stamp(&list->st);
+    bool ok = TRACED(fstat(fd, &st)) == 0 && (size_t) st.st_size >= sizeof(header);
+    void *data = ok ? TRACED(mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) : MAP_FAILED;
+    TRACED(close(fd));
+    if (data == MAP_FAILED) return false;
+
+    memcpy(&header, data, sizeof(header));
+    size_t count = (size_t) ((header.lines + INDEX_STRIDE - 1) / INDEX_STRIDE);
+    if (!header_valid(&header) || !file_stamp_equal(&header.source, &stamp) ||
+        sizeof(header) + count * sizeof(uint64_t) > (size_t) st.st_size) {
+        TRACED(munmap(data, (size_t) st.st_size));
+        return false;
+    }
+    map->mapping = data;
+    map->mapping_size = (size_t) st.st_size;
+    map->offsets = (const uint64_t *) ((const char *) data + sizeof(header));
+    map->count = count;
+    return true;
+}
+
+void remind_index_unmap(LineIndexMap *map) {
+    if (map->mapping) TRACED(munmap(map->mapping, map->mapping_size));
+    memset(map, 0, sizeof(*map));
+}
+
+/// Moves cursor to physical line target. A few lines forward are a
+/// memchr() each; longer jumps go through the mapped index when the cursor
+/// has one. False when the list has no such line.
+bool remind_cursor_seek(const RemindList *list, LineCursor *cursor, long target) {
+    size_t entry = (size_t) (target - 1) / INDEX_STRIDE;
+    long entry_line = (long) (entry * INDEX_STRIDE + 1);
+    if (entry < cursor->index.count && (target < cursor->line || entry_line > cursor->line) &&
+        cursor->index.offsets[entry] < list->size) {
+        cursor->line = entry_line;
+        cursor->offset = (size_t) cursor->index.offsets[entry];
+    } else if (target < cursor->line) {
+        cursor->line = 1;
+        cursor->offset = 0;
+    }
+    while (cursor->line < target) {
+        const char *nl = memchr(list->data + cursor->offset, '\n', list->size - cursor->offset);
+        if (!nl) return false;
+        cursor->offset = (size_t) (nl + 1 - list->data);
+        cursor->line++;
+    }
+    return cursor->offset < list->size;
+}
+
+/// Positions line so that the next remind_next_line() returns live line
+/// target, or a live line not far before it; callers keep stepping until
+/// line.number reaches target. Without a usable index the list is indexed
+/// first, so only the first lookup after a change pays for a full scan.
+/// Chunked lists have no index and start from the top.
+void remind_seek_line(const RemindList *list, const char *file_path, long target, RemindLine *line) {
+    memset(line, 0, sizeof(*line));
+    if (!list->data || list->copied || target <= 1) return;
+
+    uint64_t offset;
+    long physical;
+    if (!remind_index_nearest(list, file_path, target, &offset, &physical) || offset == 0) return;
+
+    // Live lines before offset are the physical ones minus the dead ones
+    size_t low = remind_dead_before(list, offset);
+    long live_before = physical - 1 - (long) low;
+    if (live_before <= 0) return;
+
+    // A zero-length line ending just before offset, as if we had stepped there
+    line->text = list->data + offset - 1;
+    line->len = 0;
+    line->number = live_before;
+    line->next_dead = low;
+}
+
+/// Extends the index after an append of data at the end of a list that
+/// matched it as before. fixed_newline says a "\n" was written first to
+/// end an unterminated last line.
+void remind_index_append(const char *file_path, const struct stat *before, const struct stat *after,
+                         bool fixed_newline, const char *data, size_t len) {
+    char path[PATH_MAX];
+    if (!index_path(path, sizeof(path), file_path)) return;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return;
+
+    IndexHeader header;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(pread(fd, &header, sizeof(header), 0)) != (ssize_t) sizeof(header) ||
+        !header_valid(&header) || !file_stamp_equal(&header.source, &stamp)) {
+        TRACED(close(fd));
+        return;
+    }
+
+    Output entries = { .fd = -1 };
+    uint64_t base = (uint64_t) before->st_size + (fixed_newline ? 1 : 0);
+    const char *end = data + len;
+    uint64_t lines = header.lines;
+    for (const char *p = data; p < end; lines++) {
+        if (lines % INDEX_STRIDE == 0) {
+            uint64_t offset = base + (uint64_t) (p - data);
+            output_append(&entries, (const char *) &offset, sizeof(offset));
+        }
+        const char *nl = memchr(p, '\n', end - p);
+        p = nl ? nl + 1 : end;
+    }
+
+    off_t entries_at = (off_t) (sizeof(header) + (header.lines + INDEX_STRIDE - 1) / INDEX_STRIDE * sizeof(uint64_t));
+    header.lines = lines;
+    header.source = file_stamp(after);
+    if ((entries.len == 0 ||
+         TRACED(pwrite(fd, entries.data, entries.len, entries_at)) == (ssize_t) entries.len) &&
+        TRACED(pwrite(fd, &header, sizeof(header), 0)) == (ssize_t) sizeof(header)) {
+        remind_trace.bytes_written += entries.len + sizeof(header);
+    }
+    output_free(&entries);
+    TRACED(close(fd));
+}
+
+/// Moves an index from before to after when only the list's stamp changed,
+/// as it does when tombstones are written
+void remind_index_restamp(const char *file_path, const struct stat *before, const struct stat *after) {
+    char path[PATH_MAX];
+    if (!index_path(path, sizeof(path), file_path)) return;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return;
+
+    IndexHeader header;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(pread(fd, &header, sizeof(header), 0)) == (ssize_t) sizeof(header) &&
+        header_valid(&header) && file_stamp_equal(&header.source, &stamp) &&
+        before->st_size == after->st_size) {
+        header.source = file_stamp(after);
+        TRACED(pwrite(fd, &header, sizeof(header), 0));
+    }
+    TRACED(close(fd));
+}
+
+/// Keeps an index current when an edit in place moved everything from
+/// byte `from` onwards by delta and the number of lines stayed the same
+void remind_index_shift(const char *file_path, const struct stat *before, const struct stat *after,
+                        uint64_t from, int64_t delta) {
+    char path[PATH_MAX];
+    if (!index_path(path, sizeof(path), file_path)) return;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return;
+
+    IndexHeader header;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(pread(fd, &header, sizeof(header), 0)) != (ssize_t) sizeof(header) ||
+        !header_valid(&header) || !file_stamp_equal(&header.source, &stamp)) {
+        TRACED(close(fd));
+        return;
+    }
+
+    // Only the entries past the edited line move, and they are contiguous
+    size_t count = (size_t) ((header.lines + INDEX_STRIDE - 1) / INDEX_STRIDE);
+    Output entries = { .fd = -1 };
+    bool ok = delta == 0 || (count > 0 && output_reserve(&entries, count * sizeof(uint64_t)) &&
+                             TRACED(pread(fd, entries.data, count * sizeof(uint64_t), sizeof(header))) ==
+                                 (ssize_t) (count * sizeof(uint64_t)));
+    size_t first = count;
+    if (ok && delta != 0) {
+        uint64_t *offsets = (uint64_t *) entries.data;
+        for (size_t i = 0; i < count; i++) {
+            if (offsets[i] <= from) continue;
+            if (first == count) first = i;
+            offsets[i] = (uint64_t) ((int64_t) offsets[i] + delta);
+        }
+        size_t moved = (count - first) * sizeof(uint64_t);
+        ok = moved == 0 || TRACED(pwrite(fd, entries.data + first * sizeof(uint64_t), moved,
+                                         (off_t) (sizeof(header) + first * sizeof(uint64_t)))) == (ssize_t) moved;
+    }
+    if (ok) {
+        header.source = file_stamp(after);
+        TRACED(pwrite(fd, &header, sizeof(header), 0));
+    }
+    output_free(&entries);
+    TRACED(close(fd));
+}
@@ -1,22 +1,33 @@
 #include <stdio.h>
-#include <assert.h>
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdbool.h>
-#include <sys/stat.h>
 
-#define NUMBER_SPACING 2
-#define MAX_LINES 1024
-#define MAX_LINE_LENGTH 1024
-#define MAX_LINE_CHARACTER_LENGTH 1024
+#include "remind.h"
 
 typedef struct {
     bool check;
-    char* add;
+    char** add;      // Texts to add, "-" reads one reminder per line from stdin
+    int add_count;
     bool edit;
-    int  delete;   // Line number to delete, -1 = none
+    LineSet delete;   // Line numbers to delete, empty = none
+    bool count;
+    bool quiet;
+    LineWindow window;  // Part of the list -c shows, WINDOW_ALL = everything
+    const char* search; // Pattern to list the matching reminders of, or NULL
+    bool ignore_case;
+    const char* tag;    // Tag to list the reminders of, or NULL
+    bool daemon;
+    const char* notify; // Where --daemon announces due reminders, NULL = stderr
+    bool serve;
+    bool watch;
+    const char* batch;  // Script of commands to run, "-" for stdin, or NULL
+    long edit_line;     // Reminder -e replaces the text of, 0 = none
+    const char* edit_text;
 } Args;
 
 typedef enum {
@@ -24,6 +35,21 @@ typedef enum {
     ACTION_ADD,
     ACTION_DELETE,
     ACTION_EDIT,
+    ACTION_COUNT,
+    ACTION_QUIET,
+    ACTION_HEAD,
+    ACTION_TAIL,
+    ACTION_RANGE,
+    ACTION_SEARCH,
+    ACTION_IGNORE_CASE,
+    ACTION_TAG,
+    ACTION_ALL,
+    ACTION_DAEMON,
+    ACTION_NOTIFY,
+    ACTION_SERVE,
+    ACTION_WATCH,
+    ACTION_BATCH,
+    ACTION_EDIT_LINE,
     ACTION_HELP
 } Action;
 
@@ -38,182 +64,215 @@ void print_help() {
     printf("USAGE:\n");
     printf("    remind [OPTIONS]\n\n");
     printf("OPTIONS:\n");
-    printf("    -c              Check reminders. Prints the current list of reminders.\n");
-    printf("    -a TEXT         Add a new reminder line containing TEXT.\n");
-    printf("    -d N            Delete reminder at line number N (1-based).\n");
+    printf("    -c              Check reminders. Prints the reminders that are due now.\n");
+    printf("    --all           Like -c, but also reminders that are not due yet.\n");
+    printf("    -a TEXT         Add a new reminder line containing TEXT. May be repeated;\n");
+    printf("                    use - to add one reminder per line read from stdin.\n");
+    printf("    -d N[,N|A-B]    Delete reminders by line number (1-based), e.g. 2 or 1,4,7-20.\n");
+    printf("    -e N TEXT       Replace the text of reminder N with TEXT.\n");
+    printf("    --head N        Like -c, but only the first N reminders.\n");
+    printf("    --tail N        Like -c, but only the last N reminders.\n");
+    printf("    --range A[-B]   Like -c, but only reminders A to B (or just A).\n");
+    printf("    -w              Like -c, but stay on screen and redraw as the list changes.\n");
+    printf("    -s PATTERN      List the reminders containing PATTERN, or matching it\n");
+    printf("                    as an extended regex if it has regex characters.\n");
+    printf("    -i              Ignore case in -s patterns.\n");
+    printf("    -t TAG          List the reminders tagged +TAG (words written +TAG in the text).\n");
+    printf("    --daemon        Stay running and announce reminders as they come due.\n");
+    printf("    --notify TARGET Announce to TARGET instead of stderr: a FIFO, or a shell\n");
+    printf("                    command run with $REMIND_LINE and $REMIND_TEXT set.\n");
+    printf("    --serve         Keep the list in memory and answer -c, --count, -a and -d\n");
+    printf("                    for other remind commands over a socket.\n");
+    printf("    --batch FILE    Run the add, delete, move, edit and check commands in FILE\n");
+    printf("                    (- for stdin) with one read and one write of the list.\n");
+    printf("    --count         Print the number of reminders that are due.\n");
+    printf("    -q              Print nothing; exit 0 if any reminders are due, 1 if not.\n");
     printf("    -h, --help      Show this help message.\n");
     printf("    (no options)    Open the reminders file in $EDITOR for manual editing.\n\n");
     printf("EXAMPLES:\n");
     printf("    remind -a \"Buy milk\"    Add a reminder\n");
-    printf("    remind -c              List all reminders\n");
+    printf("    git diff --name-only | remind -a -\n");
+    printf("                           Add one reminder per line of input\n");
+    printf("    remind -c              List reminders that are due\n");
+    printf("    remind --tail 5        List the five newest reminders\n");
+    printf("    remind -w              Keep the list on screen, e.g. in a tmux pane\n");
+    printf("    remind -s -i milk      List reminders mentioning milk, in any case\n");
+    printf("    remind -a \"+work deploy review\"\n");
+    printf("                           Add a reminder tagged work\n");
+    printf("    remind -c -t work      List the reminders tagged work\n");
+    printf("    remind -a \"standup every:weekdays due:2026-01-05T09:30\"\n");
+    printf("                           Add a reminder shown each weekday from 9:30\n");
     printf("    remind -d 2            Delete the second reminder\n");
+    printf("    remind -d 1,4,7-9      Delete reminders 1, 4, 7, 8 and 9\n");
+    printf("    remind -e 3 \"Buy oat milk\"\n");
+    printf("                           Change the text of the third reminder\n");
+    printf("    printf 'add Buy milk\\nmove 3 1\\n' | remind --batch -\n");
+    printf("                           Add a reminder and move the third to the top\n");
+    printf("    remind -q && echo \"You have $(remind --count) reminders\"\n");
+    printf("                           Prompt integration\n");
     printf("    remind                 Edit reminders manually\n\n");
     printf("FILES:\n");
     printf("    $HOME/.local/state/remind/reminders    Storage location of reminders\n\n");
     printf("For more information, see remind(1).\n");
 }
 
-/// Prints a single character on repeat a specific amount of times
-void print_for(char *c, int times) {
-   for (int i=0; i < times; i++) printf("%s", c);
+/// Parses a positive line number or count, rejecting trailing junk
+bool parse_positive(const char *s, char **end, long *value) {
+    if (*s < '0' || *s > '9') return false;
+    errno = 0;
+    *value = strtol(s, end, 10);
+    return errno == 0 && *value > 0;
 }
 
-bool print_header(int width) {
-    const int title_length = 9;
-    if (width < title_length + 2) {
-        width = title_length + 4;
-    }
-    int space_length = (width - title_length - 2) / 2;
-    char *title = "Reminders";
-    print_for("#", width); printf("\n#");
-    print_for(" ", space_length); printf("%s", title); print_for(" ", space_length); printf("#\n");
-    print_for("#", width); printf("\n");
-    return true;
-}
-
-/// Ensures the directory for the reminders file exists
-void ensure_remind_dir(const char *file_path) {
-    char dir_path[PATH_MAX];
-    strcpy(dir_path, file_path);
-
-    // Find the last slash to get directory path
-    char *last_slash = strrchr(dir_path, '/');
-    if (last_slash) {
-        *last_slash = '\0';  // Terminate string at last slash
-
-        // Use system command to create directory recursively
-        char mkdir_cmd[PATH_MAX + 20];
-        snprintf(mkdir_cmd, sizeof(mkdir_cmd), "mkdir -p \"%s\"", dir_path);
-        system(mkdir_cmd);
+/// Parses the argument of --head, --tail or --range into a window
+bool parse_window(Action action, const char *spec, LineWindow *window) {
+    char *end;
+    long first, last;
+    if (!parse_positive(spec, &end, &first)) return false;
+    if (action != ACTION_RANGE) {
+        window->kind = action == ACTION_HEAD ? WINDOW_HEAD : WINDOW_TAIL;
+        window->count = first;
+        return *end == '\0';
     }
+    last = first;
+    if (*end == '-' && (!parse_positive(end + 1, &end, &last) || last < first)) return false;
+    window->kind = WINDOW_RANGE;
+    window->first = first;
+    window->last = last;
+    return *end == '\0';
 }
 
-/// Checks the reminders in the file and prints them out
-void check_reminders(const char *file_path) {
-    // Ensure directory exists first
-    ensure_remind_dir(file_path);
-
-    FILE *f = fopen(file_path, "r");
-    if (!f) {
-        // Create empty file if it doesn't exist
-        f = fopen(file_path, "w");
-        if (f) {
-            fclose(f);
+/// Reads fd to EOF into in
+bool read_all(int fd, Output *in) {
+    for (;;) {
+        if (!output_reserve(in, 64 * 1024)) {
+            return false;
         }
-        // No reminders to show yet
-        return;
-    }
-
-    int longest_length = 0;
-    char line[MAX_LINE_CHARACTER_LENGTH];
-    char *lines[MAX_LINES];
-	int lc = 1;
-    bool has_printed_header = false;
-    while (fgets(line, sizeof(line), f) && lc <= MAX_LINES) {
-        int length = strlen(line);
-        if (length > longest_length) longest_length = length;
-        lines[lc - 1] = strdup(line);
-		lc++;
-    }
-
-    // Check if we hit the limit before closing file
-    bool hit_limit = !feof(f);
-    fclose(f);
-
-
-    char num_string[32];
-    sprintf(num_string, "%d", lc);
-    int longest_number_length = strlen(num_string) + NUMBER_SPACING;
-
-    for (int i =0; i < lc -1; i++) {
-        if (!has_printed_header) {
-            /* The header feature is supposed to be used to grab attention
-             * when the user integrates the program into their shell startup.
-             * Logically they only want to see it if there are items on the list
-             * which is why we keep this in the loop.
-             */
-            has_printed_header = print_header(longest_length + longest_number_length);
+        ssize_t n = read(fd, in->data + in->len, in->cap - in->len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            return false;
         }
-        printf("%d. %s",i + 1, lines[i]);
-        free(lines[i]);
-    }
-
-    if (hit_limit) {
-        fprintf(stderr, "\nWarning: File has more than %d lines. Only showing first %d lines.\n", MAX_LINES, MAX_LINES);
-    }
-    if (has_printed_header) {
-        printf("\n");
+        if (n == 0) return true;
+        in->len += (size_t) n;
     }
 }
 
-void delete_line(const char *file_path, int target_line) {
-    FILE *f = fopen(file_path, "r");
-    if (!f) {
-        perror("fopen read");
-        return;
+/// Reads stdin to EOF and appends every non-blank line as a reminder
+bool read_stdin_reminders(Output *out) {
+    Output in = { .fd = -1 };
+    if (!read_all(STDIN_FILENO, &in)) {
+        output_free(&in);
+        return false;
     }
 
-    // Get the file size so that we can use it in malloc
-    struct stat st;
-    if (stat(file_path, &st) != 0) {
-        perror("stat");
-        fclose(f);
-        return;
+    remind_format_lines(out, in.data, in.len);
+    output_free(&in);
+    return true;
+}
+
+/// Runs a --batch script read from path, or stdin for "-"
+int run_batch(const char *file_path, const char *path) {
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(path);
+        return -1;
     }
-    long size = st.st_size;
+    Output script = { .fd = -1 };
+    bool read_ok = read_all(fd, &script);
+    if (fd != STDIN_FILENO) close(fd);
+    int rc = read_ok ? remind_batch(file_path, script.data ? script.data : "", script.len, STDOUT_FILENO) : -1;
+    output_free(&script);
+    return rc;
+}
 
-    char *buf = malloc(size + 1);
-    if (!buf) {
-        perror("malloc");
-        fclose(f);
-        return;
+/// Hands a request to a running remind --serve and prints its reply, the
+/// server's messages going to stderr. Returns the server's status, or -1
+/// when there is none, so the caller does the work itself.
+int ask_server(const char *file_path, ServeOp op, const void *payload, size_t len) {
+    Output reply = { .fd = -1 };
+    int status = remind_serve_call(file_path, op, payload, len, &reply);
+    if (status < 0) {
+        output_free(&reply);
+        return -1;
     }
-    fread(buf, 1, size, f);
-    buf[size] = '\0';
-    fclose(f);
-
-    // Open for writing (truncate)
-    f = fopen(file_path, "w");
-    if (!f) {
-        perror("fopen write");
-        free(buf);
-        return;
+    if (status != 0 || op == SERVE_ADD || op == SERVE_DELETE) {
+        write_all(STDERR_FILENO, reply.data, reply.len);
+    } else if (op == SERVE_CHECK) {
+        write_all(STDOUT_FILENO, reply.data, reply.len);
+    } else if (op == SERVE_COUNT && reply.len == sizeof(uint64_t)) {
+        uint64_t count;
+        memcpy(&count, reply.data, sizeof(count));
+        printf("%llu\n", (unsigned long long) count);
+    } else {
+        fprintf(stderr, "remind: malformed reply from remind --serve\n");
+        status = 1;
     }
+    output_free(&reply);
+    return status;
+}
 
-    int lineno = 1;
-    char *line = strtok(buf, "\n");
-    while (line) {
-        if (lineno != target_line) {
-            fprintf(f, "%s\n", line);
+/// Adds every -a text (and stdin for "-a -") with a single append.
+/// Returns 0 on success.
+int add_reminders(const char *file_path, char **texts, int count) {
+    Output out = { .fd = -1 };
+    bool read_stdin = false;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(texts[i], "-") == 0) {
+            // Stdin can only be drained once
+            if (!read_stdin && !read_stdin_reminders(&out)) {
+                output_free(&out);
+                return -1;
+            }
+            read_stdin = true;
+        } else {
+            remind_format(&out, texts[i], strlen(texts[i]));
         }
-        line = strtok(NULL, "\n");
-        lineno++;
     }
-
-    free(buf);
-    fclose(f);
-}
-
-void add_reminder(const char *file_path, const char *text) {
-    FILE *f = fopen(file_path, "a");
-    if (!f) {
-        perror("fopen append");
-        return;
+    int rc = ask_server(file_path, SERVE_ADD, out.data, out.len);
+    if (rc < 0) {
+        rc = remind_append(file_path, out.data, out.len);
     }
-
-    fprintf(f, "%s\n", text);
-    fclose(f);
+    output_free(&out);
+    return rc;
 }
 
 int main(int argc, char **argv) {
+    // REMIND_TRACE reports where the time went once we exit
+    remind_trace_init();
+    if (remind_trace_on) {
+        atexit(remind_trace_report);
+    }
+    TRACE_BEGIN(TRACE_ARGS);
+
     Args args = {0};
-    args.delete = -1;
-    args.add = NULL;
+    remind_trace.allocations++;
+    args.add = calloc(argc, sizeof(*args.add));
+    if (!args.add) {
+        perror("calloc");
+        return 1;
+    }
 
     FlagMapping flags[] = {
         {"-c", ACTION_CHECK, false},
         {"-a", ACTION_ADD, true},
         {"-d", ACTION_DELETE, true},
+        {"-e", ACTION_EDIT_LINE, true},
+        {"--count", ACTION_COUNT, false},
+        {"-q", ACTION_QUIET, false},
+        {"--head", ACTION_HEAD, true},
+        {"--tail", ACTION_TAIL, true},
+        {"--range", ACTION_RANGE, true},
+        {"-s", ACTION_SEARCH, true},
+        {"-i", ACTION_IGNORE_CASE, false},
+        {"-t", ACTION_TAG, true},
+        {"--all", ACTION_ALL, false},
+        {"--daemon", ACTION_DAEMON, false},
+        {"--notify", ACTION_NOTIFY, true},
+        {"--serve", ACTION_SERVE, false},
+        {"-w", ACTION_WATCH, false},
+        {"--batch", ACTION_BATCH, true},
         {"-h", ACTION_HELP, false},
         {"--help", ACTION_HELP, false}
     };
@@ -236,7 +295,7 @@ int main(int argc, char **argv) {
                             fprintf(stderr, "Please supply some text after the -a\n");
                             exit(1);
                         }
-                        args.add = argv[i + 1];
+                        args.add[args.add_count++] = argv[i + 1];
                         i++; // Skip over because we already read it above
                         break;
                         
@@ -245,20 +304,126 @@ int main(int argc, char **argv) {
                             fprintf(stderr, "Please supply a line number after -d\n");
                             exit(1);
                         }
-                        char *endptr;
-                        long line_n = strtol(argv[i + 1], &endptr, 10);
-                        if (*endptr != '\0' || line_n < 1) {
+                        // Repeated -d flags add to the same selection
+                        if (!line_set_parse(&args.delete, argv[i + 1])) {
                             fprintf(stderr, "Invalid line number: %s\n", argv[i + 1]);
                             exit(1);
                         }
-                        args.delete = (int) line_n;
                         i++;
                         break;
                         
+                    case ACTION_EDIT_LINE: {
+                        if (i + 2 >= argc) {
+                            fprintf(stderr, "Please supply a line number and text after -e\n");
+                            exit(1);
+                        }
+                        char *end;
+                        if (!parse_positive(argv[i + 1], &end, &args.edit_line) || *end != '\0') {
+                            fprintf(stderr, "Invalid line number: %s\n", argv[i + 1]);
+                            exit(1);
+                        }
+                        args.edit_text = argv[i + 2];
+                        i += 2;
+                        break;
+                    }
+
+                    case ACTION_COUNT:
+                        args.count = true;
+                        break;
+
+                    case ACTION_QUIET:
+                        args.quiet = true;
+                        break;
+
+                    case ACTION_HEAD:
+                    case ACTION_TAIL:
+                    case ACTION_RANGE:
+                        if (i + 1 >= argc) {
+                            fprintf(stderr, "Please supply a line count after %s\n", argv[i]);
+                            exit(1);
+                        }
+                        // A window implies -c; the last one given wins
+                        if (!parse_window(flags[j].action, argv[i + 1], &args.window)) {
+                            fprintf(stderr, "Invalid %s: %s\n", argv[i] + 2, argv[i + 1]);
+                            exit(1);
+                        }
+                        args.check = true;
+                        i++;
+                        break;
+
+                    case ACTION_SEARCH:
+                        if (i + 1 >= argc) {
+                            fprintf(stderr, "Please supply a pattern after -s\n");
+                            exit(1);
+                        }
+                        args.search = argv[i + 1];
+                        i++;
+                        break;
+
+                    case ACTION_IGNORE_CASE:
+                        args.ignore_case = true;
+                        break;
+
+                    case ACTION_ALL:
+                        // Every line, due or not, unless a window narrows it
+                        if (args.window.kind == WINDOW_ALL) args.window.kind = WINDOW_FULL;
+                        args.check = true;
+                        break;
+
+                    case ACTION_DAEMON:
+                        args.daemon = true;
+                        break;
+
+                    case ACTION_NOTIFY:
+                        if (i + 1 >= argc) {
+                            fprintf(stderr, "Please supply a FIFO or command after --notify\n");
+                            exit(1);
+                        }
+                        args.notify = argv[i + 1];
+                        args.daemon = true;
+                        i++;
+                        break;
+
+                    case ACTION_SERVE:
+                        args.serve = true;
+                        break;
+
+                    case ACTION_WATCH:
+                        args.watch = true;
+                        break;
+
+                    case ACTION_BATCH:
+                        if (i + 1 >= argc) {
+                            fprintf(stderr, "Please supply a file (or -) after --batch\n");
+                            exit(1);
+                        }
+                        args.batch = argv[i + 1];
+                        i++;
+                        break;
+
+                    case ACTION_TAG:
+                        if (i + 1 >= argc) {
+                            fprintf(stderr, "Please supply a tag after -t\n");
+                            exit(1);
+                        }
+                        args.tag = argv[i + 1];
+                        i++;
+                        break;
+
                     case ACTION_HELP:
                         args.check = false; // Clear other flags
-                        args.add = NULL;
-                        args.delete = -1;
+                        args.count = false;
+                        args.quiet = false;
+                        args.window.kind = WINDOW_ALL;
+                        args.search = NULL;
+                        args.tag = NULL;
+                        args.daemon = false;
+                        args.serve = false;
+                        args.watch = false;
+                        args.batch = NULL;
+                        args.edit_text = NULL;
+                        args.add_count = 0;
+                        line_set_free(&args.delete);
                         break;
                         
                     case ACTION_EDIT:
@@ -276,9 +441,10 @@ int main(int argc, char **argv) {
     }
 
     char file_path[PATH_MAX];
-    snprintf(file_path, sizeof(file_path),
-             "%s/.local/state/remind/reminders",
-             getenv("HOME"));
+    if (!remind_default_path(file_path, sizeof(file_path))) {
+        return 1;
+    }
+    TRACE_END(TRACE_ARGS);
 
     // Determine which action to take
     Action chosen_action = ACTION_EDIT; // Default action
@@ -292,45 +458,135 @@ int main(int argc, char **argv) {
     }
     
     if (chosen_action != ACTION_HELP) {
-        if (args.check) {
+        if (args.serve) {
+            chosen_action = ACTION_SERVE;
+        } else if (args.daemon) {
+            chosen_action = ACTION_DAEMON;
+        } else if (args.watch) {
+            chosen_action = ACTION_WATCH;
+        } else if (args.batch) {
+            chosen_action = ACTION_BATCH;
+        } else if (args.quiet) {
+            chosen_action = ACTION_QUIET;
+        } else if (args.count) {
+            chosen_action = ACTION_COUNT;
+        } else if (args.search) {
+            chosen_action = ACTION_SEARCH;
+        } else if (args.tag) {
+            chosen_action = ACTION_TAG;
+        } else if (args.check) {
             chosen_action = ACTION_CHECK;
-        } else if (args.delete >= 0) {
+        } else if (args.edit_text) {
+            chosen_action = ACTION_EDIT_LINE;
+        } else if (args.delete.count > 0) {
             chosen_action = ACTION_DELETE;
-        } else if (args.add != NULL) {
+        } else if (args.add_count > 0) {
             chosen_action = ACTION_ADD;
         }
     }
 
+    int rc = 0;
     switch (chosen_action) {
         case ACTION_CHECK:
-            check_reminders(file_path);
+            // A server only keeps the plain -c rendering
+            if (args.window.kind != WINDOW_ALL || (rc = ask_server(file_path, SERVE_CHECK, NULL, 0)) < 0) {
+                rc = remind_check_window(file_path, STDOUT_FILENO, &args.window) == 0 ? 0 : 1;
+            }
+            break;
+
+        case ACTION_SEARCH: {
+            // Like grep, the exit status says whether anything matched
+            long matches = remind_search(file_path, STDOUT_FILENO, args.search, args.ignore_case);
+            rc = matches > 0 ? 0 : 1;
             break;
+        }
             
+        case ACTION_TAG: {
+            // A filtered -c: no matches is not a failure
+            long matches = remind_check_tag(file_path, STDOUT_FILENO, args.tag);
+            rc = matches < 0 ? 1 : 0;
+            break;
+        }
+
+        case ACTION_DAEMON:
+            // Only returns when it could not start
+            remind_daemon(file_path, args.notify);
+            rc = 1;
+            break;
+
+        case ACTION_WATCH:
+            // Takes the window given with it, like -c
+            rc = remind_watch(file_path, STDOUT_FILENO, &args.window) == 0 ? 0 : 1;
+            break;
+
+        case ACTION_BATCH:
+            remind_ensure_dir(file_path);
+            rc = run_batch(file_path, args.batch) == 0 ? 0 : 1;
+            break;
+
+        case ACTION_SERVE:
+            rc = remind_serve(file_path) == 0 ? 0 : 1;
+            break;
+
+        case ACTION_EDIT_LINE:
+            rc = remind_edit(file_path, args.edit_line, args.edit_text, strlen(args.edit_text)) == 0 ? 0 : 1;
+            break;
+
         case ACTION_DELETE:
-            ensure_remind_dir(file_path);
-            delete_line(file_path, args.delete);
+            remind_ensure_dir(file_path);
+            rc = ask_server(file_path, SERVE_DELETE, args.delete.ranges,
+                            (size_t) args.delete.count * sizeof(*args.delete.ranges));
+            if (rc < 0) {
+                rc = remind_delete(file_path, &args.delete) < 0 ? 1 : 0;
+            }
             break;
             
         case ACTION_ADD:
-            ensure_remind_dir(file_path);
-            add_reminder(file_path, args.add);
+            remind_ensure_dir(file_path);
+            rc = add_reminders(file_path, args.add, args.add_count) == 0 ? 0 : 1;
             break;
             
+        case ACTION_COUNT:
+            rc = ask_server(file_path, SERVE_COUNT, NULL, 0);
+            if (rc < 0) {
+                rc = 0;
+                printf("%llu\n", (unsigned long long) remind_count(file_path));
+            }
+            break;
+
+        case ACTION_QUIET: {
+            // Counts what --count would; an empty list is still one stat()
+            rc = remind_count(file_path) > 0 ? 0 : 1;
+            break;
+        }
+
         case ACTION_HELP:
             print_help();
             break;
             
-        case ACTION_EDIT:
-            ensure_remind_dir(file_path);
+        case ACTION_EDIT: {
+            remind_ensure_dir(file_path);
+            // The editor gets a plain list: tombstoned lines gone, chunks joined
+            remind_compact(file_path);
             char *editor = getenv("EDITOR");
             if (!editor) {
                 editor = "vi";
             }
             char *const exec_args[] = {editor, file_path, NULL};
+            // atexit handlers do not survive exec, so report now
+            remind_trace_report();
             execvp(editor, exec_args);
             perror("execvp");
-            return 1;
+            rc = 1;
+            break;
+        }
+
+        default:
+            // --head, --tail, --range, -i and --notify only qualify another action
+            break;
     }
 
-    return 0;
+    line_set_free(&args.delete);
+    free(args.add);
+    return rc;
 }
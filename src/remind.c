@@ -0,0 +1,1760 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "remind.h"
+
+/// Writes all of buf, retrying short writes and EINTR
+int write_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = TRACED(write(fd, buf, len));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        remind_trace.bytes_written += (uint64_t) n;
+        buf += n;
+        len -= (size_t) n;
+    }
+    return 0;
+}
+
+/// Writes every part with as few writev() calls as possible. Normally that
+/// is exactly one, which keeps an O_APPEND write contiguous in the file.
+static int writev_all(int fd, struct iovec *parts, int count) {
+    while (count > 0) {
+        ssize_t n = TRACED(writev(fd, parts, count));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        remind_trace.bytes_written += (uint64_t) n;
+        // Skip the parts that were written in full, then trim a partial one
+        while (count > 0 && (size_t) n >= parts->iov_len) {
+            n -= (ssize_t) parts->iov_len;
+            parts++;
+            count--;
+        }
+        if (count > 0) {
+            parts->iov_base = (char *) parts->iov_base + n;
+            parts->iov_len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+/// Writes everything buffered so far
+int output_flush(Output *out) {
+    int rc = write_all(out->fd, out->data, out->len);
+    if (rc != 0) {
+        perror("write");
+    }
+    out->len = 0;
+    return rc;
+}
+
+/// Makes room for at least `extra` more bytes, flushing first if the
+/// buffer would otherwise grow past OUTPUT_FLUSH_SIZE. Buffers without a
+/// file descriptor (fd < 0) are only ever written by their owner and grow
+/// without flushing.
+bool output_reserve(Output *out, size_t extra) {
+    if (out->len + extra <= out->cap) return true;
+    if (out->fd >= 0 && out->len > 0 && out->len + extra > OUTPUT_FLUSH_SIZE) {
+        output_flush(out);
+        if (extra <= out->cap) return true;
+    }
+
+    size_t cap = out->cap ? out->cap : 4096;
+    while (cap < out->len + extra) cap *= 2;
+    remind_trace.allocations++;
+    char *data = realloc(out->data, cap);
+    if (!data) {
+        perror("realloc");
+        return false;
+    }
+    out->data = data;
+    out->cap = cap;
+    return true;
+}
+
+void output_append(Output *out, const char *s, size_t n) {
+    if (!output_reserve(out, n)) return;
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+}
+
+void output_str(Output *out, const char *s) {
+    output_append(out, s, strlen(s));
+}
+
+/// Appends a single character on repeat a specific amount of times
+void output_repeat(Output *out, char c, int times) {
+    if (times <= 0 || !output_reserve(out, (size_t) times)) return;
+    memset(out->data + out->len, c, (size_t) times);
+    out->len += (size_t) times;
+}
+
+/// Appends "N. " for a list line without going through printf
+void output_line_number(Output *out, long n) {
+    char digits[24];
+    int i = sizeof(digits);
+    digits[--i] = ' ';
+    digits[--i] = '.';
+    do {
+        digits[--i] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n > 0);
+    output_append(out, digits + i, sizeof(digits) - i);
+}
+
+void output_free(Output *out) {
+    free(out->data);
+    out->data = NULL;
+    out->len = out->cap = 0;
+}
+
+/// Prints the banner, width characters wide, that starts every listing
+bool remind_render_header(Output *out, int width) {
+    const int title_length = 9;
+    if (width < title_length + 2) {
+        width = title_length + 4;
+    }
+    int space_length = (width - title_length - 2) / 2;
+    char *title = "Reminders";
+    output_repeat(out, '#', width); output_str(out, "\n#");
+    output_repeat(out, ' ', space_length); output_str(out, title); output_repeat(out, ' ', space_length); output_str(out, "#\n");
+    output_repeat(out, '#', width); output_str(out, "\n");
+    return true;
+}
+
+/// Creates dir_path and any missing parents, like `mkdir -p`.
+/// The common case is a directory that already exists, which costs a
+/// single stat(). Components that appear between our stat() and mkdir()
+/// (another shell starting up at the same time) are not treated as errors.
+static int make_dirs(const char *dir_path) {
+    struct stat st;
+    if (TRACED(stat(dir_path, &st)) == 0) {
+        return S_ISDIR(st.st_mode) ? 0 : -1;
+    }
+
+    char path[PATH_MAX];
+    size_t len = strlen(dir_path);
+    if (len == 0 || len >= sizeof(path)) {
+        return -1;
+    }
+    memcpy(path, dir_path, len + 1);
+
+    // Walk each component, creating it if it is missing. The leading slash
+    // of an absolute path is skipped so we never try to mkdir("").
+    for (char *p = path + 1; ; p++) {
+        if (*p != '/' && *p != '\0') continue;
+
+        char saved = *p;
+        *p = '\0';
+        if (TRACED(mkdir(path, 0755)) != 0 && errno != EEXIST) {
+            perror(path);
+            return -1;
+        }
+        *p = saved;
+        if (saved == '\0') break;
+    }
+    return 0;
+}
+
+/// Ensures the directory for the reminders file exists
+void remind_ensure_dir(const char *file_path) {
+    char dir_path[PATH_MAX];
+    snprintf(dir_path, sizeof(dir_path), "%s", file_path);
+
+    // Find the last slash to get directory path
+    char *last_slash = strrchr(dir_path, '/');
+    if (last_slash && last_slash != dir_path) {
+        *last_slash = '\0';  // Terminate string at last slash
+        TRACE_BEGIN(TRACE_DIR);
+        make_dirs(dir_path);
+        TRACE_END(TRACE_DIR);
+    }
+}
+
+/// Takes an advisory lock on "<file_path>.lock" and returns its descriptor,
+/// or -1 if the lock file cannot be used. Appends run under LOCK_SH: each
+/// one is a single O_APPEND write, which the kernel already orders against
+/// other appends, so adders never wait for each other. Anything that
+/// shifts or truncates bytes takes LOCK_EX so it cannot race an append or
+/// pull pages out from under a reader's mapping. A separate lock file is
+/// used so the lock survives rename()-based rewrites of the list itself.
+int remind_lock(const char *file_path, int operation) {
+    char lock_path[PATH_MAX];
+    if (snprintf(lock_path, sizeof(lock_path), "%s.lock", file_path) >= (int) sizeof(lock_path)) {
+        return -1;
+    }
+    int fd = TRACED(open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+    if (fd < 0) {
+        return -1;
+    }
+    while (TRACED(flock(fd, operation)) != 0) {
+        if (errno != EINTR) {
+            perror("flock");
+            TRACED(close(fd));
+            return -1;
+        }
+    }
+    return fd;
+}
+
+/// Releases a lock taken with remind_lock()
+void remind_unlock(int lock_fd) {
+    if (lock_fd >= 0) {
+        TRACED(close(lock_fd));
+    }
+}
+
+/// Replaces file_path with the concatenation of parts by writing a temporary
+/// file next to it and rename()ing it into place, so a crash at any point
+/// leaves either the old list or the new one, never a partial file. Derived
+/// files that can always be rebuilt pass sync = false to skip the fsync.
+int remind_replace_file(const char *file_path, const struct iovec *parts, int count, bool sync) {
+    char tmp_path[PATH_MAX];
+    if (snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", file_path) >= (int) sizeof(tmp_path)) {
+        fprintf(stderr, "Path too long: %s\n", file_path);
+        return -1;
+    }
+    int fd = TRACED(mkstemp(tmp_path));
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+
+    struct stat st;
+    if (TRACED(stat(file_path, &st)) == 0) {
+        TRACED(fchmod(fd, st.st_mode & 07777));
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (write_all(fd, parts[i].iov_base, parts[i].iov_len) != 0) {
+            perror("write");
+            TRACED(close(fd));
+            TRACED(unlink(tmp_path));
+            return -1;
+        }
+    }
+    if ((sync && TRACED(fsync(fd)) != 0) || TRACED(close(fd)) != 0) {
+        perror("fsync");
+        TRACED(unlink(tmp_path));
+        return -1;
+    }
+    if (TRACED(rename(tmp_path, file_path)) != 0) {
+        perror("rename");
+        TRACED(unlink(tmp_path));
+        return -1;
+    }
+    return 0;
+}
+
+/// True when REMIND_SAFE_WRITES asks for rewrite-and-rename updates
+bool remind_safe_writes(void) {
+    const char *v = getenv("REMIND_SAFE_WRITES");
+    return v && *v && strcmp(v, "0") != 0;
+}
+
+/// Maps a whole file read-only. Returns NULL for empty files, which
+/// mmap() refuses, so callers treat that the same as "nothing to show".
+static const char *map_file(int fd, size_t *size) {
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) != 0) {
+        perror("fstat");
+        return NULL;
+    }
+    *size = (size_t) st.st_size;
+    if (*size == 0) {
+        return NULL;
+    }
+
+    void *data = TRACED(mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0));
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    // Mapped, not read, but render touches every byte of it
+    remind_trace.bytes_read += *size;
+    return data;
+}
+
+/// Maps the list and loads its tombstones for a caller that already holds
+/// the lock. An empty list is not an error: it opens with data == NULL and
+/// yields no lines.
+int remind_list_open_locked(RemindList *list, const char *file_path) {
+    int lock_fd = list->lock_fd;
+    memset(list, 0, sizeof(*list));
+    list->lock_fd = lock_fd;
+    int fd = TRACED(open(file_path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        // No plain file: the list may be kept in chunks instead
+        int open_errno = errno;
+        int rc = open_errno == ENOENT ? remind_chunks_read(list, file_path) : 1;
+        if (rc == 1) {
+            errno = open_errno;
+            perror("open");
+        }
+        return rc == 0 ? 0 : -1;
+    }
+    if (TRACED(fstat(fd, &list->st)) != 0) {
+        perror("fstat");
+        TRACED(close(fd));
+        return -1;
+    }
+    list->data = map_file(fd, &list->size);
+    TRACED(close(fd));
+    if (!list->data) {
+        list->size = 0;
+    }
+    if (remind_tombs_load(list, file_path) != 0) {
+        // Showing deleted lines again would be worse than failing
+        if (list->data) TRACED(munmap((void *) list->data, list->size));
+        list->data = NULL;
+        list->size = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/// Opens and maps the list under a shared lock, held until the mapping is
+/// gone so a delete cannot truncate under us
+int remind_list_open(RemindList *list, const char *file_path) {
+    list->lock_fd = remind_lock(file_path, LOCK_SH);
+    if (remind_list_open_locked(list, file_path) != 0) {
+        remind_unlock(list->lock_fd);
+        list->lock_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void remind_list_close(RemindList *list) {
+    if (list->copied) {
+        free((void *) list->data);
+    } else if (list->data) {
+        TRACED(munmap((void *) list->data, list->size));
+    }
+    free(list->dead);
+    remind_unlock(list->lock_fd);
+    memset(list, 0, sizeof(*list));
+    list->lock_fd = -1;
+}
+
+/// True when the line starting at offset is tombstoned. cursor walks
+/// list->dead forwards, so a full pass over the list costs one comparison
+/// per line.
+static bool line_is_dead(const RemindList *list, size_t offset, size_t *cursor) {
+    while (*cursor < list->dead_count && list->dead[*cursor] < offset) (*cursor)++;
+    return *cursor < list->dead_count && list->dead[*cursor] == offset;
+}
+
+/// Number of tombstoned lines that start before offset
+size_t remind_dead_before(const RemindList *list, uint64_t offset) {
+    size_t low = 0, high = list->dead_count;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (list->dead[mid] < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+/// Stats whichever file versions the list: the list itself, or the
+/// manifest of a chunked list (see remind_chunks_stat()). A plain list
+/// costs the same single stat() as always.
+int remind_list_stat(const char *file_path, struct stat *st) {
+    if (TRACED(stat(file_path, st)) == 0) {
+        return 0;
+    }
+    int stat_errno = errno;
+    if (stat_errno == ENOENT && remind_chunks_stat(file_path, st) == 0) {
+        return 0;
+    }
+    errno = stat_errno;
+    return -1;
+}
+
+/// Advances line to the next live line of the list, starting from a zeroed
+/// line
+bool remind_next_line(const RemindList *list, RemindLine *line) {
+    if (!list->data) {
+        return false;
+    }
+    const char *end = list->data + list->size;
+    const char *p = line->number == 0 ? list->data : line->text + line->len + 1;
+    for (; p < end; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        if (line_is_dead(list, p - list->data, &line->next_dead)) {
+            p = line_end + 1;
+            continue;
+        }
+        line->text = p;
+        line->len = line_end - p;
+        line->number++;
+        return true;
+    }
+    return false;
+}
+
+/// Builds the default list location, $HOME/.local/state/remind/reminders
+bool remind_default_path(char *out, size_t out_size) {
+    const char *home = getenv("HOME");
+    if (!home) {
+        fprintf(stderr, "HOME is not set\n");
+        return false;
+    }
+    return snprintf(out, out_size, "%s/.local/state/remind/reminders", home) < (int) out_size;
+}
+
+FileStamp file_stamp(const struct stat *st) {
+    FileStamp stamp = {
+        .size = (uint64_t) st->st_size,
+        .mtime_sec = (int64_t) st->st_mtime,
+        .ino = (uint64_t) st->st_ino,
+        .dev = (uint64_t) st->st_dev,
+    };
+#if defined(__APPLE__)
+    stamp.mtime_nsec = st->st_mtimespec.tv_nsec;
+#else
+    stamp.mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+    return stamp;
+}
+
+bool file_stamp_equal(const FileStamp *a, const FileStamp *b) {
+    return a->size == b->size && a->mtime_sec == b->mtime_sec &&
+           a->mtime_nsec == b->mtime_nsec && a->ino == b->ino && a->dev == b->dev;
+}
+
+/// Whether a stamp taken from st may be stored in a sidecar. Like git's
+/// index, a file modified within the last couple of seconds is not: a
+/// same-size rewrite in the same timestamp tick would be indistinguishable.
+bool file_stamp_settled(const struct stat *st) {
+    return time(NULL) - st->st_mtime >= 2;
+}
+
+/// Builds "<file_path><suffix>" for the files kept beside the list
+bool remind_sidecar_path(char *out, size_t out_size, const char *file_path, const char *suffix) {
+    return snprintf(out, out_size, "%s%s", file_path, suffix) < (int) out_size;
+}
+
+/// Renders the banner and numbered list for a mapped file into out
+void remind_render(Output *out, const char *data, size_t size) {
+    RemindList list = { .data = data, .size = size, .lock_fd = -1 };
+    remind_render_list(out, &list);
+}
+
+/// Renders the live lines of an open list, numbered as if the tombstoned
+/// ones were already gone
+void remind_render_list(Output *out, const RemindList *list) {
+    remind_render_shown(out, list, NULL, 0);
+}
+
+/// Like remind_render_list(), but leaves out the physical lines in hidden
+/// (sorted), which still take up their numbers
+void remind_render_shown(Output *out, const RemindList *list, const uint32_t *hidden, size_t hidden_count) {
+    const char *data = list->data;
+    size_t size = list->size;
+    const char *end = data + size;
+
+    /* First pass: count lines and find the widest one. The width includes
+     * the newline so headers line up with what earlier versions printed.
+     */
+    TRACE_BEGIN(TRACE_READ);
+    size_t longest_length = 0;
+    long line_count = 0;
+    long shown_last = 0;
+    size_t cursor = 0;
+    size_t h = 0;
+    uint32_t physical = 0;
+    for (const char *p = data; p < end; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        physical++;
+        while (h < hidden_count && hidden[h] < physical) h++;
+        if (!line_is_dead(list, p - data, &cursor)) {
+            line_count++;
+            if (h == hidden_count || hidden[h] != physical) {
+                size_t length = (line_end - p) + 1;
+                if (length > longest_length) longest_length = length;
+                shown_last = line_count;
+            }
+        }
+        p = line_end + 1;
+    }
+
+    TRACE_END(TRACE_READ);
+    if (shown_last == 0) {
+        return;
+    }
+
+    char num_string[32];
+    int longest_number_length = snprintf(num_string, sizeof(num_string), "%ld", shown_last + 1) + NUMBER_SPACING;
+
+    /* Reserve room for the whole rendering up front (capped at the flush
+     * size) so a typical list is built without any reallocation.
+     */
+    int width = (int) longest_length + longest_number_length;
+    size_t estimate = 3 * ((size_t) width + 2) + size + (size_t) line_count * longest_number_length + 2;
+    output_reserve(out, estimate < OUTPUT_FLUSH_SIZE ? estimate : OUTPUT_FLUSH_SIZE);
+
+    /* The header feature is supposed to be used to grab attention
+     * when the user integrates the program into their shell startup.
+     * Logically they only want to see it if there are items on the list
+     * which is why an empty file prints nothing at all.
+     */
+    remind_render_header(out, width);
+
+    // Second pass: copy each line straight out of the mapping
+    TRACE_BEGIN(TRACE_RENDER);
+    long lineno = 0;
+    cursor = 0;
+    h = 0;
+    physical = 0;
+    for (const char *p = data; p < end; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        physical++;
+        while (h < hidden_count && hidden[h] < physical) h++;
+        if (!line_is_dead(list, p - data, &cursor)) {
+            lineno++;
+            if (h == hidden_count || hidden[h] != physical) {
+                output_line_number(out, lineno);
+                output_append(out, p, line_end - p);
+                output_append(out, "\n", 1);
+            }
+        }
+        p = line_end + 1;
+    }
+    output_append(out, "\n", 1);
+    TRACE_END(TRACE_RENDER);
+}
+
+/// Renders what -c shows at now: the live lines that are due. Sets
+/// valid_until to when that next changes (REMIND_NEVER if it never does).
+void remind_render_due(Output *out, const RemindList *list, const char *file_path, int64_t now,
+                       int64_t *valid_until) {
+    uint32_t *hidden;
+    size_t hidden_count;
+    remind_due_hidden(list, file_path, now, &hidden, &hidden_count, valid_until);
+    remind_render_shown(out, list, hidden, hidden_count);
+    free(hidden);
+}
+
+/// Header of reminders.cache, followed directly by the rendered bytes. A
+/// list with scheduled reminders renders differently once the next one
+/// comes due, so the rendering is only good until valid_until.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    int64_t valid_until;
+} CacheHeader;
+
+#define CACHE_MAGIC "RMDCACHE"
+#define CACHE_VERSION 2
+
+/// Writes the cached rendering of the list if it was made from exactly this
+/// version of the file and is still current at now. Returns false on any
+/// miss so the caller renders.
+static bool write_cached_render(const char *file_path, const struct stat *st, int64_t now, int out_fd) {
+    char cache_path[PATH_MAX];
+    if (!remind_sidecar_path(cache_path, sizeof(cache_path), file_path, ".cache")) return false;
+    int fd = TRACED(open(cache_path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+
+    struct stat cache_st;
+    if (TRACED(fstat(fd, &cache_st)) != 0 || (size_t) cache_st.st_size < sizeof(CacheHeader)) {
+        TRACED(close(fd));
+        return false;
+    }
+    size_t size = (size_t) cache_st.st_size;
+    remind_trace.allocations++;
+    char *buf = malloc(size);
+    if (!buf) {
+        TRACED(close(fd));
+        return false;
+    }
+    ssize_t n = TRACED(read(fd, buf, size));
+    TRACED(close(fd));
+    if (n > 0) remind_trace.bytes_read += (uint64_t) n;
+
+    CacheHeader header;
+    FileStamp source = file_stamp(st);
+    bool hit = false;
+    if (n == (ssize_t) size) {
+        memcpy(&header, buf, sizeof(header));
+        hit = memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == CACHE_VERSION &&
+              header.header_size == sizeof(header) &&
+              file_stamp_equal(&header.source, &source) &&
+              now < header.valid_until;
+    }
+    if (hit) {
+        TRACE_BEGIN(TRACE_WRITE);
+        write_all(out_fd, buf + sizeof(header), size - sizeof(header));
+        TRACE_END(TRACE_WRITE);
+    }
+    free(buf);
+    return hit;
+}
+
+/// Stores a rendering for later -c calls. The cache is replaced with
+/// rename() so readers see either the old or the new one, never a mix.
+/// A file modified within the last couple of seconds is not cached (see
+/// file_stamp_settled()).
+static void save_render_cache(const char *file_path, const struct stat *st, int64_t valid_until,
+                              const char *rendered, size_t len) {
+    if (!file_stamp_settled(st)) return;
+
+    char cache_path[PATH_MAX];
+    if (!remind_sidecar_path(cache_path, sizeof(cache_path), file_path, ".cache")) return;
+
+    CacheHeader header = {
+        .version = CACHE_VERSION,
+        .header_size = sizeof(header),
+        .source = file_stamp(st),
+        .valid_until = valid_until,
+    };
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+
+    struct iovec parts[] = {
+        { &header, sizeof(header) },
+        { (void *) rendered, len },
+    };
+    remind_replace_file(cache_path, parts, 2, false);
+}
+
+/// Counts lines the same way check_reminders() numbers them: every newline
+/// ends a line, and trailing text without one is a line of its own.
+uint64_t remind_count_lines(const char *data, size_t size) {
+    uint64_t count = 0;
+    const char *end = data + size;
+    for (const char *p = data; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+        count++;
+    }
+    if (size > 0 && data[size - 1] != '\n') count++;
+    return count;
+}
+
+/// Contents of reminders.count: the number of lines in one FileStamp version
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    uint64_t count;
+} CountRecord;
+
+#define COUNT_MAGIC "RMDCOUNT"
+#define COUNT_VERSION 1
+
+/// Reads the stored line count if it belongs to exactly this file version
+static bool read_count_cache(const char *file_path, const FileStamp *stamp, uint64_t *count) {
+    char count_path[PATH_MAX];
+    if (!remind_sidecar_path(count_path, sizeof(count_path), file_path, ".count")) return false;
+    int fd = TRACED(open(count_path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+
+    CountRecord record;
+    ssize_t n = TRACED(read(fd, &record, sizeof(record)));
+    TRACED(close(fd));
+    if (n > 0) remind_trace.bytes_read += (uint64_t) n;
+    if (n != (ssize_t) sizeof(record) ||
+        memcmp(record.magic, COUNT_MAGIC, sizeof(record.magic)) != 0 ||
+        record.version != COUNT_VERSION ||
+        record.header_size != sizeof(record) ||
+        !file_stamp_equal(&record.source, stamp)) {
+        return false;
+    }
+    *count = record.count;
+    return true;
+}
+
+static void save_count_cache(const char *file_path, const struct stat *st, uint64_t count) {
+    char count_path[PATH_MAX];
+    if (!remind_sidecar_path(count_path, sizeof(count_path), file_path, ".count")) return;
+
+    CountRecord record = {
+        .version = COUNT_VERSION,
+        .header_size = sizeof(record),
+        .source = file_stamp(st),
+        .count = count,
+    };
+    memcpy(record.magic, COUNT_MAGIC, sizeof(record.magic));
+    struct iovec part = { &record, sizeof(record) };
+    remind_replace_file(count_path, &part, 1, false);
+}
+
+/// Carries a known count across one of our own mutations. Only applies when
+/// the stored count matched the file right before the change, so anything
+/// else that touched the list in between simply leaves the count stale.
+static void adjust_count_cache(const char *file_path, const struct stat *before, const struct stat *after, int64_t delta) {
+    FileStamp stamp = file_stamp(before);
+    uint64_t count;
+    if (read_count_cache(file_path, &stamp, &count) && (int64_t) count + delta >= 0) {
+        save_count_cache(file_path, after, (uint64_t) ((int64_t) count + delta));
+    }
+}
+
+/// How many of the list's `live` reminders -c shows at now. Hidden lines
+/// that are also tombstoned were never among the live ones.
+uint64_t remind_count_shown(const RemindList *list, const char *file_path, uint64_t live, int64_t now) {
+    uint32_t *hidden;
+    size_t hidden_count;
+    int64_t valid_until;
+    if (remind_due_hidden(list, file_path, now, &hidden, &hidden_count, &valid_until) != 0) {
+        return live;
+    }
+    size_t dead_hidden = 0;
+    if (list->dead_count > 0 && hidden_count > 0) {
+        const char *data = list->data;
+        const char *end = data + list->size;
+        size_t cursor = 0;
+        size_t h = 0;
+        uint32_t physical = 0;
+        for (const char *p = data; p < end && h < hidden_count; ) {
+            const char *nl = memchr(p, '\n', end - p);
+            physical++;
+            if (hidden[h] == physical) {
+                if (line_is_dead(list, p - data, &cursor)) dead_hidden++;
+                h++;
+            }
+            p = nl ? nl + 1 : end;
+        }
+    }
+    free(hidden);
+    uint64_t shown_hidden = hidden_count - dead_hidden;
+    return live > shown_hidden ? live - shown_hidden : 0;
+}
+
+/// Returns the number of reminders -c would show now. An empty or missing
+/// list costs a single stat(); otherwise the stored count is used while it
+/// matches the file, less what the due heap says is hidden, and the list is
+/// only opened when either of them is out of date (or lines are tombstoned).
+uint64_t remind_count(const char *file_path) {
+    struct stat st;
+    if (remind_list_stat(file_path, &st) != 0 || st.st_size == 0) {
+        return 0;
+    }
+    FileStamp stamp = file_stamp(&st);
+    int64_t now = (int64_t) time(NULL);
+    uint64_t count;
+    size_t hidden;
+    bool cached = read_count_cache(file_path, &stamp, &count);
+    if (cached && !remind_tombs_exist(file_path) && remind_due_peek(file_path, &stamp, now, &hidden)) {
+        return count > hidden ? count - hidden : 0;
+    }
+
+    RemindList list;
+    if (remind_list_open(&list, file_path) != 0) {
+        return 0;
+    }
+    if (!list.data) {
+        remind_list_close(&list);
+        return 0;
+    }
+    FileStamp opened = file_stamp(&list.st);
+    if (!cached || !file_stamp_equal(&opened, &stamp)) {
+        count = remind_count_lines(list.data, list.size) - list.dead_count;
+        // Same racy-timestamp guard as the render cache
+        if (file_stamp_settled(&list.st)) {
+            save_count_cache(file_path, &list.st, count);
+        }
+    }
+    count = remind_count_shown(&list, file_path, count, now);
+    remind_list_close(&list);
+    return count;
+}
+
+/// Checks the reminders in the file and writes the ones due now to fd.
+/// Shell startup is the hot path: an empty list costs one stat(), and an
+/// unchanged list is a stat() plus one read and one write of the cached
+/// rendering, until a scheduled reminder comes or goes.
+int remind_check(const char *file_path, int fd) {
+    struct stat st;
+    // As remind_list_stat(), noting which of the two it found
+    bool plain = TRACED(stat(file_path, &st)) == 0;
+    bool chunked = !plain && errno == ENOENT && remind_chunks_stat(file_path, &st) == 0;
+    if (!plain && !chunked) {
+        // Create the directory and an empty file if they don't exist
+        remind_ensure_dir(file_path);
+        int new_fd = TRACED(open(file_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644));
+        if (new_fd >= 0) {
+            TRACED(close(new_fd));
+        }
+        // No reminders to show yet
+        return 0;
+    }
+    int64_t now = (int64_t) time(NULL);
+    if (st.st_size == 0 || write_cached_render(file_path, &st, now, fd)) {
+        return 0;
+    }
+
+    /* Lists that render to less than the flush size are built in memory so
+     * the same bytes can be cached; anything larger streams to fd. A
+     * chunked list streams from its chunks one at a time.
+     */
+    Output out = { .fd = fd };
+    int64_t valid_until;
+    if (chunked) {
+        int lock_fd = remind_lock(file_path, LOCK_SH);
+        int rendered = remind_chunks_render(&out, file_path, now, &valid_until, &st);
+        remind_unlock(lock_fd);
+        if (rendered != 0) {
+            output_free(&out);
+            return -1;
+        }
+    } else {
+        RemindList list;
+        TRACE_BEGIN(TRACE_OPEN);
+        int opened = remind_list_open(&list, file_path);
+        TRACE_END(TRACE_OPEN);
+        if (opened != 0) {
+            return -1;
+        }
+        if (!list.data) {
+            remind_list_close(&list);
+            return 0;
+        }
+        if (list.size < OUTPUT_FLUSH_SIZE / 2) out.fd = -1;
+        remind_render_due(&out, &list, file_path, now, &valid_until);
+        st = list.st;
+        remind_list_close(&list);
+    }
+
+    int rc = 0;
+    bool cacheable = out.fd < 0;
+    TRACE_BEGIN(TRACE_WRITE);
+    if (cacheable) {
+        rc = write_all(fd, out.data, out.len);
+        save_render_cache(file_path, &st, valid_until, out.data, out.len);
+    } else {
+        rc = output_flush(&out);
+    }
+    TRACE_END(TRACE_WRITE);
+    output_free(&out);
+    return rc;
+}
+
+/// Live lines in an open list, from the stored count when it matches
+static uint64_t list_live_count(const char *file_path, const RemindList *list) {
+    FileStamp stamp = file_stamp(&list->st);
+    uint64_t count;
+    if (read_count_cache(file_path, &stamp, &count)) {
+        return count;
+    }
+    return remind_count_lines(list->data, list->size) - list->dead_count;
+}
+
+/// Sets start to the iteration state just before live line first
+static void seek_before(const RemindList *list, const char *file_path, long first, RemindLine *start) {
+    remind_seek_line(list, file_path, first, start);
+    for (;;) {
+        RemindLine next = *start;
+        if (!remind_next_line(list, &next) || next.number >= first) break;
+        *start = next;
+    }
+}
+
+/// Sets start to the iteration state just before the last `count` live
+/// lines. The lines are found walking back from the end of the file, so
+/// only the stored count (or, failing that, one memchr pass) is needed to
+/// number them.
+static void seek_tail(const RemindList *list, const char *file_path, long count, RemindLine *start) {
+    memset(start, 0, sizeof(*start));
+    uint64_t total = list_live_count(file_path, list);
+    if ((uint64_t) count >= total) return;
+
+    const char *data = list->data;
+    size_t end = list->size;
+    if (data[end - 1] == '\n') end--;
+    long found = 0;
+    size_t line_start;
+    for (;;) {
+        line_start = end;
+        while (line_start > 0 && data[line_start - 1] != '\n') line_start--;
+        size_t d = remind_dead_before(list, line_start);
+        bool dead = d < list->dead_count && list->dead[d] == line_start;
+        if ((!dead && ++found == count) || line_start == 0) break;
+        end = line_start - 1;
+    }
+
+    // A zero-length line ending just before the first one shown
+    start->text = data + line_start - 1;
+    start->number = (long) (total - (uint64_t) count);
+    start->next_dead = remind_dead_before(list, line_start);
+}
+
+/// Renders part of an open list. Only the lines in the window are read,
+/// so a head or range of a huge list touches just the pages it shows.
+void remind_render_window(Output *out, const RemindList *list, const char *file_path, const LineWindow *window) {
+    RemindLine start = {0};
+    long last = LONG_MAX;
+    switch (window->kind) {
+        case WINDOW_ALL:
+        case WINDOW_FULL:
+            remind_render_list(out, list);
+            return;
+        case WINDOW_HEAD:
+            last = window->count;
+            break;
+        case WINDOW_TAIL:
+            if (list->data) seek_tail(list, file_path, window->count, &start);
+            break;
+        case WINDOW_RANGE:
+            last = window->last;
+            seek_before(list, file_path, window->first, &start);
+            break;
+    }
+
+    // First pass: the widest line and the last number in the window
+    TRACE_BEGIN(TRACE_READ);
+    RemindLine line = start;
+    size_t longest_length = 0;
+    long shown_last = 0;
+    size_t shown_bytes = 0;
+    while (line.number < last && remind_next_line(list, &line)) {
+        if (line.len + 1 > longest_length) longest_length = line.len + 1;
+        shown_last = line.number;
+        shown_bytes += line.len + 1;
+    }
+    TRACE_END(TRACE_READ);
+    if (shown_last == 0) {
+        return;
+    }
+
+    char num_string[32];
+    int longest_number_length = snprintf(num_string, sizeof(num_string), "%ld", shown_last + 1) + NUMBER_SPACING;
+    int width = (int) longest_length + longest_number_length;
+    long shown = shown_last - start.number;
+    size_t estimate = 3 * ((size_t) width + 2) + shown_bytes + (size_t) shown * longest_number_length + 2;
+    output_reserve(out, estimate < OUTPUT_FLUSH_SIZE ? estimate : OUTPUT_FLUSH_SIZE);
+    remind_render_header(out, width);
+
+    TRACE_BEGIN(TRACE_RENDER);
+    line = start;
+    while (line.number < last && remind_next_line(list, &line)) {
+        output_line_number(out, line.number);
+        output_append(out, line.text, line.len);
+        output_append(out, "\n", 1);
+    }
+    output_append(out, "\n", 1);
+    TRACE_END(TRACE_RENDER);
+}
+
+/// Writes part of the list to fd. Windows are not cached: they are cheap
+/// to build, since only the lines shown are read. Only WINDOW_ALL leaves
+/// out reminders that are not due.
+int remind_check_window(const char *file_path, int fd, const LineWindow *window) {
+    if (window->kind == WINDOW_ALL) {
+        return remind_check(file_path, fd);
+    }
+    struct stat st;
+    if (remind_list_stat(file_path, &st) != 0 || st.st_size == 0) {
+        return 0;
+    }
+
+    RemindList list;
+    TRACE_BEGIN(TRACE_OPEN);
+    int opened = remind_list_open(&list, file_path);
+    TRACE_END(TRACE_OPEN);
+    if (opened != 0) {
+        return -1;
+    }
+    Output out = { .fd = fd };
+    remind_render_window(&out, &list, file_path, window);
+    remind_list_close(&list);
+
+    TRACE_BEGIN(TRACE_WRITE);
+    int rc = output_flush(&out);
+    TRACE_END(TRACE_WRITE);
+    output_free(&out);
+    return rc;
+}
+
+/// Adds line to a growing array of matches
+static bool push_match(RemindLine **matches, size_t *count, size_t *cap, const RemindLine *line) {
+    if (*count == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        remind_trace.allocations++;
+        RemindLine *grown = realloc(*matches, *cap * sizeof(**matches));
+        if (!grown) {
+            perror("realloc");
+            return false;
+        }
+        *matches = grown;
+    }
+    (*matches)[(*count)++] = *line;
+    return true;
+}
+
+/// Prints matching lines under a banner sized for them, numbered as in
+/// the full list. Prints nothing when there are none.
+static int render_matches(int fd, const RemindLine *matches, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t longest_length = 0;
+    size_t match_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (matches[i].len + 1 > longest_length) longest_length = matches[i].len + 1;
+        match_bytes += matches[i].len + 1;
+    }
+    char num_string[32];
+    int longest_number_length = snprintf(num_string, sizeof(num_string), "%ld",
+                                         matches[count - 1].number + 1) + NUMBER_SPACING;
+    int width = (int) longest_length + longest_number_length;
+    size_t estimate = 3 * ((size_t) width + 2) + match_bytes + count * longest_number_length + 2;
+    Output out = { .fd = fd };
+    output_reserve(&out, estimate < OUTPUT_FLUSH_SIZE ? estimate : OUTPUT_FLUSH_SIZE);
+    remind_render_header(&out, width);
+
+    TRACE_BEGIN(TRACE_RENDER);
+    for (size_t i = 0; i < count; i++) {
+        output_line_number(&out, matches[i].number);
+        output_append(&out, matches[i].text, matches[i].len);
+        output_append(&out, "\n", 1);
+    }
+    output_append(&out, "\n", 1);
+    TRACE_END(TRACE_RENDER);
+
+    TRACE_BEGIN(TRACE_WRITE);
+    int rc = output_flush(&out);
+    TRACE_END(TRACE_WRITE);
+    output_free(&out);
+    return rc;
+}
+
+/// Writes the lines that match text to fd, numbered as in the full list,
+/// under a banner sized to them. Returns the number of matches, or -1.
+long remind_search(const char *file_path, int fd, const char *text, bool icase) {
+    RemindPattern pattern;
+    if (remind_pattern_compile(&pattern, text, icase) != 0) {
+        return -1;
+    }
+    struct stat st;
+    if (remind_list_stat(file_path, &st) != 0 || st.st_size == 0) {
+        remind_pattern_free(&pattern);
+        return 0;
+    }
+
+    RemindList list;
+    TRACE_BEGIN(TRACE_OPEN);
+    int opened = remind_list_open(&list, file_path);
+    TRACE_END(TRACE_OPEN);
+    if (opened != 0) {
+        remind_pattern_free(&pattern);
+        return -1;
+    }
+
+    // The scan is the expensive part, so it runs once and the matches are
+    // kept (as pointers into the list) for the banner width. It reads the
+    // mapping front to back, which the kernel can read ahead for.
+    TRACE_BEGIN(TRACE_READ);
+    RemindLine *matches = NULL;
+    size_t count = 0, cap = 0;
+    long indexed = remind_trigrams_search(&list, file_path, &pattern, &matches);
+    if (indexed >= 0) {
+        count = cap = (size_t) indexed;
+    } else if (list.data && !list.copied) {
+        posix_madvise((void *) list.data, list.size, POSIX_MADV_SEQUENTIAL);
+    }
+    RemindLine line = {0};
+    bool ok = true;
+    while (ok && indexed < 0 && remind_next_match(&list, &pattern, &line)) {
+        ok = push_match(&matches, &count, &cap, &line);
+    }
+    TRACE_END(TRACE_READ);
+    remind_pattern_free(&pattern);
+
+    int rc = ok ? render_matches(fd, matches, count) : -1;
+    free(matches);
+    remind_list_close(&list);
+    return rc == 0 ? (long) count : -1;
+}
+
+/// Lists the reminders tagged +tag (a leading '+' is optional), numbered
+/// as in the full list. Returns how many there were, or -1 on error.
+long remind_check_tag(const char *file_path, int fd, const char *tag) {
+    if (*tag == '+') tag++;
+    if (!remind_tag_valid(tag)) {
+        fprintf(stderr, "Invalid tag: %s\n", tag);
+        return -1;
+    }
+    struct stat st;
+    if (remind_list_stat(file_path, &st) != 0 || st.st_size == 0) {
+        return 0;
+    }
+
+    RemindList list;
+    TRACE_BEGIN(TRACE_OPEN);
+    int opened = remind_list_open(&list, file_path);
+    TRACE_END(TRACE_OPEN);
+    if (opened != 0) {
+        return -1;
+    }
+
+    // Without a usable tag index every line is checked
+    TRACE_BEGIN(TRACE_READ);
+    RemindLine *matches = NULL;
+    size_t count = 0, cap = 0;
+    long indexed = remind_tags_search(&list, file_path, tag, &matches);
+    if (indexed >= 0) {
+        count = cap = (size_t) indexed;
+    }
+    RemindLine line = {0};
+    bool ok = true;
+    while (ok && indexed < 0 && remind_next_line(&list, &line)) {
+        if (remind_line_has_tag(line.text, line.len, tag)) {
+            ok = push_match(&matches, &count, &cap, &line);
+        }
+    }
+    TRACE_END(TRACE_READ);
+
+    int rc = ok ? render_matches(fd, matches, count) : -1;
+    free(matches);
+    remind_list_close(&list);
+    return rc == 0 ? (long) count : -1;
+}
+
+static int compare_ranges(const void *a, const void *b) {
+    const LineRange *ra = a, *rb = b;
+    return (ra->first > rb->first) - (ra->first < rb->first);
+}
+
+/// Parses a selection such as "3", "7-20" or "1,4,7-20" and adds it to set.
+/// Ranges are sorted and merged so callers can walk them in one pass.
+bool line_set_parse(LineSet *set, const char *spec) {
+    const char *p = spec;
+    while (*p) {
+        char *endptr;
+        long first = strtol(p, &endptr, 10);
+        if (endptr == p || first < 1) return false;
+        long last = first;
+        p = endptr;
+        if (*p == '-') {
+            const char *q = p + 1;
+            last = strtol(q, &endptr, 10);
+            if (endptr == q || last < first) return false;
+            p = endptr;
+        }
+        if (*p == ',') {
+            p++;
+            if (*p == '\0') return false;
+        } else if (*p != '\0') {
+            return false;
+        }
+
+        if (set->count == set->cap) {
+            int cap = set->cap ? set->cap * 2 : 8;
+            remind_trace.allocations++;
+            LineRange *ranges = realloc(set->ranges, cap * sizeof(*ranges));
+            if (!ranges) {
+                perror("realloc");
+                return false;
+            }
+            set->ranges = ranges;
+            set->cap = cap;
+        }
+        set->ranges[set->count++] = (LineRange) { first, last };
+    }
+
+    qsort(set->ranges, set->count, sizeof(*set->ranges), compare_ranges);
+    int merged = 0;
+    for (int i = 0; i < set->count; i++) {
+        if (merged > 0 && set->ranges[i].first <= set->ranges[merged - 1].last + 1) {
+            if (set->ranges[i].last > set->ranges[merged - 1].last) {
+                set->ranges[merged - 1].last = set->ranges[i].last;
+            }
+        } else {
+            set->ranges[merged++] = set->ranges[i];
+        }
+    }
+    set->count = merged;
+    return true;
+}
+
+void line_set_free(LineSet *set) {
+    free(set->ranges);
+    set->ranges = NULL;
+    set->count = set->cap = 0;
+}
+
+/// Finds the byte range of a 1-based line, including its newline.
+/// Every newline-separated line counts, blank ones included, so the
+/// numbering always matches what check_reminders() prints.
+bool remind_find_line(const char *data, size_t size, long target_line, size_t *start, size_t *end) {
+    const char *p = data;
+    const char *stop = data + size;
+    for (long lineno = 1; p < stop; lineno++) {
+        const char *nl = memchr(p, '\n', stop - p);
+        const char *line_end = nl ? nl + 1 : stop;
+        if (lineno == target_line) {
+            *start = p - data;
+            *end = line_end - data;
+            return true;
+        }
+        p = line_end;
+    }
+    return false;
+}
+
+/// Deletes every line in the set in a single pass. Line numbers refer to the
+/// list as it was before the call, so "1,4,7-20" removes exactly the lines
+/// shown under those numbers by -c. Kept lines after the first deletion are
+/// shifted down in place and the file is truncated once at the end; nothing
+/// before the first deleted line is touched. With REMIND_SAFE_WRITES set the
+/// kept segments are written to a temporary file that is renamed over the
+/// original instead.
+static long delete_lines_locked(const char *file_path, const LineSet *set) {
+    int fd = TRACED(open(file_path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) != 0) {
+        perror("fstat");
+        TRACED(close(fd));
+        return -1;
+    }
+    size_t size = (size_t) st.st_size;
+    if (size == 0) {
+        fprintf(stderr, "No reminder at line %ld\n", set->ranges[0].first);
+        TRACED(close(fd));
+        return 0;
+    }
+
+    char *data = TRACED(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        TRACED(close(fd));
+        return -1;
+    }
+
+    /* Collect the kept byte segments. There is at most one more segment than
+     * there are ranges, so this is the only allocation regardless of size.
+     */
+    remind_trace.allocations++;
+    struct iovec *kept = malloc((set->count + 1) * sizeof(*kept));
+    if (!kept) {
+        perror("malloc");
+        TRACED(munmap(data, size));
+        TRACED(close(fd));
+        return -1;
+    }
+    int kept_count = 0;
+    size_t keep_from = 0;
+    size_t new_size = 0;
+    long removed = 0;
+    int r = 0;
+    long lineno = 1;
+    const char *stop = data + size;
+    const char *p = data;
+
+    // The index gets us most of the way to the first deleted line
+    RemindList view = { .data = data, .size = size, .st = st, .lock_fd = -1 };
+    RemindLine start;
+    remind_seek_line(&view, file_path, set->ranges[0].first, &start);
+    if (start.number > 0) {
+        p = start.text + 1;
+        lineno = start.number + 1;
+    }
+
+    // Skip straight to each range's first line; lines in between are kept
+    while (p < stop && r < set->count) {
+        if (lineno < set->ranges[r].first) {
+            const char *nl = memchr(p, '\n', stop - p);
+            p = nl ? nl + 1 : stop;
+            lineno++;
+            continue;
+        }
+
+        size_t range_start = p - data;
+        while (p < stop && lineno <= set->ranges[r].last) {
+            const char *nl = memchr(p, '\n', stop - p);
+            p = nl ? nl + 1 : stop;
+            lineno++;
+            removed++;
+        }
+        if (range_start > keep_from) {
+            kept[kept_count++] = (struct iovec) { data + keep_from, range_start - keep_from };
+            new_size += range_start - keep_from;
+        }
+        keep_from = p - data;
+        if (lineno <= set->ranges[r].last) break;  // ran off the end mid-range
+        r++;
+    }
+    if (r < set->count) {
+        long missing = set->ranges[r].first > lineno ? set->ranges[r].first : lineno;
+        fprintf(stderr, "No reminder at line %ld\n", missing);
+    }
+    if (keep_from < size) {
+        kept[kept_count++] = (struct iovec) { data + keep_from, size - keep_from };
+        new_size += size - keep_from;
+    }
+
+    if (new_size == size) {
+        // Nothing matched, leave the file alone
+    } else if (remind_safe_writes()) {
+        if (remind_replace_file(file_path, kept, kept_count, true) != 0) removed = -1;
+    } else {
+        // The first segment (if it starts at 0) is already in place
+        char *dest = data;
+        for (int i = 0; i < kept_count; i++) {
+            if ((char *) kept[i].iov_base != dest) {
+                memmove(dest, kept[i].iov_base, kept[i].iov_len);
+            }
+            dest += kept[i].iov_len;
+        }
+        TRACED(munmap(data, size));
+        data = NULL;
+        if (TRACED(ftruncate(fd, (off_t) new_size)) != 0) {
+            perror("ftruncate");
+            removed = -1;
+        }
+    }
+
+    free(kept);
+    if (data) {
+        TRACED(munmap(data, size));
+    }
+    TRACED(close(fd));
+    return removed;
+}
+
+/// Deletes by appending tombstones (see tombstone.c) rather than moving any
+/// bytes of the list. Line numbers are the live ones -c shows. The list's
+/// mtime is bumped afterwards so every FileStamp-keyed sidecar sees a new
+/// version. Once enough of the file is dead, or always when compact is set,
+/// the list is rewritten without its dead lines.
+static long delete_lines_logged(const char *file_path, const LineSet *set, bool compact) {
+    RemindList list = { .lock_fd = -1 };
+    if (remind_list_open_locked(&list, file_path) != 0) {
+        return -1;
+    }
+
+    Output records = { .fd = -1 };
+    uint64_t new_dead_bytes = 0;
+    long removed = 0;
+    int r = 0;
+    RemindLine line;
+    remind_seek_line(&list, file_path, set->ranges[0].first, &line);
+    while (r < set->count && remind_next_line(&list, &line)) {
+        while (r < set->count && line.number > set->ranges[r].last) r++;
+        if (r == set->count) break;
+        if (line.number < set->ranges[r].first) continue;
+
+        TombRecord record = {
+            .offset = (uint64_t) (line.text - list.data),
+            .len = (uint32_t) line.len,
+            .hash = remind_line_hash(line.text, line.len),
+        };
+        output_append(&records, (const char *) &record, sizeof(record));
+        new_dead_bytes += line.len + 1;
+        removed++;
+    }
+    // Ranges that end past the last live line were cut short
+    while (r < set->count && set->ranges[r].last <= line.number) r++;
+    if (r < set->count) {
+        long missing = set->ranges[r].first > line.number ? set->ranges[r].first : line.number + 1;
+        fprintf(stderr, "No reminder at line %ld\n", missing);
+    }
+
+    if (removed > 0) {
+        if (remind_tombs_append(file_path, &list.st, (const TombRecord *) records.data, (size_t) removed) != 0) {
+            removed = -1;
+        } else if (TRACED(utimensat(AT_FDCWD, file_path, NULL, 0)) != 0) {
+            perror("utimensat");
+        } else {
+            struct stat after;
+            if (TRACED(stat(file_path, &after)) == 0) {
+                remind_index_restamp(file_path, &list.st, &after);
+                remind_trigrams_restamp(file_path, &list.st, &after);
+                remind_tags_restamp(file_path, &list.st, &after);
+                remind_due_restamp(file_path, &list.st, &after);
+            }
+        }
+    }
+    compact = removed > 0 && (compact ||
+        (list.dead_bytes + new_dead_bytes) * COMPACT_DEAD_DIVISOR > list.size);
+    output_free(&records);
+    remind_list_close(&list);
+
+    // Reload so the compaction sees the tombstones just written
+    if (compact) {
+        list = (RemindList) { .lock_fd = -1 };
+        if (remind_list_open_locked(&list, file_path) != 0 ||
+            remind_compact_locked(file_path, &list) != 0) {
+            removed = -1;
+        }
+        remind_list_close(&list);
+    }
+    return removed;
+}
+
+/// Appends one reminder and its terminating newline. Embedded line breaks
+/// would silently turn one reminder into several and shift the numbering of
+/// everything after it, so they are folded into spaces.
+void remind_format(Output *out, const char *text, size_t len) {
+    if (!output_reserve(out, len + 1)) return;
+    char *dest = out->data + out->len;
+    for (size_t i = 0; i < len; i++) {
+        char c = text[i];
+        if (c == '\r' && i + 1 < len && text[i + 1] == '\n') continue;
+        *dest++ = (c == '\n' || c == '\r') ? ' ' : c;
+    }
+    *dest++ = '\n';
+    out->len = dest - out->data;
+}
+
+/// Splits data into lines and appends every non-blank one as a reminder.
+/// Windows line endings are accepted.
+void remind_format_lines(Output *out, const char *data, size_t len) {
+    const char *stop = data + len;
+    for (const char *p = data; p < stop; ) {
+        const char *nl = memchr(p, '\n', stop - p);
+        const char *line_end = nl ? nl : stop;
+        size_t line_len = line_end - p;
+        if (line_len > 0 && p[line_len - 1] == '\r') line_len--;
+
+        bool blank = true;
+        for (size_t i = 0; i < line_len && blank; i++) {
+            blank = p[i] == ' ' || p[i] == '\t';
+        }
+        if (!blank) {
+            remind_format(out, p, line_len);
+        }
+        p = line_end + 1;
+    }
+}
+
+/// Deletes every line in the set under an exclusive lock so concurrent adds
+/// are never truncated away, and keeps the stored reminder count in step.
+/// Returns the number of lines removed, or -1 on error.
+long remind_delete(const char *file_path, const LineSet *set) {
+    if (set->count == 0) {
+        return 0;
+    }
+    int lock_fd = remind_lock(file_path, LOCK_EX);
+    struct stat before, after;
+    bool have_before = remind_list_stat(file_path, &before) == 0;
+    struct stat plain;
+    bool have_plain = TRACED(stat(file_path, &plain)) == 0;
+    if (have_plain && remind_chunked_storage() && remind_chunks_import(file_path) == 0) {
+        have_plain = false;
+    }
+
+    /* Tombstones left by log storage change what the numbers mean, so they
+     * are honoured even once REMIND_STORAGE is unset; the delete then
+     * compacts them away and the list is plain again. Chunks likewise stay
+     * chunks until remind_compact() joins them for $EDITOR.
+     */
+    long removed;
+    bool spliced = false;
+    if (!have_plain && remind_chunks_stat(file_path, &after) == 0) {
+        removed = remind_chunks_delete(file_path, set);
+    } else if (remind_log_storage()) {
+        removed = delete_lines_logged(file_path, set, false);
+    } else if (remind_tombs_exist(file_path)) {
+        removed = delete_lines_logged(file_path, set, true);
+    } else {
+        removed = delete_lines_locked(file_path, set);
+        spliced = true;
+    }
+    if (have_before && removed > 0 && remind_list_stat(file_path, &after) == 0) {
+        adjust_count_cache(file_path, &before, &after, -removed);
+        if (spliced) {
+            remind_trigrams_delete(file_path, &before, &after, set);
+            remind_tags_delete(file_path, &before, &after, set);
+            remind_due_delete(file_path, &before, &after, set);
+        }
+    }
+    remind_unlock(lock_fd);
+    return removed;
+}
+
+/// Replaces the bytes of line start..end (its newline included) with
+/// replacement in a plain list. A replacement of the same length is one
+/// pwrite(); otherwise only the tail after the line is shifted, in place,
+/// and the file truncated or extended once. REMIND_SAFE_WRITES rewrites
+/// the list and renames it into place instead.
+static int replace_line_locked(const char *file_path, int fd, char *data, size_t size, size_t start, size_t end,
+                               const char *replacement, size_t len) {
+    if (remind_safe_writes()) {
+        struct iovec parts[] = {
+            { data, start },
+            { (void *) replacement, len },
+            { data + end, size - end },
+        };
+        return remind_replace_file(file_path, parts, 3, true);
+    }
+    if (len == end - start) {
+        if (TRACED(pwrite(fd, replacement, len, (off_t) start)) != (ssize_t) len) {
+            perror("pwrite");
+            return -1;
+        }
+        remind_trace.bytes_written += len;
+        return 0;
+    }
+
+    size_t new_size = size - (end - start) + len;
+    if (new_size > size && TRACED(ftruncate(fd, (off_t) new_size)) != 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    size_t mapped = new_size > size ? new_size : size;
+    char *map = TRACED(mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        if (new_size > size) TRACED(ftruncate(fd, (off_t) size));
+        return -1;
+    }
+    memmove(map + start + len, map + end, size - end);
+    memcpy(map + start, replacement, len);
+    TRACED(munmap(map, mapped));
+    if (new_size < size && TRACED(ftruncate(fd, (off_t) new_size)) != 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    return 0;
+}
+
+/// Replaces the text of reminder `number` with text (formatted as for -a),
+/// under the same exclusive lock as deletes and without reading more of the
+/// list than it takes to find the line. A chunked list has only the chunk
+/// holding the line rewritten; with tombstones, the records of the dead
+/// lines after it move with their bytes.
+int remind_edit(const char *file_path, long number, const char *text, size_t len) {
+    Output out = { .fd = -1 };
+    remind_format(&out, text, len);
+    if (out.len == 0) return -1;
+
+    int lock_fd = remind_lock(file_path, LOCK_EX);
+    struct stat before, after;
+    bool have_plain = TRACED(stat(file_path, &before)) == 0;
+    if (have_plain && remind_chunked_storage() && remind_chunks_import(file_path) == 0) {
+        have_plain = false;
+    }
+    if (!have_plain && remind_chunks_stat(file_path, &before) == 0) {
+        int rc = remind_chunks_edit(file_path, number, out.data, out.len);
+        if (rc == 1) fprintf(stderr, "No reminder at line %ld\n", number);
+        if (rc == 0 && remind_chunks_stat(file_path, &after) == 0) {
+            adjust_count_cache(file_path, &before, &after, 0);
+        }
+        output_free(&out);
+        remind_unlock(lock_fd);
+        return rc == 0 ? 0 : -1;
+    }
+
+    int fd = TRACED(open(file_path, O_RDWR | O_CLOEXEC));
+    if (fd < 0 || TRACED(fstat(fd, &before)) != 0) {
+        if (fd >= 0 || errno != ENOENT) perror("open");
+        else fprintf(stderr, "No reminder at line %ld\n", number);
+        if (fd >= 0) TRACED(close(fd));
+        output_free(&out);
+        remind_unlock(lock_fd);
+        return -1;
+    }
+    size_t size = (size_t) before.st_size;
+    char *data = size == 0 ? MAP_FAILED : TRACED(mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0));
+    if (data == MAP_FAILED) {
+        if (size > 0) perror("mmap");
+        else fprintf(stderr, "No reminder at line %ld\n", number);
+        TRACED(close(fd));
+        output_free(&out);
+        remind_unlock(lock_fd);
+        return -1;
+    }
+
+    // The index gets us to within a few lines of the one to replace;
+    // tombstoned lines are skipped, as when numbering for -c
+    RemindList view = { .data = data, .size = size, .st = before, .lock_fd = -1 };
+    int rc = remind_tombs_load(&view, file_path);
+    RemindLine line;
+    if (rc == 0) {
+        remind_seek_line(&view, file_path, number, &line);
+        while (line.number < number && remind_next_line(&view, &line)) {
+        }
+        rc = -1;
+        if (line.number != number) fprintf(stderr, "No reminder at line %ld\n", number);
+        else rc = 0;
+    }
+
+    if (rc == 0) {
+        // An unterminated last line stays unterminated
+        size_t start = (size_t) (line.text - data);
+        size_t end = start + line.len + (start + line.len < size ? 1 : 0);
+        size_t replacement_len = out.len - (end == start + line.len ? 1 : 0);
+        int64_t delta = (int64_t) replacement_len - (int64_t) (end - start);
+        // The records of dead lines after this one move before the bytes
+        // do, and move back if the write fails, so they never point at
+        // bytes that are no longer there
+        bool shifted = view.dead_count > 0 && delta != 0;
+        if (shifted && remind_tombs_shift(file_path, &before, &before, end, delta) != 0) {
+            rc = -1;
+        } else {
+            rc = replace_line_locked(file_path, fd, data, size, start, end, out.data, replacement_len);
+            if (rc != 0 && shifted) remind_tombs_shift(file_path, &before, &before, end + delta, -delta);
+        }
+        bool rewritten = remind_safe_writes();
+        if (rc == 0 && (rewritten ? TRACED(stat(file_path, &after)) : TRACED(fstat(fd, &after))) == 0) {
+            // A rewrite gave the list a new inode. The edit stands either
+            // way; tombstones that cannot follow it are dropped, not left
+            // behind for another file.
+            if (rewritten && view.dead_count > 0 && remind_tombs_shift(file_path, &before, &after, 0, 0) != 0) {
+                fprintf(stderr, "remind: reminder %ld was edited, but its tombstones were lost\n", number);
+                char tomb_path[PATH_MAX];
+                if (remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) TRACED(unlink(tomb_path));
+            }
+            if (!rewritten) {
+                adjust_count_cache(file_path, &before, &after, 0);
+                remind_index_shift(file_path, &before, &after, start, delta);
+            }
+        }
+    }
+    free(view.dead);
+    output_free(&out);
+    TRACED(munmap(data, size));
+    TRACED(close(fd));
+    remind_unlock(lock_fd);
+    return rc;
+}
+
+/// Leaves a plain one-reminder-per-line file: tombstoned lines are dropped
+/// for good and a chunked list is joined back into one file. Run before
+/// handing the list to $EDITOR, which knows nothing of either.
+int remind_compact(const char *file_path) {
+    struct stat before, after;
+    bool have_plain = TRACED(stat(file_path, &before)) == 0;
+    bool chunked = !have_plain && remind_chunks_stat(file_path, &before) == 0;
+    if (!chunked && !remind_tombs_exist(file_path)) {
+        return 0;
+    }
+    int lock_fd = remind_lock(file_path, LOCK_EX);
+    bool have_before = remind_list_stat(file_path, &before) == 0;
+    int rc;
+    if (chunked) {
+        rc = remind_chunks_export(file_path);
+    } else {
+        RemindList list = { .lock_fd = -1 };
+        rc = remind_list_open_locked(&list, file_path);
+        if (rc == 0) {
+            rc = remind_compact_locked(file_path, &list);
+            remind_list_close(&list);
+        }
+    }
+    if (rc == 0 && have_before && remind_list_stat(file_path, &after) == 0) {
+        adjust_count_cache(file_path, &before, &after, 0);
+    }
+    remind_unlock(lock_fd);
+    return rc;
+}
+
+/// Appends to a chunked list under the exclusive lock, first moving a plain
+/// list into chunks if REMIND_STORAGE has just asked for them
+static int append_chunked(const char *file_path, const char *data, size_t len) {
+    struct stat before, after;
+    bool have_before = remind_list_stat(file_path, &before) == 0;
+    if (TRACED(stat(file_path, &after)) == 0 && remind_chunks_import(file_path) != 0) {
+        return -1;
+    }
+    int rc = remind_chunks_append(file_path, data, len);
+    if (rc == 0 && have_before && remind_list_stat(file_path, &after) == 0) {
+        adjust_count_cache(file_path, &before, &after, (int64_t) remind_count_lines(data, len));
+    }
+    return rc;
+}
+
+/// Appends already formatted reminders (see remind_format()) with a single
+/// O_APPEND write, so a bulk import costs one open and one write no matter
+/// how many reminders it contains. Appends only take the lock shared: the
+/// kernel keeps each write contiguous even with other adders.
+int remind_append(const char *file_path, const char *data, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    /* A missing list is only created as a plain file when it is not kept in
+     * chunks, which the failed open tells us for free in the common case.
+     */
+    bool chunked = remind_chunked_storage();
+    int fd = -1;
+    int lock_fd = remind_lock(file_path, chunked ? LOCK_EX : LOCK_SH);
+    if (!chunked) {
+        fd = TRACED(open(file_path, O_RDWR | O_APPEND | O_CLOEXEC));
+        struct stat manifest_st;
+        if (fd < 0 && errno == ENOENT) {
+            if (remind_chunks_stat(file_path, &manifest_st) == 0) {
+                chunked = true;
+                remind_unlock(lock_fd);
+                lock_fd = remind_lock(file_path, LOCK_EX);
+            } else {
+                fd = TRACED(open(file_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0644));
+            }
+        }
+    }
+    if (chunked) {
+        int rc = append_chunked(file_path, data, len);
+        remind_unlock(lock_fd);
+        return rc;
+    }
+    if (fd < 0) {
+        perror("open append");
+        remind_unlock(lock_fd);
+        return -1;
+    }
+
+    /* A list edited by hand may not end in a newline; without one the first
+     * new reminder would be glued onto the last existing line.
+     */
+    struct stat before, after;
+    bool have_before = TRACED(fstat(fd, &before)) == 0;
+    char last = '\n';
+    if (have_before && before.st_size > 0) {
+        if (TRACED(pread(fd, &last, 1, before.st_size - 1)) != 1) last = '\n';
+    }
+    struct iovec parts[] = {
+        { "\n", last != '\n' },
+        { (void *) data, len },
+    };
+    size_t total = parts[0].iov_len + len;
+
+    int rc = 0;
+    if (writev_all(fd, parts, 2) != 0) {
+        perror("write");
+        rc = -1;
+    } else if (have_before && TRACED(fstat(fd, &after)) == 0 &&
+               after.st_size == before.st_size + (off_t) total) {
+        // Nobody else appended in between, so the stored count and index can follow
+        adjust_count_cache(file_path, &before, &after, (int64_t) remind_count_lines(data, len));
+        remind_index_append(file_path, &before, &after, last != '\n', data, len);
+        remind_trigrams_append(file_path, &before, &after, data, len);
+        remind_tags_append(file_path, &before, &after, data, len);
+        remind_due_append(file_path, &before, &after, data, len);
+    }
+    TRACED(close(fd));
+    remind_unlock(lock_fd);
+    return rc;
+}
+
+/// Adds a single reminder
+int remind_add(const char *file_path, const char *text) {
+    Output out = { .fd = -1 };
+    remind_format(&out, text, strlen(text));
+    int rc = remind_append(file_path, out.data, out.len);
+    output_free(&out);
+    return rc;
+}
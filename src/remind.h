@@ -0,0 +1,377 @@
+#ifndef REMIND_H
+#define REMIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <regex.h>
+
+/*
+ * libremind: storage, parsing and rendering for the remind reminder list.
+ *
+ * The list is a plain text file with one reminder per line. Every
+ * newline-separated line is numbered from 1, blank lines included, and
+ * those numbers are what every function here takes and reports. Functions
+ * that can fail print the reason with perror() and return -1 (or false),
+ * like the CLI always has.
+ */
+
+#define NUMBER_SPACING 2
+#define OUTPUT_FLUSH_SIZE (1024 * 1024)
+
+/// Output is assembled in memory and handed to the terminal with as few
+/// write() calls as possible. Lists smaller than OUTPUT_FLUSH_SIZE go out
+/// in a single write; larger ones are flushed in chunks of that size so
+/// memory stays bounded no matter how long the list is. Buffers with
+/// fd < 0 only collect bytes for their owner and never flush.
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int fd;
+} Output;
+
+int write_all(int fd, const char *buf, size_t len);
+int output_flush(Output *out);
+bool output_reserve(Output *out, size_t extra);
+void output_append(Output *out, const char *s, size_t n);
+void output_str(Output *out, const char *s);
+void output_repeat(Output *out, char c, int times);
+void output_line_number(Output *out, long n);
+void output_free(Output *out);
+
+/// An inclusive range of 1-based line numbers
+typedef struct {
+    long first;
+    long last;
+} LineRange;
+
+/// A set of line numbers kept as sorted, non-overlapping ranges
+typedef struct {
+    LineRange *ranges;
+    int count;
+    int cap;
+} LineSet;
+
+bool line_set_parse(LineSet *set, const char *spec);
+void line_set_free(LineSet *set);
+
+/// Identifies one version of a file. Size, mtime (to the nanosecond where
+/// the platform has it) and inode change whenever the list is appended to,
+/// spliced, or replaced by an editor or a rename()-based write.
+typedef struct {
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t ino;
+    uint64_t dev;
+} FileStamp;
+
+FileStamp file_stamp(const struct stat *st);
+bool file_stamp_equal(const FileStamp *a, const FileStamp *b);
+bool file_stamp_settled(const struct stat *st);
+
+/// A list mapped read-only under a shared lock, so no delete can truncate
+/// it while it is being read. data is NULL when the file is empty, and a
+/// chunked list is read into a heap buffer (copied) instead. Lines
+/// deleted by tombstone (see below) are listed in dead by their starting
+/// offset, in ascending order, and are skipped by everything that numbers
+/// lines.
+typedef struct {
+    const char *data;
+    size_t size;
+    struct stat st;
+    int lock_fd;
+    uint64_t *dead;
+    size_t dead_count;
+    uint64_t dead_bytes;
+    bool copied;
+} RemindList;
+
+/// One line of a RemindList, pointing into the mapping (not NUL-terminated)
+typedef struct {
+    const char *text;
+    size_t len;
+    long number;
+    size_t next_dead;   // private: position in list->dead
+} RemindLine;
+
+/// One deleted line in reminders.tomb. The offset is stable for as long as
+/// the file keeps its inode, since appends never move existing bytes and an
+/// edit that does moves the records with them; the length and hash make
+/// sure the line there is still the one deleted.
+typedef struct {
+    uint64_t offset;
+    uint32_t len;
+    uint32_t hash;
+} TombRecord;
+
+/// Phases timed by REMIND_TRACE
+typedef enum {
+    TRACE_ARGS,
+    TRACE_DIR,
+    TRACE_OPEN,
+    TRACE_READ,
+    TRACE_RENDER,
+    TRACE_WRITE,
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t phase_start_ns[TRACE_PHASE_COUNT];
+    uint64_t phase_ns[TRACE_PHASE_COUNT];
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t allocations;
+    uint64_t syscalls;
+} RemindTrace;
+
+extern bool remind_trace_on;
+extern RemindTrace remind_trace;
+
+void remind_trace_init(void);
+void remind_trace_begin(TracePhase phase);
+void remind_trace_end(TracePhase phase);
+void remind_trace_report(void);
+
+/// Phase timing is a single branch when tracing is off
+#define TRACE_BEGIN(phase) do { if (remind_trace_on) remind_trace_begin(phase); } while (0)
+#define TRACE_END(phase) do { if (remind_trace_on) remind_trace_end(phase); } while (0)
+/// Wraps a system call so it is counted
+#define TRACED(call) (remind_trace.syscalls++, (call))
+
+/// Paths
+bool remind_default_path(char *out, size_t out_size);
+bool remind_sidecar_path(char *out, size_t out_size, const char *file_path, const char *suffix);
+void remind_ensure_dir(const char *file_path);
+
+/// Locking and file replacement
+int remind_lock(const char *file_path, int operation);
+void remind_unlock(int lock_fd);
+int remind_replace_file(const char *file_path, const struct iovec *parts, int count, bool sync);
+bool remind_safe_writes(void);
+
+/// Reading. Iterate with `RemindLine line = {0}; while (remind_next_line(&list, &line))`.
+int remind_list_open(RemindList *list, const char *file_path);
+int remind_list_open_locked(RemindList *list, const char *file_path);
+int remind_list_stat(const char *file_path, struct stat *st);
+size_t remind_dead_before(const RemindList *list, uint64_t offset);
+void remind_list_close(RemindList *list);
+bool remind_next_line(const RemindList *list, RemindLine *line);
+bool remind_find_line(const char *data, size_t size, long target_line, size_t *start, size_t *end);
+uint64_t remind_count_lines(const char *data, size_t size);
+
+/// Log-structured deletes (REMIND_STORAGE=log). A delete appends tombstones
+/// instead of moving bytes, and the list is compacted once more than
+/// 1/COMPACT_DEAD_DIVISOR of it is dead.
+#define COMPACT_DEAD_DIVISOR 4
+
+bool remind_log_storage(void);
+uint32_t remind_line_hash(const char *text, size_t len);
+bool remind_tombs_exist(const char *file_path);
+int remind_tombs_load(RemindList *list, const char *file_path);
+int remind_tombs_append(const char *file_path, const struct stat *list_st, const TombRecord *records, size_t count);
+int remind_tombs_shift(const char *file_path, const struct stat *before, const struct stat *after,
+                       uint64_t from, int64_t delta);
+int remind_compact_locked(const char *file_path, const RemindList *list);
+int remind_compact(const char *file_path);
+
+/// Chunked storage (REMIND_STORAGE=chunked). The list lives in
+/// reminders.chunks/ as files of about CHUNK_TARGET_SIZE bytes, and a
+/// mutation rewrites only the chunks holding the lines it touches.
+#define CHUNK_TARGET_SIZE (64 * 1024)
+
+bool remind_chunked_storage(void);
+int remind_chunks_stat(const char *file_path, struct stat *st);
+int remind_chunks_read(RemindList *list, const char *file_path);
+int remind_chunks_render(Output *out, const char *file_path, int64_t now, int64_t *valid_until, struct stat *st);
+int remind_chunks_replace(const char *file_path, const char *data, size_t len);
+int remind_chunks_import(const char *file_path);
+int remind_chunks_export(const char *file_path);
+int remind_chunks_append(const char *file_path, const char *data, size_t len);
+long remind_chunks_delete(const char *file_path, const LineSet *set);
+int remind_chunks_edit(const char *file_path, long number, const char *replacement, size_t len);
+
+/// Line-offset index (reminders.index): the offset of every
+/// INDEX_STRIDE-th line, so line N is found without scanning from byte 0
+#define INDEX_STRIDE 64
+
+/// A mapped index: offsets[i] is where physical line i * INDEX_STRIDE + 1 starts
+typedef struct {
+    const uint64_t *offsets;
+    size_t count;
+    void *mapping;
+    size_t mapping_size;
+} LineIndexMap;
+
+/// Where a caller visiting many physical lines in order is: physical line
+/// `line` starts at `offset`. Start at `{ .line = 1 }`, optionally with
+/// remind_index_map() filling index.
+typedef struct {
+    long line;
+    size_t offset;
+    LineIndexMap index;
+} LineCursor;
+
+bool remind_index_nearest(const RemindList *list, const char *file_path, long target, uint64_t *offset, long *line);
+bool remind_index_map(const RemindList *list, const char *file_path, LineIndexMap *map);
+void remind_index_unmap(LineIndexMap *map);
+bool remind_cursor_seek(const RemindList *list, LineCursor *cursor, long target);
+void remind_seek_line(const RemindList *list, const char *file_path, long target, RemindLine *line);
+void remind_index_append(const char *file_path, const struct stat *before, const struct stat *after,
+                         bool fixed_newline, const char *data, size_t len);
+void remind_index_restamp(const char *file_path, const struct stat *before, const struct stat *after);
+void remind_index_shift(const char *file_path, const struct stat *before, const struct stat *after,
+                        uint64_t from, int64_t delta);
+
+/// Part of the list to show. Numbers and the header width come from the
+/// lines in the window only, and are the numbers the full list would show.
+typedef enum {
+    WINDOW_ALL,
+    WINDOW_HEAD,     // the first `count` lines
+    WINDOW_TAIL,     // the last `count` lines
+    WINDOW_RANGE,    // lines first to last
+    WINDOW_FULL      // every line, including those not due yet
+} WindowKind;
+
+typedef struct {
+    WindowKind kind;
+    long count;
+    long first;
+    long last;
+} LineWindow;
+
+/// A search pattern (remind -s). Patterns without regex metacharacters are
+/// matched as literals by a vectorised scan of the raw list; the rest are
+/// POSIX extended regexes.
+typedef struct {
+    const char *text;
+    size_t len;
+    bool icase;
+    bool is_regex;
+    regex_t regex;
+} RemindPattern;
+
+int remind_pattern_compile(RemindPattern *pattern, const char *text, bool icase);
+void remind_pattern_free(RemindPattern *pattern);
+bool remind_line_matches(const RemindPattern *pattern, const char *text, size_t len);
+bool remind_next_match(const RemindList *list, const RemindPattern *pattern, RemindLine *line);
+
+/// Trigram index (reminders.trigrams, built when REMIND_TRIGRAMS is set):
+/// the lines holding each three-byte sequence, so -s only has to look at
+/// lines that can match. Kept in segments of TRIGRAM_SEGMENT_LINES lines.
+#define TRIGRAM_SEGMENT_LINES 16384
+
+bool remind_trigrams_wanted(void);
+long remind_trigrams_search(const RemindList *list, const char *file_path, const RemindPattern *pattern,
+                            RemindLine **matches);
+void remind_trigrams_append(const char *file_path, const struct stat *before, const struct stat *after,
+                            const char *data, size_t len);
+void remind_trigrams_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                            const LineSet *set);
+void remind_trigrams_restamp(const char *file_path, const struct stat *before, const struct stat *after);
+
+/// Tags: "+name" words in a reminder. reminders.tags lists the lines
+/// carrying each tag, so -t reads only those lines.
+bool remind_tag_valid(const char *name);
+bool remind_line_has_tag(const char *text, size_t len, const char *name);
+long remind_tags_search(const RemindList *list, const char *file_path, const char *name, RemindLine **matches);
+void remind_tags_append(const char *file_path, const struct stat *before, const struct stat *after,
+                        const char *data, size_t len);
+void remind_tags_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                        const LineSet *set);
+void remind_tags_restamp(const char *file_path, const struct stat *before, const struct stat *after);
+
+/// Scheduling: due:, every: and snooze: words in a reminder. -c leaves out
+/// reminders that are not due; reminders.due is a min-heap of when each
+/// scheduled line next appears or disappears.
+#define REMIND_NEVER INT64_MAX
+
+typedef enum {
+    REPEAT_NONE,
+    REPEAT_DAYS,        // every `step` days
+    REPEAT_MONTHS,      // every `step` months, on due:'s day (or the month's last)
+    REPEAT_WEEKDAYS     // on the days in `weekdays`, bit 0 = Sunday
+} RepeatKind;
+
+typedef struct {
+    int64_t due;        // 0 = none
+    int64_t snooze;     // 0 = none
+    RepeatKind repeat;
+    int step;
+    uint8_t weekdays;
+} Schedule;
+
+bool remind_schedule_parse(const char *text, size_t len, Schedule *schedule);
+bool remind_schedule_shown(const Schedule *schedule, int64_t now, int64_t *change);
+int remind_due_hidden(const RemindList *list, const char *file_path, int64_t now,
+                      uint32_t **hidden, size_t *hidden_count, int64_t *valid_until);
+bool remind_due_peek(const char *file_path, const FileStamp *stamp, int64_t now, size_t *hidden_count);
+void remind_due_append(const char *file_path, const struct stat *before, const struct stat *after,
+                       const char *data, size_t len);
+void remind_due_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                       const LineSet *set);
+void remind_due_restamp(const char *file_path, const struct stat *before, const struct stat *after);
+
+/// remind --daemon: announces reminders as they come due
+int remind_daemon(const char *file_path, const char *notify);
+
+/// An inotify watch on the list's directory, and on the chunk directory
+/// inside it while the list is chunked, since chunk writes happen there
+typedef struct {
+    int fd;
+    int chunks_wd;          // -1 while there is no chunk directory
+    const char *file_path;
+    const char *base;       // the list's file name within its directory
+} ListWatch;
+
+int remind_watch_list(ListWatch *watch, const char *file_path);
+bool remind_watch_changed(ListWatch *watch);
+
+/// remind --batch: many commands against one load and one save of the list
+int remind_batch(const char *file_path, const char *script, size_t len, int out_fd);
+
+/// remind -w: keeps the list on the terminal, redrawing changed rows
+int remind_watch(const char *file_path, int fd, const LineWindow *window);
+
+/// remind --serve: keeps the rendered list in memory and answers requests
+/// on the reminders.sock Unix socket. remind_serve_call() returns -1 when
+/// no server is listening, so the caller does the work itself. Adds and
+/// deletes, and any request that fails, reply with the server's messages.
+typedef enum {
+    SERVE_CHECK = 1,    // reply: what -c prints
+    SERVE_COUNT,        // reply: uint64_t count
+    SERVE_ADD,          // payload: reminders formatted by remind_format()
+    SERVE_DELETE        // payload: the LineSet's ranges
+} ServeOp;
+
+int remind_serve(const char *file_path);
+int remind_serve_call(const char *file_path, ServeOp op, const void *payload, size_t len, Output *reply);
+
+/// Rendering and the commands built on it
+bool remind_render_header(Output *out, int width);
+void remind_render(Output *out, const char *data, size_t size);
+void remind_render_list(Output *out, const RemindList *list);
+void remind_render_shown(Output *out, const RemindList *list, const uint32_t *hidden, size_t hidden_count);
+void remind_render_due(Output *out, const RemindList *list, const char *file_path, int64_t now,
+                       int64_t *valid_until);
+void remind_render_window(Output *out, const RemindList *list, const char *file_path, const LineWindow *window);
+int remind_check(const char *file_path, int fd);
+int remind_check_window(const char *file_path, int fd, const LineWindow *window);
+long remind_search(const char *file_path, int fd, const char *text, bool icase);
+long remind_check_tag(const char *file_path, int fd, const char *tag);
+uint64_t remind_count(const char *file_path);
+uint64_t remind_count_shown(const RemindList *list, const char *file_path, uint64_t live, int64_t now);
+
+/// Mutations
+void remind_format(Output *out, const char *text, size_t len);
+void remind_format_lines(Output *out, const char *data, size_t len);
+int remind_append(const char *file_path, const char *data, size_t len);
+int remind_add(const char *file_path, const char *text);
+long remind_delete(const char *file_path, const LineSet *set);
+int remind_edit(const char *file_path, long number, const char *text, size_t len);
+
+#endif
@@ -0,0 +1,570 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "remind.h"
+
+/*
+ * Due dates, recurrence and snoozing. Like tags they are words in the
+ * reminder itself, so the text stays the only copy:
+ *
+ *     due:2026-10-20 or due:2026-10-20T09:30   hidden from -c until then
+ *       (seconds may follow: T09:30:15)
+ *     every:day, week, month, year, 3d, 2w, 6m, 1y, mon,thu, weekdays,
+ *     weekends                                 shown on each day it recurs,
+ *                                              from due:'s time to midnight
+ *     snooze:2026-10-20[T09:30]                hidden until then
+ *
+ * Times are local. Words that do not parse are ordinary text.
+ *
+ * Whether a reminder is shown only changes at a few known instants, so
+ * reminders.due keeps a min-heap of (next change, line, shown now) for the
+ * scheduled lines. -c pops the entries whose change time has passed,
+ * evaluates just those rules again and pushes them back, and the rendered
+ * list it caches is good until the new top of the heap. The heap is
+ * tagged with the list's FileStamp and maintained across adds and deletes
+ * like reminders.tags.
+ */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    uint64_t lines;         // physical lines indexed
+    uint32_t count;         // entries in the heap
+    uint32_t reserved;
+} DueHeader;
+
+typedef struct {
+    int64_t change;         // when shown next flips, REMIND_NEVER if it never does
+    uint32_t line;          // physical line number, 1-based
+    uint32_t shown;
+} DueEntry;
+
+#define DUE_MAGIC "RMDDUEHP"
+#define DUE_VERSION 1
+
+static const char *const WEEKDAY_NAMES[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+/// Days since 1970-01-01 of a proleptic Gregorian date (Howard Hinnant's
+/// days_from_civil), so calendar arithmetic needs no time zone
+static int64_t days_from_civil(int64_t y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int64_t *y, int *m, int *d) {
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *d = (int) (doy - (153 * mp + 2) / 5 + 1);
+    *m = (int) (mp < 10 ? mp + 3 : mp - 9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+static int days_in_month(int64_t y, int m) {
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return m == 2 && leap ? 29 : days[m - 1];
+}
+
+/// 0 for Sunday
+static int weekday(int64_t day) {
+    return (int) (((day % 7) + 7 + 4) % 7);
+}
+
+/// The local day t falls on, and the second of that day
+static int64_t local_day(int64_t t, int *second) {
+    time_t tt = (time_t) t;
+    struct tm tm;
+    localtime_r(&tt, &tm);
+    if (second) *second = (tm.tm_hour * 60 + tm.tm_min) * 60 + tm.tm_sec;
+    return days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+}
+
+/// The instant second of local day starts, whatever daylight saving says
+static int64_t local_time(int64_t day, int second) {
+    int64_t y;
+    int m, d;
+    civil_from_days(day, &y, &m, &d);
+    struct tm tm = {
+        .tm_year = (int) (y - 1900), .tm_mon = m - 1, .tm_mday = d,
+        .tm_hour = second / 3600, .tm_min = second / 60 % 60, .tm_sec = second % 60, .tm_isdst = -1,
+    };
+    return (int64_t) mktime(&tm);
+}
+
+/// Reads n digits as a number
+static bool parse_digits(const char *s, int n, int *value) {
+    *value = 0;
+    for (int i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        *value = *value * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+/// YYYY-MM-DD, YYYY-MM-DDTHH:MM or YYYY-MM-DDTHH:MM:SS, local time
+static bool parse_when(const char *s, size_t len, int64_t *when) {
+    int y, m, d, hour = 0, minute = 0, second = 0;
+    if ((len != 10 && len != 16 && len != 19) || !parse_digits(s, 4, &y) || s[4] != '-' || !parse_digits(s + 5, 2, &m) ||
+        s[7] != '-' || !parse_digits(s + 8, 2, &d) || m < 1 || m > 12 || d < 1 || d > days_in_month(y, m)) {
+        return false;
+    }
+    if (len >= 16 && (s[10] != 'T' || !parse_digits(s + 11, 2, &hour) || s[13] != ':' ||
+                      !parse_digits(s + 14, 2, &minute) || hour > 23 || minute > 59)) {
+        return false;
+    }
+    if (len == 19 && (s[16] != ':' || !parse_digits(s + 17, 2, &second) || second > 59)) {
+        return false;
+    }
+    *when = local_time(days_from_civil(y, m, d), (hour * 60 + minute) * 60 + second);
+    return true;
+}
+
+/// day, week, month, year, N followed by d/w/m/y, weekday names joined by
+/// commas, weekdays or weekends
+static bool parse_every(const char *s, size_t len, Schedule *schedule) {
+    static const struct { const char *name; RepeatKind repeat; int step; uint8_t weekdays; } words[] = {
+        { "day", REPEAT_DAYS, 1, 0 },
+        { "week", REPEAT_DAYS, 7, 0 },
+        { "month", REPEAT_MONTHS, 1, 0 },
+        { "year", REPEAT_MONTHS, 12, 0 },
+        { "weekdays", REPEAT_WEEKDAYS, 0, 0x3e },
+        { "weekends", REPEAT_WEEKDAYS, 0, 0x41 },
+    };
+    for (size_t i = 0; i < sizeof(words) / sizeof(words[0]); i++) {
+        if (strlen(words[i].name) == len && memcmp(s, words[i].name, len) == 0) {
+            schedule->repeat = words[i].repeat;
+            schedule->step = words[i].step;
+            schedule->weekdays = words[i].weekdays;
+            return true;
+        }
+    }
+
+    if (len >= 2 && s[0] >= '1' && s[0] <= '9') {
+        int step = 0;
+        size_t i = 0;
+        for (; i < len - 1 && s[i] >= '0' && s[i] <= '9' && step < 10000; i++) step = step * 10 + (s[i] - '0');
+        if (i != len - 1) return false;
+        switch (s[i]) {
+            case 'd': schedule->repeat = REPEAT_DAYS; schedule->step = step; return true;
+            case 'w': schedule->repeat = REPEAT_DAYS; schedule->step = step * 7; return true;
+            case 'm': schedule->repeat = REPEAT_MONTHS; schedule->step = step; return true;
+            case 'y': schedule->repeat = REPEAT_MONTHS; schedule->step = step * 12; return true;
+        }
+        return false;
+    }
+
+    uint8_t weekdays = 0;
+    for (size_t at = 0; at < len; at += 4) {
+        int found = -1;
+        for (int w = 0; w < 7 && found < 0; w++) {
+            if (len - at >= 3 && memcmp(s + at, WEEKDAY_NAMES[w], 3) == 0) found = w;
+        }
+        if (found < 0 || (at + 3 < len && s[at + 3] != ',')) return false;
+        weekdays |= (uint8_t) (1u << found);
+    }
+    schedule->repeat = REPEAT_WEEKDAYS;
+    schedule->weekdays = weekdays;
+    return weekdays != 0;
+}
+
+/// Reads the due:, every: and snooze: words of a line. False when it has
+/// none that parse, and so is always shown.
+bool remind_schedule_parse(const char *text, size_t len, Schedule *schedule) {
+    memset(schedule, 0, sizeof(*schedule));
+    bool any = false;
+    for (size_t i = 0; i < len; ) {
+        while (i < len && (text[i] == ' ' || text[i] == '\t')) i++;
+        size_t start = i;
+        while (i < len && text[i] != ' ' && text[i] != '\t') i++;
+        const char *word = text + start;
+        size_t word_len = i - start;
+        if (word_len > 4 && memcmp(word, "due:", 4) == 0) {
+            any = parse_when(word + 4, word_len - 4, &schedule->due) || any;
+        } else if (word_len > 7 && memcmp(word, "snooze:", 7) == 0) {
+            any = parse_when(word + 7, word_len - 7, &schedule->snooze) || any;
+        } else if (word_len > 6 && memcmp(word, "every:", 6) == 0) {
+            Schedule repeat = *schedule;
+            if (parse_every(word + 6, word_len - 6, &repeat)) {
+                *schedule = repeat;
+                any = true;
+            }
+        }
+    }
+    return any;
+}
+
+/// The first day on or after day that the rule falls on, counting from anchor
+static int64_t first_occurrence(const Schedule *schedule, int64_t anchor, int64_t day) {
+    if (day < anchor) day = anchor;
+    switch (schedule->repeat) {
+        case REPEAT_DAYS:
+            return anchor + (day - anchor + schedule->step - 1) / schedule->step * schedule->step;
+        case REPEAT_WEEKDAYS:
+            while (!(schedule->weekdays & (1u << weekday(day)))) day++;
+            return day;
+        case REPEAT_MONTHS: {
+            int64_t ay, y;
+            int am, ad, m, d;
+            civil_from_days(anchor, &ay, &am, &ad);
+            civil_from_days(day, &y, &m, &d);
+            int64_t months = (y - ay) * 12 + (m - am);
+            months = (months + schedule->step - 1) / schedule->step * schedule->step;
+            for (;; months += schedule->step) {
+                int64_t month_index = (am - 1) + months;
+                int64_t oy = ay + month_index / 12;
+                int om = (int) (month_index % 12) + 1;
+                int od = ad < days_in_month(oy, om) ? ad : days_in_month(oy, om);
+                int64_t occurrence = days_from_civil(oy, om, od);
+                if (occurrence >= day) return occurrence;
+            }
+        }
+        case REPEAT_NONE:
+            break;
+    }
+    return day;
+}
+
+/// Whether a scheduled reminder is shown at now, and when that next
+/// changes (REMIND_NEVER once it never will)
+bool remind_schedule_shown(const Schedule *schedule, int64_t now, int64_t *change) {
+    if (schedule->snooze > now) {
+        *change = schedule->snooze;
+        return false;
+    }
+    if (schedule->repeat == REPEAT_NONE) {
+        if (schedule->due > now) {
+            *change = schedule->due;
+            return false;
+        }
+        *change = REMIND_NEVER;
+        return true;
+    }
+
+    // Recurring: shown from each occurrence until the end of its day
+    int second = 0;
+    int64_t today = local_day(now, NULL);
+    int64_t anchor = schedule->due ? local_day(schedule->due, &second)
+                                   : schedule->repeat == REPEAT_WEEKDAYS ? today : 0;
+    int64_t day = first_occurrence(schedule, anchor, today);
+    int64_t start = local_time(day, second);
+    if (day == today && now >= start) {
+        *change = local_time(today + 1, 0);
+        return true;
+    }
+    *change = start;
+    return false;
+}
+
+static bool due_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".due");
+}
+
+static bool header_valid(const DueHeader *header) {
+    return memcmp(header->magic, DUE_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == DUE_VERSION &&
+           header->header_size == sizeof(*header);
+}
+
+/// The heap entry for a line, if it has a schedule
+static bool evaluate_line(const char *text, size_t len, uint32_t line, int64_t now, DueEntry *entry) {
+    Schedule schedule;
+    if (!remind_schedule_parse(text, len, &schedule)) return false;
+    entry->line = line;
+    entry->shown = remind_schedule_shown(&schedule, now, &entry->change);
+    return true;
+}
+
+/// Entries for the scheduled lines of data, numbered from first_line
+static uint32_t add_block_entries(Output *entries, const char *data, size_t len, uint32_t first_line, int64_t now) {
+    uint32_t line = first_line;
+    const char *end = data + len;
+    for (const char *p = data; p < end; line++) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        DueEntry entry;
+        if (evaluate_line(p, line_end - p, line, now, &entry)) {
+            output_append(entries, (const char *) &entry, sizeof(entry));
+        }
+        p = line_end + 1;
+    }
+    return line - first_line;
+}
+
+static void sift_down(DueEntry *heap, size_t count, size_t i) {
+    for (;;) {
+        size_t smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < count && heap[left].change < heap[smallest].change) smallest = left;
+        if (right < count && heap[right].change < heap[smallest].change) smallest = right;
+        if (smallest == i) return;
+        DueEntry swap = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = swap;
+        i = smallest;
+    }
+}
+
+static void heapify(DueEntry *heap, size_t count) {
+    for (size_t i = count / 2; i-- > 0; ) sift_down(heap, count, i);
+}
+
+static int save_heap(const char *file_path, DueHeader *header, const DueEntry *heap) {
+    char path[PATH_MAX];
+    if (!due_path(path, sizeof(path), file_path)) return -1;
+    struct iovec parts[] = {
+        { header, sizeof(*header) },
+        { (void *) heap, header->count * sizeof(*heap) },
+    };
+    return remind_replace_file(path, parts, 2, false);
+}
+
+/// Reads a heap that matches stamp into a malloc'd array
+static DueEntry *load_heap(int fd, const FileStamp *stamp, DueHeader *header) {
+    if (TRACED(pread(fd, header, sizeof(*header), 0)) != (ssize_t) sizeof(*header) ||
+        !header_valid(header) || !file_stamp_equal(&header->source, stamp)) {
+        return NULL;
+    }
+    size_t bytes = header->count * sizeof(DueEntry);
+    remind_trace.allocations++;
+    DueEntry *heap = malloc(bytes ? bytes : 1);
+    if (heap && bytes > 0 && TRACED(pread(fd, heap, bytes, sizeof(*header))) != (ssize_t) bytes) {
+        free(heap);
+        return NULL;
+    }
+    remind_trace.bytes_read += sizeof(*header) + bytes;
+    return heap;
+}
+
+/// Indexes every physical line of a list, saving the heap unless the list
+/// changed too recently to be told apart from its next version (see
+/// file_stamp_settled())
+static DueEntry *heap_build(const RemindList *list, const char *file_path, int64_t now, DueHeader *header) {
+    *header = (DueHeader) {
+        .version = DUE_VERSION,
+        .header_size = sizeof(*header),
+        .source = file_stamp(&list->st),
+    };
+    memcpy(header->magic, DUE_MAGIC, sizeof(header->magic));
+    Output entries = { .fd = -1 };
+    header->lines = add_block_entries(&entries, list->data, list->size, 1, now);
+    header->count = (uint32_t) (entries.len / sizeof(DueEntry));
+    if (!output_reserve(&entries, 1)) return NULL;
+    DueEntry *heap = (DueEntry *) entries.data;
+    heapify(heap, header->count);
+    if (!list->copied && file_stamp_settled(&list->st)) {
+        save_heap(file_path, header, heap);
+    }
+    return heap;
+}
+
+static int compare_lines(const void *a, const void *b) {
+    uint32_t la = *(const uint32_t *) a, lb = *(const uint32_t *) b;
+    return (la > lb) - (la < lb);
+}
+
+/// The physical lines -c leaves out at now, sorted, in a malloc'd array,
+/// and the time that set next changes (REMIND_NEVER if it never does).
+/// Only the rules whose change time has passed are evaluated; without a
+/// usable heap every line is, once, to build it. Returns -1 on error.
+int remind_due_hidden(const RemindList *list, const char *file_path, int64_t now,
+                      uint32_t **hidden, size_t *hidden_count, int64_t *valid_until) {
+    *hidden = NULL;
+    *hidden_count = 0;
+    *valid_until = REMIND_NEVER;
+    if (!list->data) return 0;
+
+    DueHeader header;
+    DueEntry *heap = NULL;
+    char path[PATH_MAX];
+    FileStamp stamp = file_stamp(&list->st);
+    int fd = list->copied || !due_path(path, sizeof(path), file_path) ? -1 : TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd >= 0) {
+        heap = load_heap(fd, &stamp, &header);
+        TRACED(close(fd));
+    }
+    bool saved = heap != NULL;
+    if (!heap) {
+        heap = heap_build(list, file_path, now, &header);
+        if (!heap) return -1;
+    }
+
+    // Pop what is due for re-evaluation. Every new change time is after
+    // now, so each entry is popped at most once.
+    LineCursor cursor = { .line = 1 };
+    bool dirty = false;
+    while (header.count > 0 && heap[0].change <= now) {
+        DueEntry *top = &heap[0];
+        if (!dirty && !list->copied) remind_index_map(list, file_path, &cursor.index);
+        bool found = remind_cursor_seek(list, &cursor, (long) top->line);
+        const char *text = list->data + cursor.offset;
+        const char *nl = found ? memchr(text, '\n', list->size - cursor.offset) : NULL;
+        size_t len = nl ? (size_t) (nl - text) : list->size - cursor.offset;
+        if (!found || !evaluate_line(text, len, top->line, now, top)) {
+            top->change = REMIND_NEVER;
+            top->shown = 1;
+        }
+        sift_down(heap, header.count, 0);
+        dirty = true;
+    }
+    remind_index_unmap(&cursor.index);
+    if (dirty && saved) {
+        save_heap(file_path, &header, heap);
+    }
+
+    int rc = 0;
+    size_t count = 0;
+    for (uint32_t i = 0; i < header.count; i++) count += !heap[i].shown;
+    if (count > 0) {
+        remind_trace.allocations++;
+        *hidden = malloc(count * sizeof(**hidden));
+        if (!*hidden) {
+            perror("malloc");
+            rc = -1;
+        } else {
+            for (uint32_t i = 0; i < header.count; i++) {
+                if (!heap[i].shown) (*hidden)[(*hidden_count)++] = heap[i].line;
+            }
+            qsort(*hidden, *hidden_count, sizeof(**hidden), compare_lines);
+        }
+    }
+    if (header.count > 0) *valid_until = heap[0].change;
+    free(heap);
+    return rc;
+}
+
+/// How many lines -c leaves out at now, read from a saved heap that
+/// matches stamp without opening the list. False when the heap is missing
+/// or stale, or has rules due for re-evaluation: the list must be opened.
+bool remind_due_peek(const char *file_path, const FileStamp *stamp, int64_t now, size_t *hidden_count) {
+    char path[PATH_MAX];
+    if (!due_path(path, sizeof(path), file_path)) return false;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+    DueHeader header;
+    DueEntry *heap = load_heap(fd, stamp, &header);
+    TRACED(close(fd));
+    if (!heap) return false;
+
+    bool current = header.count == 0 || heap[0].change > now;
+    *hidden_count = 0;
+    for (uint32_t i = 0; current && i < header.count; i++) *hidden_count += !heap[i].shown;
+    free(heap);
+    return current;
+}
+
+/// Opens an existing heap for an update, locked against other updaters,
+/// and reads it. Returns -1 unless it matches the list as it was before.
+static int open_for_update(const char *file_path, const struct stat *before, DueHeader *header, DueEntry **heap) {
+    char path[PATH_MAX];
+    if (!due_path(path, sizeof(path), file_path)) return -1;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return -1;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(flock(fd, LOCK_EX)) != 0 || !(*heap = load_heap(fd, &stamp, header))) {
+        TRACED(close(fd));
+        return -1;
+    }
+    return fd;
+}
+
+/// Pushes the scheduled lines appended to a list that matched the heap
+/// before. A newline written first to end an unterminated last line
+/// changes nothing here: that line keeps its number.
+void remind_due_append(const char *file_path, const struct stat *before, const struct stat *after,
+                       const char *data, size_t len) {
+    DueHeader header;
+    DueEntry *heap;
+    int fd = open_for_update(file_path, before, &header, &heap);
+    if (fd < 0) return;
+
+    Output entries = { .fd = -1 };
+    output_append(&entries, (const char *) heap, header.count * sizeof(*heap));
+    free(heap);
+    header.lines += add_block_entries(&entries, data, len, (uint32_t) header.lines + 1, (int64_t) time(NULL));
+    header.count = (uint32_t) (entries.len / sizeof(DueEntry));
+    header.source = file_stamp(after);
+    if (output_reserve(&entries, 1)) {
+        heapify((DueEntry *) entries.data, header.count);
+        save_heap(file_path, &header, (DueEntry *) entries.data);
+    }
+    output_free(&entries);
+    TRACED(close(fd));
+}
+
+/// Renumbers the heap after lines were deleted from a plain list (numbers
+/// as -d took them; the list had no tombstones, so they are physical)
+void remind_due_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                       const LineSet *set) {
+    DueHeader header;
+    DueEntry *heap;
+    int fd = open_for_update(file_path, before, &header, &heap);
+    if (fd < 0) return;
+
+    // removed[r]: lines deleted by the ranges before r
+    remind_trace.allocations++;
+    long *removed = malloc(((size_t) set->count + 1) * sizeof(*removed));
+    if (!removed) {
+        free(heap);
+        TRACED(close(fd));
+        return;
+    }
+    removed[0] = 0;
+    for (int r = 0; r < set->count; r++) {
+        long last = set->ranges[r].last < (long) header.lines ? set->ranges[r].last : (long) header.lines;
+        removed[r + 1] = removed[r] + (last >= set->ranges[r].first ? last - set->ranges[r].first + 1 : 0);
+    }
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < header.count; i++) {
+        // The first range that does not end before this line
+        long line = (long) heap[i].line;
+        int low = 0, high = set->count;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (set->ranges[mid].last < line) low = mid + 1;
+            else high = mid;
+        }
+        if (low < set->count && set->ranges[low].first <= line) continue;
+        heap[kept] = heap[i];
+        heap[kept++].line = (uint32_t) (line - removed[low]);
+    }
+    header.lines -= (uint64_t) removed[set->count];
+    header.count = kept;
+    header.source = file_stamp(after);
+    heapify(heap, header.count);
+    save_heap(file_path, &header, heap);
+    free(removed);
+    free(heap);
+    TRACED(close(fd));
+}
+
+/// Moves the heap from before to after when only the list's stamp changed,
+/// as it does when tombstones are written
+void remind_due_restamp(const char *file_path, const struct stat *before, const struct stat *after) {
+    DueHeader header;
+    DueEntry *heap;
+    int fd = open_for_update(file_path, before, &header, &heap);
+    if (fd < 0) return;
+    free(heap);
+    if (before->st_size == after->st_size) {
+        header.source = file_stamp(after);
+        TRACED(pwrite(fd, &header, sizeof(header), 0));
+    }
+    TRACED(close(fd));
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#include "remind.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+/*
+ * remind -s. A literal pattern is found with one scan over the raw list:
+ * the kernel compares the pattern's first and last bytes against 16 (SSE2)
+ * or 32 (AVX2, picked at run time) positions at once and only verifies the
+ * candidates where both agree, so most of the file is never looked at a
+ * byte at a time. Only the lines around a hit are then delimited and
+ * numbered. Patterns with regex metacharacters are compiled with regcomp()
+ * and tried line by line instead. Case folding is ASCII only, like the
+ * "C" locale regcomp() runs in.
+ */
+
+static const char REGEX_SPECIAL[] = ".[]()*+?{}|^$\\";
+
+static inline unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (unsigned char) (c + 'a' - 'A') : c;
+}
+
+static inline unsigned char unfold(unsigned char c) {
+    return c >= 'a' && c <= 'z' ? (unsigned char) (c - 'a' + 'A') : c;
+}
+
+static bool equal_folded(const char *a, const char *b, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (fold((unsigned char) a[i]) != fold((unsigned char) b[i])) return false;
+    }
+    return true;
+}
+
+static bool candidate_matches(const RemindPattern *pattern, const char *at) {
+    return pattern->icase ? equal_folded(at, pattern->text, pattern->len)
+                          : memcmp(at, pattern->text, pattern->len) == 0;
+}
+
+/// Portable kernel: memchr() to the next first byte, then compare. With
+/// case folding both spellings of the first byte are looked for.
+static const char *find_scalar(const RemindPattern *pattern, const char *hay, size_t size) {
+    const char *end = hay + size - pattern->len + 1;
+    unsigned char first = (unsigned char) pattern->text[0];
+    unsigned char other = !pattern->icase ? first : fold(first) != first ? fold(first) : unfold(first);
+    for (const char *p = hay; p < end; p++) {
+        if (first == other) {
+            p = memchr(p, first, end - p);
+            if (!p) return NULL;
+        } else if ((unsigned char) *p != first && (unsigned char) *p != other) {
+            continue;
+        }
+        if (candidate_matches(pattern, p)) return p;
+    }
+    return NULL;
+}
+
+#if defined(__SSE2__)
+static const char *find_sse2(const RemindPattern *pattern, const char *hay, size_t size) {
+    size_t last = pattern->len - 1;
+    unsigned char first = (unsigned char) pattern->text[0], final = (unsigned char) pattern->text[last];
+    const __m128i first_lo = _mm_set1_epi8((char) (pattern->icase ? fold(first) : first));
+    const __m128i final_lo = _mm_set1_epi8((char) (pattern->icase ? fold(final) : final));
+    const __m128i first_up = _mm_set1_epi8((char) (pattern->icase ? unfold(first) : first));
+    const __m128i final_up = _mm_set1_epi8((char) (pattern->icase ? unfold(final) : final));
+
+    size_t i = 0;
+    for (; i + last + 16 <= size; i += 16) {
+        __m128i head = _mm_loadu_si128((const __m128i *) (hay + i));
+        __m128i tail = _mm_loadu_si128((const __m128i *) (hay + i + last));
+        __m128i hits = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(head, first_lo), _mm_cmpeq_epi8(head, first_up)),
+            _mm_or_si128(_mm_cmpeq_epi8(tail, final_lo), _mm_cmpeq_epi8(tail, final_up)));
+        unsigned mask = (unsigned) _mm_movemask_epi8(hits);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (candidate_matches(pattern, hay + i + bit)) return hay + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return i + pattern->len <= size ? find_scalar(pattern, hay + i, size - i) : NULL;
+}
+#endif
+
+#if HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+static const char *find_avx2(const RemindPattern *pattern, const char *hay, size_t size) {
+    size_t last = pattern->len - 1;
+    unsigned char first = (unsigned char) pattern->text[0], final = (unsigned char) pattern->text[last];
+    const __m256i first_lo = _mm256_set1_epi8((char) (pattern->icase ? fold(first) : first));
+    const __m256i final_lo = _mm256_set1_epi8((char) (pattern->icase ? fold(final) : final));
+    const __m256i first_up = _mm256_set1_epi8((char) (pattern->icase ? unfold(first) : first));
+    const __m256i final_up = _mm256_set1_epi8((char) (pattern->icase ? unfold(final) : final));
+
+    size_t i = 0;
+    for (; i + last + 32 <= size; i += 32) {
+        __m256i head = _mm256_loadu_si256((const __m256i *) (hay + i));
+        __m256i tail = _mm256_loadu_si256((const __m256i *) (hay + i + last));
+        __m256i hits = _mm256_and_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(head, first_lo), _mm256_cmpeq_epi8(head, first_up)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(tail, final_lo), _mm256_cmpeq_epi8(tail, final_up)));
+        unsigned mask = (unsigned) _mm256_movemask_epi8(hits);
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (candidate_matches(pattern, hay + i + bit)) return hay + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return i + pattern->len <= size ? find_scalar(pattern, hay + i, size - i) : NULL;
+}
+#endif
+
+/// First occurrence of a literal pattern in hay, through the widest kernel
+/// this CPU has
+static const char *find_literal(const RemindPattern *pattern, const char *hay, size_t size) {
+    if (pattern->len == 0) return hay;
+    if (size < pattern->len) return NULL;
+#if HAVE_AVX2_KERNEL
+    static int avx2 = -1;
+    if (avx2 < 0) avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+    if (avx2) return find_avx2(pattern, hay, size);
+#endif
+#if defined(__SSE2__)
+    return find_sse2(pattern, hay, size);
+#else
+    return find_scalar(pattern, hay, size);
+#endif
+}
+
+/// True when the line [start, end) matches a compiled regex
+static bool line_matches_regex(const RemindPattern *pattern, const char *start, size_t len) {
+#ifdef REG_STARTEND
+    regmatch_t range = { .rm_so = 0, .rm_eo = (regoff_t) len };
+    return regexec(&pattern->regex, start, 1, &range, REG_STARTEND) == 0;
+#else
+    // Without REG_STARTEND the line needs a terminator of its own
+    char *copy = malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, start, len);
+    copy[len] = '\0';
+    bool matched = regexec(&pattern->regex, copy, 0, NULL, 0) == 0;
+    free(copy);
+    return matched;
+#endif
+}
+
+/// True when one line (without its newline) matches
+bool remind_line_matches(const RemindPattern *pattern, const char *text, size_t len) {
+    if (pattern->is_regex) {
+        return line_matches_regex(pattern, text, len);
+    }
+    return find_literal(pattern, text, len) != NULL;
+}
+
+/// Finds the first line at or after from that matches, as [start, end)
+static bool find_matching_line(const RemindPattern *pattern, const char *data, size_t size, size_t from,
+                               size_t *start, size_t *end) {
+    if (pattern->is_regex) {
+        while (from < size) {
+            const char *nl = memchr(data + from, '\n', size - from);
+            size_t line_end = nl ? (size_t) (nl - data) : size;
+            if (line_matches_regex(pattern, data + from, line_end - from)) {
+                *start = from;
+                *end = line_end;
+                return true;
+            }
+            from = line_end + 1;
+        }
+        return false;
+    }
+
+    // A line never contains a newline, so neither can a literal match
+    if (memchr(pattern->text, '\n', pattern->len)) return false;
+    const char *hit = find_literal(pattern, data + from, size - from);
+    if (!hit) return false;
+    const char *line_start = hit;
+    while (line_start > data + from && line_start[-1] != '\n') line_start--;
+    const char *nl = memchr(hit, '\n', data + size - hit);
+    *start = (size_t) (line_start - data);
+    *end = nl ? (size_t) (nl - data) : size;
+    return true;
+}
+
+/// Compiles a search pattern. Anything without regex metacharacters is a
+/// literal; the rest is a POSIX extended regex. Returns -1 after printing
+/// why when the regex does not compile.
+int remind_pattern_compile(RemindPattern *pattern, const char *text, bool icase) {
+    memset(pattern, 0, sizeof(*pattern));
+    pattern->text = text;
+    pattern->len = strlen(text);
+    pattern->icase = icase;
+    pattern->is_regex = strpbrk(text, REGEX_SPECIAL) != NULL;
+    if (!pattern->is_regex) {
+        return 0;
+    }
+
+    int rc = regcomp(&pattern->regex, text, REG_EXTENDED | REG_NOSUB | (icase ? REG_ICASE : 0));
+    if (rc != 0) {
+        char reason[256];
+        regerror(rc, &pattern->regex, reason, sizeof(reason));
+        fprintf(stderr, "Invalid pattern: %s: %s\n", text, reason);
+        pattern->is_regex = false;
+        return -1;
+    }
+    return 0;
+}
+
+void remind_pattern_free(RemindPattern *pattern) {
+    if (pattern->is_regex) {
+        regfree(&pattern->regex);
+        pattern->is_regex = false;
+    }
+}
+
+/// Advances line to the next live line that matches, numbered as in the
+/// full list. Start from `RemindLine line = {0}`, like remind_next_line().
+/// The lines skipped over are only counted, with memchr(), never split.
+bool remind_next_match(const RemindList *list, const RemindPattern *pattern, RemindLine *line) {
+    const char *data = list->data;
+    if (!data) {
+        return false;
+    }
+    size_t from = line->number == 0 ? 0 : (size_t) (line->text - data) + line->len + 1;
+    long number = line->number;
+    size_t dead = line->next_dead;
+
+    while (from < list->size) {
+        size_t start, end;
+        if (!find_matching_line(pattern, data, list->size, from, &start, &end)) {
+            return false;
+        }
+        // Every line between from and start ends in a newline, so counting
+        // them is counting newlines; the dead ones among them are not numbered
+        while (dead < list->dead_count && list->dead[dead] < from) dead++;
+        size_t dead_from = dead;
+        while (dead < list->dead_count && list->dead[dead] < start) dead++;
+        number += (long) remind_count_lines(data + from, start - from) - (long) (dead - dead_from);
+        from = end + 1;
+        if (dead < list->dead_count && list->dead[dead] == start) {
+            continue;
+        }
+
+        line->text = data + start;
+        line->len = end - start;
+        line->number = ++number;
+        line->next_dead = dead;
+        return true;
+    }
+    return false;
+}
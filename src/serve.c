@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "remind.h"
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+/*
+ * remind --serve: one process keeps the list parsed and rendered, and the
+ * CLI asks it instead of opening, parsing and rendering the file itself.
+ *
+ * The server listens on reminders.sock next to the list. Each request is a
+ * ServeHeader (the op and the payload length) followed by the payload; the
+ * reply is a ServeHeader carrying the status, followed by its payload. One
+ * request per connection, answered in order by a single thread.
+ *
+ * The rendering is rebuilt only when an inotify watch says the list
+ * changed, or when a scheduled reminder comes or goes. Events are drained
+ * before each request is answered, so a change made by a command that has
+ * already returned is always seen. Adds and deletes sent to the server go
+ * through remind_append() and remind_delete() as they would from the CLI,
+ * with the server's environment deciding the storage. Whatever they print
+ * on stderr is sent back as the reply payload, for the client to print on
+ * its own stderr; so is the error of a check or count that fails.
+ */
+
+typedef struct {
+    uint32_t op;        // ServeOp in requests, status (0 = ok) in replies
+    uint32_t length;    // bytes of payload that follow
+} ServeHeader;
+
+// Larger than any list anybody would add in one go
+#define SERVE_MAX_PAYLOAD (256u * 1024 * 1024)
+
+static bool socket_path(const char *file_path, struct sockaddr_un *addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    return remind_sidecar_path(addr->sun_path, sizeof(addr->sun_path), file_path, ".sock");
+}
+
+/// Reads exactly len bytes. False on error or a short read.
+static bool read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = TRACED(read(fd, p, len));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t) n;
+    }
+    return true;
+}
+
+/// Sends one request to a running server and collects the reply payload
+/// into reply. Returns the server's status, or -1 when there is no server
+/// to ask. Asking costs a single access() when none is running.
+int remind_serve_call(const char *file_path, ServeOp op, const void *payload, size_t len, Output *reply) {
+    struct sockaddr_un addr;
+    if (len > SERVE_MAX_PAYLOAD || !socket_path(file_path, &addr) || TRACED(access(addr.sun_path, F_OK)) != 0) {
+        return -1;
+    }
+    int fd = TRACED(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (fd < 0) return -1;
+    // A socket left behind by a server that died refuses the connection
+    if (TRACED(connect(fd, (struct sockaddr *) &addr, sizeof(addr))) != 0) {
+        TRACED(close(fd));
+        return -1;
+    }
+
+    ServeHeader header = { .op = op, .length = (uint32_t) len };
+    if (write_all(fd, (const char *) &header, sizeof(header)) != 0 ||
+        (len > 0 && write_all(fd, payload, len) != 0)) {
+        TRACED(close(fd));
+        return -1;
+    }
+    // The request is out: from here on it may have been carried out, so a
+    // failure is reported rather than retried against the file
+    if (!read_full(fd, &header, sizeof(header)) || header.length > SERVE_MAX_PAYLOAD ||
+        !output_reserve(reply, header.length) || !read_full(fd, reply->data + reply->len, header.length)) {
+        fprintf(stderr, "remind: lost the connection to remind --serve\n");
+        TRACED(close(fd));
+        return 1;
+    }
+    reply->len += header.length;
+    TRACED(close(fd));
+    return (int) header.op;
+}
+
+#ifdef __linux__
+typedef struct {
+    const char *file_path;
+    Output rendered;        // what -c prints, good until valid_until
+    uint64_t count;         // and how many reminders that is
+    int64_t valid_until;
+    bool stale;             // the list changed since rendered was built
+} Server;
+
+static volatile sig_atomic_t stopping;
+
+static void stop_serving(int signo) {
+    (void) signo;
+    stopping = 1;
+}
+
+/// Rebuilds the rendering and count from the list as it is now
+static int refresh(Server *server, int64_t now) {
+    server->rendered.len = 0;
+    server->count = 0;
+    server->valid_until = REMIND_NEVER;
+    server->stale = false;
+
+    struct stat st;
+    if (remind_list_stat(server->file_path, &st) != 0 || st.st_size == 0) return 0;
+    RemindList list;
+    if (remind_list_open(&list, server->file_path) != 0) {
+        server->stale = true;
+        return -1;
+    }
+    if (list.data) {
+        remind_render_due(&server->rendered, &list, server->file_path, now, &server->valid_until);
+        uint64_t live = remind_count_lines(list.data, list.size) - list.dead_count;
+        server->count = remind_count_shown(&list, server->file_path, live, now);
+    }
+    remind_list_close(&list);
+    return 0;
+}
+
+/// Points stderr at a temporary file until end_capture(), so the messages
+/// of a request end up with its client rather than on the server's terminal.
+/// Returns the saved stderr, or -1 when the messages stay where they are.
+static int begin_capture(FILE **capture) {
+    *capture = tmpfile();
+    if (!*capture) return -1;
+    fflush(stderr);
+    int saved = TRACED(dup(STDERR_FILENO));
+    if (saved < 0 || TRACED(dup2(fileno(*capture), STDERR_FILENO)) < 0) {
+        if (saved >= 0) TRACED(close(saved));
+        fclose(*capture);
+        *capture = NULL;
+        return -1;
+    }
+    return saved;
+}
+
+/// Puts stderr back and appends what was written to it to out
+static void end_capture(FILE *capture, int saved, Output *out) {
+    if (saved < 0) return;
+    fflush(stderr);
+    TRACED(dup2(saved, STDERR_FILENO));
+    TRACED(close(saved));
+    rewind(capture);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), capture)) > 0) output_append(out, buf, n);
+    fclose(capture);
+}
+
+/// Checks the ranges of a SERVE_DELETE payload are what line_set_parse()
+/// would have built: positive, ordered and not overlapping
+static bool ranges_valid(const LineRange *ranges, size_t count) {
+    long previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (ranges[i].first <= previous || ranges[i].last < ranges[i].first) return false;
+        previous = ranges[i].last;
+    }
+    return true;
+}
+
+/// Answers one request on client
+static void answer(Server *server, int client, ListWatch *watch) {
+    ServeHeader header;
+    if (!read_full(client, &header, sizeof(header)) || header.length > SERVE_MAX_PAYLOAD) return;
+    char *payload = NULL;
+    if (header.length > 0) {
+        remind_trace.allocations++;
+        payload = malloc(header.length);
+        if (!payload || !read_full(client, payload, header.length)) {
+            free(payload);
+            return;
+        }
+    }
+
+    if (remind_watch_changed(watch)) server->stale = true;
+    int64_t now = (int64_t) time(NULL);
+    const void *reply = NULL;
+    size_t reply_len = 0;
+    int status = 0;
+    FILE *capture;
+    int saved_stderr = begin_capture(&capture);
+    switch (header.op) {
+        case SERVE_CHECK:
+            if (server->stale || now >= server->valid_until) status = refresh(server, now) == 0 ? 0 : 1;
+            reply = server->rendered.data;
+            reply_len = server->rendered.len;
+            break;
+
+        case SERVE_COUNT:
+            if (server->stale || now >= server->valid_until) status = refresh(server, now) == 0 ? 0 : 1;
+            reply = &server->count;
+            reply_len = sizeof(server->count);
+            break;
+
+        case SERVE_ADD:
+            status = remind_append(server->file_path, payload, header.length) == 0 ? 0 : 1;
+            server->stale = true;
+            break;
+
+        case SERVE_DELETE: {
+            LineSet set = { .ranges = (LineRange *) payload, .count = (int) (header.length / sizeof(LineRange)) };
+            if (header.length % sizeof(LineRange) != 0 || !ranges_valid(set.ranges, (size_t) set.count)) {
+                fprintf(stderr, "remind: malformed delete request\n");
+                status = 1;
+                break;
+            }
+            status = remind_delete(server->file_path, &set) < 0 ? 1 : 0;
+            server->stale = true;
+            break;
+        }
+
+        default:
+            fprintf(stderr, "remind: unknown request %u\n", header.op);
+            status = 1;
+            break;
+    }
+
+    // Adds and deletes reply with their messages; a failed check or count
+    // replies with its error in place of the list or the count
+    Output messages = { .fd = -1 };
+    end_capture(capture, saved_stderr, &messages);
+    if (status != 0 || header.op == SERVE_ADD || header.op == SERVE_DELETE) {
+        reply = messages.data;
+        reply_len = messages.len;
+    }
+
+    ServeHeader out = { .op = (uint32_t) status, .length = (uint32_t) reply_len };
+    if (write_all(client, (const char *) &out, sizeof(out)) == 0 && reply_len > 0) {
+        write_all(client, reply, reply_len);
+    }
+    output_free(&messages);
+    free(payload);
+}
+
+/// Serves requests until SIGINT or SIGTERM, then removes the socket.
+/// Returns -1 when it cannot start.
+int remind_serve(const char *file_path) {
+    struct sockaddr_un addr;
+    if (!socket_path(file_path, &addr)) {
+        fprintf(stderr, "remind: %s.sock is too long a path for a socket\n", file_path);
+        return -1;
+    }
+    ListWatch watch;
+    if (remind_watch_list(&watch, file_path) != 0) return -1;
+
+    int listen_fd = TRACED(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (TRACED(connect(listen_fd, (struct sockaddr *) &addr, sizeof(addr))) == 0) {
+        fprintf(stderr, "remind: a server is already listening on %s\n", addr.sun_path);
+        return -1;
+    }
+    // Whatever is there is a leftover from a server that is gone
+    TRACED(unlink(addr.sun_path));
+    // Only the owner may connect: the server adds and deletes on request
+    mode_t mask = umask(077);
+    int bound = TRACED(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)));
+    umask(mask);
+    if (bound != 0 || TRACED(listen(listen_fd, SOMAXCONN)) != 0) {
+        perror(addr.sun_path);
+        return -1;
+    }
+
+    struct sigaction action = { .sa_handler = stop_serving };
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server = { .file_path = file_path, .rendered = { .fd = -1 } };
+    refresh(&server, (int64_t) time(NULL));
+    int rc = 0;
+    while (!stopping) {
+        struct pollfd fds[] = {
+            { .fd = listen_fd, .events = POLLIN },
+            { .fd = watch.fd, .events = POLLIN },
+        };
+        if (TRACED(poll(fds, 2, -1)) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            rc = -1;
+            break;
+        }
+        if ((fds[1].revents & POLLIN) && remind_watch_changed(&watch)) {
+            server.stale = true;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = TRACED(accept(listen_fd, NULL, NULL));
+            if (client >= 0) {
+                // A client that stalls mid-request must not wedge everyone else
+                struct timeval timeout = { .tv_sec = 1 };
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                answer(&server, client, &watch);
+                TRACED(close(client));
+            }
+        }
+    }
+
+    TRACED(unlink(addr.sun_path));
+    TRACED(close(listen_fd));
+    TRACED(close(watch.fd));
+    output_free(&server.rendered);
+    return rc;
+}
+#else
+int remind_serve(const char *file_path) {
+    (void) file_path;
+    fprintf(stderr, "remind --serve needs inotify, which this system does not have\n");
+    return -1;
+}
+#endif
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "remind.h"
+
+/*
+ * Tags are words written "+name" anywhere in a reminder, so the text
+ * stays the single source of truth and an editor session cannot lose them.
+ * reminders.tags lists, for every tag, the physical lines that carry it,
+ * as (hash of the name, line number) records: first a run sorted by tag
+ * and line, then the records of lines appended since, in line order. A
+ * filtered listing is a binary search of the sorted run and a pass over
+ * the short tail, and only the lines found are read from the list, through
+ * the line-offset index.
+ *
+ * The index is built by the first -t, tagged with the list's FileStamp
+ * like the other sidecars. Adds append records for the new lines and fold
+ * the tail into the sorted run once it grows; plain deletes renumber the
+ * records; tombstone deletes only restamp it. Anything else leaves it
+ * stale, and the next -t rebuilds it. Every hit is checked against the
+ * line itself, so hash collisions never show up in the output.
+ */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    uint64_t lines;         // physical lines indexed
+    uint32_t sorted;        // records sorted by tag, then line
+    uint32_t tail;          // records appended after them, by line
+} TagHeader;
+
+typedef struct {
+    uint32_t tag;           // tag_hash() of the name
+    uint32_t line;          // physical line number, 1-based
+} TagRecord;
+
+#define TAG_MAGIC "RMDTAGIX"
+#define TAG_VERSION 1
+/// The tail is sorted into the run once it is this big and a quarter of it
+#define TAG_TAIL_MIN 4096
+
+static bool tags_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".tags");
+}
+
+static bool header_valid(const TagHeader *header) {
+    return memcmp(header->magic, TAG_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == TAG_VERSION &&
+           header->header_size == sizeof(*header);
+}
+
+/// Letters, digits, '_', '-' and any non-ASCII byte; the rest ends a tag
+static inline bool tag_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c >= 0x80;
+}
+
+/// FNV-1a
+static uint32_t tag_hash(const char *name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/// True when name is a tag as it would be written after the '+'
+bool remind_tag_valid(const char *name) {
+    if (*name == '\0') return false;
+    for (const char *p = name; *p; p++) {
+        if (!tag_char((unsigned char) *p)) return false;
+    }
+    return true;
+}
+
+/// Finds the next "+name" at or after *at: a '+' at the start of the line
+/// or after a space or tab, followed by at least one tag character
+static bool next_tag(const char *text, size_t len, size_t *at, const char **name, size_t *name_len) {
+    for (size_t i = *at; i + 1 < len; i++) {
+        if (text[i] != '+' || (i > 0 && text[i - 1] != ' ' && text[i - 1] != '\t')) continue;
+        size_t end = i + 1;
+        while (end < len && tag_char((unsigned char) text[end])) end++;
+        if (end == i + 1) continue;
+        *name = text + i + 1;
+        *name_len = end - i - 1;
+        *at = end;
+        return true;
+    }
+    return false;
+}
+
+/// True when the line carries +name (matched exactly, case included)
+bool remind_line_has_tag(const char *text, size_t len, const char *name) {
+    size_t name_len = strlen(name);
+    size_t at = 0;
+    const char *found;
+    size_t found_len;
+    while (next_tag(text, len, &at, &found, &found_len)) {
+        if (found_len == name_len && memcmp(found, name, name_len) == 0) return true;
+    }
+    return false;
+}
+
+/// Appends one record per distinct tag of a line
+static void add_line_records(Output *records, const char *text, size_t len, uint32_t line) {
+    size_t first = records->len;
+    size_t at = 0;
+    const char *name;
+    size_t name_len;
+    while (next_tag(text, len, &at, &name, &name_len)) {
+        TagRecord record = { .tag = tag_hash(name, name_len), .line = line };
+        bool seen = false;
+        for (size_t r = first; r < records->len && !seen; r += sizeof(record)) {
+            seen = ((const TagRecord *) (records->data + r))->tag == record.tag;
+        }
+        if (!seen) output_append(records, (const char *) &record, sizeof(record));
+    }
+}
+
+/// Records for every line of data, numbered from first_line
+static uint32_t add_block_records(Output *records, const char *data, size_t len, uint32_t first_line) {
+    uint32_t line = first_line;
+    const char *end = data + len;
+    for (const char *p = data; p < end; line++) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        add_line_records(records, p, line_end - p, line);
+        p = line_end + 1;
+    }
+    return line - first_line;
+}
+
+static int compare_records(const void *a, const void *b) {
+    const TagRecord *ra = a, *rb = b;
+    if (ra->tag != rb->tag) return (ra->tag > rb->tag) - (ra->tag < rb->tag);
+    return (ra->line > rb->line) - (ra->line < rb->line);
+}
+
+/// Writes header and records, all sorted, as a new index file
+static int tags_write(const char *file_path, TagHeader *header, TagRecord *records, size_t count) {
+    char path[PATH_MAX];
+    if (!tags_path(path, sizeof(path), file_path)) return -1;
+    qsort(records, count, sizeof(*records), compare_records);
+    header->sorted = (uint32_t) count;
+    header->tail = 0;
+    struct iovec parts[] = {
+        { header, sizeof(*header) },
+        { records, count * sizeof(*records) },
+    };
+    return remind_replace_file(path, parts, 2, false);
+}
+
+/// Indexes every physical line of a mapped list, tombstoned or not, unless
+/// it changed too recently to be told apart from its next version (see
+/// file_stamp_settled())
+static int tags_build(const RemindList *list, const char *file_path) {
+    if (!file_stamp_settled(&list->st)) return -1;
+    TagHeader header = {
+        .version = TAG_VERSION,
+        .header_size = sizeof(header),
+        .source = file_stamp(&list->st),
+    };
+    memcpy(header.magic, TAG_MAGIC, sizeof(header.magic));
+
+    Output records = { .fd = -1 };
+    header.lines = add_block_records(&records, list->data, list->size, 1);
+    int rc = tags_write(file_path, &header, (TagRecord *) records.data, records.len / sizeof(TagRecord));
+    output_free(&records);
+    return rc;
+}
+
+/// A mapped index that matches the list
+typedef struct {
+    void *mapping;
+    size_t mapping_size;
+    TagHeader header;
+    const TagRecord *records;
+} TagMap;
+
+static bool map_open(TagMap *map, const char *file_path, const struct stat *st) {
+    memset(map, 0, sizeof(*map));
+    char path[PATH_MAX];
+    if (!tags_path(path, sizeof(path), file_path)) return false;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+    struct stat index_st;
+    bool ok = TRACED(fstat(fd, &index_st)) == 0 && (size_t) index_st.st_size >= sizeof(TagHeader);
+    void *data = ok ? TRACED(mmap(NULL, (size_t) index_st.st_size, PROT_READ, MAP_SHARED, fd, 0)) : MAP_FAILED;
+    TRACED(close(fd));
+    if (data == MAP_FAILED) return false;
+
+    memcpy(&map->header, data, sizeof(map->header));
+    FileStamp stamp = file_stamp(st);
+    uint64_t count = (uint64_t) map->header.sorted + map->header.tail;
+    if (!header_valid(&map->header) || !file_stamp_equal(&map->header.source, &stamp) ||
+        sizeof(TagHeader) + count * sizeof(TagRecord) > (uint64_t) index_st.st_size) {
+        TRACED(munmap(data, (size_t) index_st.st_size));
+        return false;
+    }
+    map->mapping = data;
+    map->mapping_size = (size_t) index_st.st_size;
+    map->records = (const TagRecord *) ((const char *) data + sizeof(TagHeader));
+    remind_trace.bytes_read += sizeof(TagHeader);
+    return true;
+}
+
+static void map_close(TagMap *map) {
+    if (map->mapping) TRACED(munmap(map->mapping, map->mapping_size));
+    memset(map, 0, sizeof(*map));
+}
+
+/// Adds the live line at physical line `line` to found if it carries the tag
+static bool collect_line(const RemindList *list, LineCursor *cursor, long line, const char *name,
+                         RemindLine *found, long *count) {
+    if (!remind_cursor_seek(list, cursor, line)) return false;
+    const char *text = list->data + cursor->offset;
+    const char *nl = memchr(text, '\n', list->size - cursor->offset);
+    size_t len = nl ? (size_t) (nl - text) : list->size - cursor->offset;
+    size_t dead = remind_dead_before(list, cursor->offset);
+    if (dead < list->dead_count && list->dead[dead] == cursor->offset) return true;
+    if (!remind_line_has_tag(text, len, name)) return true;
+    found[(*count)++] = (RemindLine) {
+        .text = text,
+        .len = len,
+        .number = cursor->line - (long) dead,
+        .next_dead = dead,
+    };
+    return true;
+}
+
+/// Answers a tag listing from the index, building it if needed: the live
+/// lines carrying +name, in order, in a malloc'd array. Returns -1 when
+/// there is no usable index (a chunked list, or one changed too recently
+/// to index) and the caller should scan instead.
+long remind_tags_search(const RemindList *list, const char *file_path, const char *name, RemindLine **matches) {
+    *matches = NULL;
+    if (!list->data || list->copied) return -1;
+    TagMap map;
+    if (!map_open(&map, file_path, &list->st)) {
+        if (tags_build(list, file_path) != 0 || !map_open(&map, file_path, &list->st)) {
+            return -1;
+        }
+    }
+
+    uint32_t hash = tag_hash(name, strlen(name));
+    size_t low = 0, high = map.header.sorted;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (map.records[mid].tag < hash) low = mid + 1;
+        else high = mid;
+    }
+    size_t sorted_end = low;
+    while (sorted_end < map.header.sorted && map.records[sorted_end].tag == hash) sorted_end++;
+    const TagRecord *tail = map.records + map.header.sorted;
+    size_t candidates = sorted_end - low;
+    for (uint32_t t = 0; t < map.header.tail; t++) candidates += tail[t].tag == hash;
+
+    remind_trace.allocations++;
+    RemindLine *found = malloc((candidates ? candidates : 1) * sizeof(*found));
+    if (!found) {
+        perror("malloc");
+        map_close(&map);
+        return -1;
+    }
+
+    // Both runs are in line order and the tail only has later lines, so
+    // the cursor only ever moves forward
+    long count = 0;
+    LineCursor cursor = { .line = 1 };
+    if (candidates > 0) remind_index_map(list, file_path, &cursor.index);
+    bool more = true;
+    for (size_t r = low; r < sorted_end && more; r++) {
+        more = collect_line(list, &cursor, (long) map.records[r].line, name, found, &count);
+    }
+    for (uint32_t t = 0; t < map.header.tail && more; t++) {
+        if (tail[t].tag == hash) more = collect_line(list, &cursor, (long) tail[t].line, name, found, &count);
+    }
+    remind_index_unmap(&cursor.index);
+    map_close(&map);
+    *matches = found;
+    return count;
+}
+
+/// Opens an existing index for an update and locks it against other
+/// updaters. Returns -1 unless it matches the list as it was before.
+static int open_for_update(const char *file_path, const struct stat *before, TagHeader *header) {
+    char path[PATH_MAX];
+    if (!tags_path(path, sizeof(path), file_path)) return -1;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return -1;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(flock(fd, LOCK_EX)) != 0 ||
+        TRACED(pread(fd, header, sizeof(*header), 0)) != (ssize_t) sizeof(*header) ||
+        !header_valid(header) || !file_stamp_equal(&header->source, &stamp)) {
+        TRACED(close(fd));
+        return -1;
+    }
+    return fd;
+}
+
+/// Reads every record of an index opened for update
+static TagRecord *read_records(int fd, const TagHeader *header, size_t *count) {
+    *count = (size_t) header->sorted + header->tail;
+    remind_trace.allocations++;
+    TagRecord *records = malloc((*count ? *count : 1) * sizeof(*records));
+    size_t bytes = *count * sizeof(*records);
+    if (records && bytes > 0 &&
+        TRACED(pread(fd, records, bytes, sizeof(*header))) != (ssize_t) bytes) {
+        free(records);
+        return NULL;
+    }
+    remind_trace.bytes_read += bytes;
+    return records;
+}
+
+/// Indexes the tags of lines appended to a list that matched the index
+/// before. A newline written first to end an unterminated last line
+/// changes nothing here: that line keeps its number.
+void remind_tags_append(const char *file_path, const struct stat *before, const struct stat *after,
+                        const char *data, size_t len) {
+    TagHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+
+    Output added = { .fd = -1 };
+    header.lines += add_block_records(&added, data, len, (uint32_t) header.lines + 1);
+    header.source = file_stamp(after);
+    size_t added_count = added.len / sizeof(TagRecord);
+    size_t tail = header.tail + added_count;
+
+    if (tail >= TAG_TAIL_MIN && tail * 4 >= header.sorted) {
+        size_t count;
+        TagRecord *records = read_records(fd, &header, &count);
+        TagRecord *grown = records ? realloc(records, (count + added_count + 1) * sizeof(*records)) : NULL;
+        if (grown) {
+            memcpy(grown + count, added.data, added.len);
+            tags_write(file_path, &header, grown, count + added_count);
+        }
+        free(grown ? grown : records);
+    } else {
+        // Records first, then the header that counts them
+        off_t records_at = (off_t) (sizeof(header) + ((size_t) header.sorted + header.tail) * sizeof(TagRecord));
+        header.tail = (uint32_t) tail;
+        if ((added.len == 0 ||
+             TRACED(pwrite(fd, added.data, added.len, records_at)) == (ssize_t) added.len) &&
+            TRACED(pwrite(fd, &header, sizeof(header), 0)) == (ssize_t) sizeof(header)) {
+            remind_trace.bytes_written += added.len + sizeof(header);
+        }
+    }
+    output_free(&added);
+    TRACED(close(fd));
+}
+
+/// Renumbers the index after lines were deleted from a plain list (numbers
+/// as -d took them; the list had no tombstones, so they are physical)
+void remind_tags_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                        const LineSet *set) {
+    TagHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+    size_t count;
+    TagRecord *records = read_records(fd, &header, &count);
+    if (!records) {
+        TRACED(close(fd));
+        return;
+    }
+
+    // Renumbering keeps both runs in order: walk each one with the ranges
+    size_t kept = 0;
+    size_t runs[2][2] = { { 0, header.sorted }, { header.sorted, count } };
+    uint32_t kept_sorted = 0;
+    for (int run = 0; run < 2; run++) {
+        size_t start = kept;
+        uint32_t previous_tag = 0;
+        int r = 0;
+        long removed_before = 0;
+        for (size_t i = runs[run][0]; i < runs[run][1]; i++) {
+            TagRecord record = records[i];
+            // The sorted run starts over at every tag
+            if (run == 0 && (i == runs[run][0] || record.tag != previous_tag)) {
+                r = 0;
+                removed_before = 0;
+            }
+            previous_tag = record.tag;
+            while (r < set->count && set->ranges[r].last < (long) record.line) {
+                removed_before += set->ranges[r].last - set->ranges[r].first + 1;
+                r++;
+            }
+            if (r < set->count && set->ranges[r].first <= (long) record.line) continue;
+            record.line -= (uint32_t) removed_before;
+            records[kept++] = record;
+        }
+        if (run == 0) kept_sorted = (uint32_t) (kept - start);
+    }
+
+    long deleted = 0;
+    for (int r = 0; r < set->count && set->ranges[r].first <= (long) header.lines; r++) {
+        long last = set->ranges[r].last < (long) header.lines ? set->ranges[r].last : (long) header.lines;
+        deleted += last - set->ranges[r].first + 1;
+    }
+    header.lines -= (uint64_t) deleted;
+    header.source = file_stamp(after);
+
+    char path[PATH_MAX];
+    if (tags_path(path, sizeof(path), file_path)) {
+        header.sorted = kept_sorted;
+        header.tail = (uint32_t) (kept - kept_sorted);
+        struct iovec parts[] = {
+            { &header, sizeof(header) },
+            { records, kept * sizeof(*records) },
+        };
+        remind_replace_file(path, parts, 2, false);
+    }
+    free(records);
+    TRACED(close(fd));
+}
+
+/// Moves the index from before to after when only the list's stamp changed,
+/// as it does when tombstones are written
+void remind_tags_restamp(const char *file_path, const struct stat *before, const struct stat *after) {
+    TagHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+    if (before->st_size == after->st_size) {
+        header.source = file_stamp(after);
+        TRACED(pwrite(fd, &header, sizeof(header), 0));
+    }
+    TRACED(close(fd));
+}
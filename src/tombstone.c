@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+
+#include "remind.h"
+
+/*
+ * Log-structured deletes. With REMIND_STORAGE=log a delete leaves the list
+ * alone and appends a TombRecord per line to reminders.tomb; readers skip
+ * those lines and number the rest as if they were gone. The list is still
+ * plain text, so it is compacted (tombstoned lines dropped for real) before
+ * $EDITOR sees it, and whenever the dead lines grow past a quarter of the
+ * file. Compaction renames a fresh file into place, which gives the list a
+ * new inode and so retires every tombstone written against the old one.
+ */
+
+/// Header of reminders.tomb, followed by TombRecords
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t ino;
+    uint64_t dev;
+} TombHeader;
+
+#define TOMB_MAGIC "RMDTOMBS"
+#define TOMB_VERSION 1
+
+/// True when REMIND_STORAGE asks for tombstone deletes
+bool remind_log_storage(void) {
+    const char *v = getenv("REMIND_STORAGE");
+    return v && strcmp(v, "log") == 0;
+}
+
+/// 32-bit FNV-1a, enough to tell a tombstoned line from whatever replaced it
+uint32_t remind_line_hash(const char *text, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool header_matches(const TombHeader *header, const struct stat *list_st) {
+    return memcmp(header->magic, TOMB_MAGIC, sizeof(header->magic)) == 0 &&
+           header->version == TOMB_VERSION &&
+           header->header_size == sizeof(*header) &&
+           header->ino == (uint64_t) list_st->st_ino &&
+           header->dev == (uint64_t) list_st->st_dev;
+}
+
+/// True when a tombstone file is present, whether or not it still applies
+bool remind_tombs_exist(const char *file_path) {
+    char tomb_path[PATH_MAX];
+    struct stat st;
+    return remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb") &&
+           TRACED(stat(tomb_path, &st)) == 0;
+}
+
+static int compare_offsets(const void *a, const void *b) {
+    uint64_t oa = *(const uint64_t *) a, ob = *(const uint64_t *) b;
+    return (oa > ob) - (oa < ob);
+}
+
+/// Loads the tombstones that still apply to the mapped list into list->dead.
+/// A missing file means nothing is dead. Records for another inode, or that
+/// no longer point at the line they deleted (the list was edited behind our
+/// back), are ignored rather than trusted.
+int remind_tombs_load(RemindList *list, const char *file_path) {
+    char tomb_path[PATH_MAX];
+    if (!list->data || !remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) return 0;
+    int fd = TRACED(open(tomb_path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) != 0 || (size_t) st.st_size < sizeof(TombHeader)) {
+        TRACED(close(fd));
+        return 0;
+    }
+    size_t size = (size_t) st.st_size;
+    remind_trace.allocations++;
+    char *buf = malloc(size);
+    if (!buf) {
+        perror("malloc");
+        TRACED(close(fd));
+        return -1;
+    }
+    ssize_t n = TRACED(read(fd, buf, size));
+    TRACED(close(fd));
+    if (n > 0) remind_trace.bytes_read += (uint64_t) n;
+
+    TombHeader header;
+    memcpy(&header, buf, sizeof(header));
+    if (n != (ssize_t) size || !header_matches(&header, &list->st)) {
+        free(buf);
+        return 0;
+    }
+
+    size_t count = (size - sizeof(header)) / sizeof(TombRecord);
+    remind_trace.allocations++;
+    list->dead = malloc((count ? count : 1) * sizeof(*list->dead));
+    if (!list->dead) {
+        perror("malloc");
+        free(buf);
+        return -1;
+    }
+
+    const char *data = list->data;
+    for (size_t i = 0; i < count; i++) {
+        TombRecord record;
+        memcpy(&record, buf + sizeof(header) + i * sizeof(record), sizeof(record));
+        uint64_t end = record.offset + record.len;
+        if (end > list->size ||
+            (record.offset > 0 && data[record.offset - 1] != '\n') ||
+            (end < list->size && data[end] != '\n') ||
+            remind_line_hash(data + record.offset, record.len) != record.hash) {
+            continue;
+        }
+        list->dead[list->dead_count++] = record.offset;
+    }
+    free(buf);
+
+    // Records are in deletion order; readers want them by position
+    qsort(list->dead, list->dead_count, sizeof(*list->dead), compare_offsets);
+    size_t unique = 0;
+    for (size_t i = 0; i < list->dead_count; i++) {
+        if (unique > 0 && list->dead[unique - 1] == list->dead[i]) continue;
+        list->dead[unique++] = list->dead[i];
+    }
+    list->dead_count = unique;
+    for (size_t i = 0; i < unique; i++) {
+        const char *p = data + list->dead[i];
+        const char *nl = memchr(p, '\n', data + list->size - p);
+        list->dead_bytes += (nl ? nl + 1 : data + list->size) - p;
+    }
+    return 0;
+}
+
+/// Appends tombstones for lines of the list identified by list_st. The
+/// caller holds the exclusive lock. A file left over from another inode is
+/// started afresh, since none of its records can apply any more.
+int remind_tombs_append(const char *file_path, const struct stat *list_st, const TombRecord *records, size_t count) {
+    char tomb_path[PATH_MAX];
+    if (!remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) {
+        fprintf(stderr, "Path too long: %s\n", file_path);
+        return -1;
+    }
+    int fd = TRACED(open(tomb_path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644));
+    if (fd < 0) {
+        perror("open tombstones");
+        return -1;
+    }
+
+    TombHeader header = {0};
+    bool fresh = TRACED(pread(fd, &header, sizeof(header), 0)) != (ssize_t) sizeof(header) ||
+                 !header_matches(&header, list_st);
+    if (fresh) {
+        header = (TombHeader) {
+            .version = TOMB_VERSION,
+            .header_size = sizeof(header),
+            .ino = (uint64_t) list_st->st_ino,
+            .dev = (uint64_t) list_st->st_dev,
+        };
+        memcpy(header.magic, TOMB_MAGIC, sizeof(header.magic));
+        if (TRACED(ftruncate(fd, 0)) != 0) {
+            perror("ftruncate");
+            TRACED(close(fd));
+            return -1;
+        }
+    }
+
+    Output out = { .fd = -1 };
+    if (fresh) output_append(&out, (const char *) &header, sizeof(header));
+    output_append(&out, (const char *) records, count * sizeof(*records));
+    int rc = write_all(fd, out.data, out.len);
+    if (rc != 0) {
+        perror("write tombstones");
+    }
+    output_free(&out);
+    TRACED(close(fd));
+    return rc;
+}
+
+/// Carries the tombstones across an edit that replaced one live line of the
+/// list identified by before: records at or past `from` move by delta, and
+/// the file is made to name the list identified by after, which a rewrite
+/// gives a new inode. The caller holds the exclusive lock. Records that no
+/// longer applied before the edit are left to be ignored as they were.
+int remind_tombs_shift(const char *file_path, const struct stat *before, const struct stat *after,
+                       uint64_t from, int64_t delta) {
+    char tomb_path[PATH_MAX];
+    if (!remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) return 0;
+    int fd = TRACED(open(tomb_path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) != 0 || (size_t) st.st_size < sizeof(TombHeader)) {
+        TRACED(close(fd));
+        return 0;
+    }
+    size_t size = (size_t) st.st_size;
+    remind_trace.allocations++;
+    char *buf = malloc(size);
+    if (!buf) {
+        perror("malloc");
+        TRACED(close(fd));
+        return -1;
+    }
+    ssize_t n = TRACED(read(fd, buf, size));
+    TRACED(close(fd));
+    if (n > 0) remind_trace.bytes_read += (uint64_t) n;
+
+    TombHeader header;
+    memcpy(&header, buf, sizeof(header));
+    if (n != (ssize_t) size || !header_matches(&header, before)) {
+        free(buf);
+        return 0;
+    }
+    header.ino = (uint64_t) after->st_ino;
+    header.dev = (uint64_t) after->st_dev;
+    memcpy(buf, &header, sizeof(header));
+
+    size_t count = (size - sizeof(header)) / sizeof(TombRecord);
+    for (size_t i = 0; i < count; i++) {
+        TombRecord record;
+        char *at = buf + sizeof(header) + i * sizeof(record);
+        memcpy(&record, at, sizeof(record));
+        if (record.offset < from) continue;
+        record.offset = (uint64_t) ((int64_t) record.offset + delta);
+        memcpy(at, &record, sizeof(record));
+    }
+
+    struct iovec part = { buf, sizeof(header) + count * sizeof(TombRecord) };
+    int rc = remind_replace_file(tomb_path, &part, 1, true);
+    free(buf);
+    return rc;
+}
+
+/// Rewrites the list without its dead lines and drops the tombstones. The
+/// caller holds the exclusive lock and has the list mapped with them loaded.
+/// The rename comes first: should we stop before the unlink, the leftover
+/// records name the old inode and are ignored.
+int remind_compact_locked(const char *file_path, const RemindList *list) {
+    char tomb_path[PATH_MAX];
+    if (!remind_sidecar_path(tomb_path, sizeof(tomb_path), file_path, ".tomb")) return -1;
+
+    if (list->dead_count > 0) {
+        remind_trace.allocations++;
+        struct iovec *kept = malloc((list->dead_count + 1) * sizeof(*kept));
+        if (!kept) {
+            perror("malloc");
+            return -1;
+        }
+        int kept_count = 0;
+        size_t keep_from = 0;
+        const char *end = list->data + list->size;
+        for (size_t i = 0; i < list->dead_count; i++) {
+            const char *p = list->data + list->dead[i];
+            const char *nl = memchr(p, '\n', end - p);
+            if (list->dead[i] > keep_from) {
+                kept[kept_count++] = (struct iovec) { (char *) list->data + keep_from, list->dead[i] - keep_from };
+            }
+            keep_from = (nl ? nl + 1 : end) - list->data;
+        }
+        if (keep_from < list->size) {
+            kept[kept_count++] = (struct iovec) { (char *) list->data + keep_from, list->size - keep_from };
+        }
+        int rc = remind_replace_file(file_path, kept, kept_count, true);
+        free(kept);
+        if (rc != 0) return -1;
+    }
+    if (TRACED(unlink(tomb_path)) != 0 && errno != ENOENT) {
+        perror(tomb_path);
+    }
+    return 0;
+}
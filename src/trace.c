@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "remind.h"
+
+/*
+ * REMIND_TRACE support. The counters are bumped unconditionally (one
+ * increment next to a syscall is nothing); clock reads and the report only
+ * happen when tracing was switched on by remind_trace_init().
+ */
+
+bool remind_trace_on = false;
+RemindTrace remind_trace;
+
+static FILE *trace_out;
+static const char *phase_names[TRACE_PHASE_COUNT] = {
+    "args", "dir", "open", "read", "render", "write",
+};
+
+/// Monotonic clock in nanoseconds, for phase timings
+static uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/// Enables tracing when REMIND_TRACE is set. "1" (or any value that does not
+/// look like a path) reports to stderr; a path appends one line per run to
+/// that file so reports from many shells can be collected together.
+void remind_trace_init(void) {
+    const char *target = getenv("REMIND_TRACE");
+    if (!target || !*target || strcmp(target, "0") == 0) {
+        return;
+    }
+    trace_out = stderr;
+    if (strchr(target, '/')) {
+        trace_out = fopen(target, "a");
+        if (!trace_out) {
+            perror(target);
+            trace_out = stderr;
+        }
+    }
+    remind_trace_on = true;
+    remind_trace.start_ns = trace_now_ns();
+}
+
+void remind_trace_begin(TracePhase phase) {
+    remind_trace.phase_start_ns[phase] = trace_now_ns();
+}
+
+void remind_trace_end(TracePhase phase) {
+    remind_trace.phase_ns[phase] += trace_now_ns() - remind_trace.phase_start_ns[phase];
+}
+
+/// Prints the compact one-line report and stops tracing
+void remind_trace_report(void) {
+    if (!remind_trace_on) {
+        return;
+    }
+    remind_trace_on = false;
+
+    char line[512];
+    int len = snprintf(line, sizeof(line), "remind trace: total=%.1fus",
+                       (trace_now_ns() - remind_trace.start_ns) / 1000.0);
+    for (int i = 0; i < TRACE_PHASE_COUNT && len < (int) sizeof(line); i++) {
+        len += snprintf(line + len, sizeof(line) - len, " %s=%.1fus",
+                        phase_names[i], remind_trace.phase_ns[i] / 1000.0);
+    }
+    if (len < (int) sizeof(line)) {
+        snprintf(line + len, sizeof(line) - len,
+                 " bytes_read=%llu bytes_written=%llu allocs=%llu syscalls=%llu",
+                 (unsigned long long) remind_trace.bytes_read,
+                 (unsigned long long) remind_trace.bytes_written,
+                 (unsigned long long) remind_trace.allocations,
+                 (unsigned long long) remind_trace.syscalls);
+    }
+    fprintf(trace_out, "%s\n", line);
+    if (trace_out != stderr) {
+        fclose(trace_out);
+    }
+}
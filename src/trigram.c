@@ -0,0 +1,736 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "remind.h"
+
+/*
+ * reminders.trigrams maps every three-byte sequence (ASCII case folded) to
+ * the lines that contain it, so `remind -s` can look up the few lines that
+ * might match a literal instead of scanning the whole list. Candidates are
+ * still confirmed against the line itself, which keeps hash-free trigrams,
+ * case folding and stale slots from ever producing a wrong answer.
+ *
+ * Lines are identified by slot: the physical line number they had when
+ * they were indexed. Slots are grouped into segments of up to
+ * TRIGRAM_SEGMENT_LINES, each a sorted term table followed by
+ * delta-encoded posting lists. Appends write a new segment at the end of
+ * the file, merging it with the newest ones while they are no bigger (a
+ * binary counter, so each line is rewritten O(log n) times), and then the
+ * header that makes it visible. Plain deletes only add the deleted slots
+ * to a sorted "removed" list; tombstone deletes do not move lines at all.
+ * Once the file is mostly segments nothing points to any more it is
+ * rewritten without them.
+ *
+ * The index is optional. It is built by -s when REMIND_TRIGRAMS is set,
+ * kept up to date by adds and deletes once it exists, and ignored (the
+ * search scans) whenever its FileStamp does not match the list.
+ */
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    FileStamp source;
+    uint64_t last_segment;  // offset of the newest segment, 0 for none
+    uint64_t removed_at;    // offset of removed_count sorted uint32 slots
+    uint64_t live_bytes;    // bytes of reachable segments and removed list
+    uint32_t slots;         // slots handed out, 1-based
+    uint32_t removed_count;
+} TrigramHeader;
+
+typedef struct {
+    uint64_t prev;          // offset of the next older segment, 0 for none
+    uint32_t first_slot;
+    uint32_t lines;
+    uint32_t terms;
+    uint32_t postings_size;
+} TrigramSegment;
+
+typedef struct {
+    uint32_t trigram;
+    uint32_t count;
+    uint32_t offset;        // into the segment's postings
+} TrigramTerm;
+
+#define TRIGRAM_MAGIC "RMDTRIGR"
+#define TRIGRAM_VERSION 1
+#define SLOT_BITS 14
+#define SLOT_MASK ((1u << SLOT_BITS) - 1)
+/// Patterns are looked up by at most this many of their trigrams
+#define QUERY_TRIGRAMS 16
+
+_Static_assert(TRIGRAM_SEGMENT_LINES <= (1 << SLOT_BITS), "segment slots must fit in a key");
+
+/// Keys are (trigram << SLOT_BITS | slot within the segment)
+typedef struct {
+    uint64_t *keys;
+    size_t count;
+    size_t cap;
+} KeyArray;
+
+/// True when REMIND_TRIGRAMS asks -s to build the index
+bool remind_trigrams_wanted(void) {
+    const char *v = getenv("REMIND_TRIGRAMS");
+    return v && *v && strcmp(v, "0") != 0;
+}
+
+static bool trigram_path(char *out, size_t out_size, const char *file_path) {
+    return remind_sidecar_path(out, out_size, file_path, ".trigrams");
+}
+
+/// The same ASCII-only folding as search.c
+static inline uint32_t fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? (uint32_t) (c + 'a' - 'A') : c;
+}
+
+static bool keys_add_line(KeyArray *a, const char *text, size_t len, uint32_t local) {
+    if (len < 3) return true;
+    if (a->count + len > a->cap) {
+        size_t cap = a->cap ? a->cap : 4096;
+        while (cap < a->count + len) cap *= 2;
+        remind_trace.allocations++;
+        uint64_t *grown = realloc(a->keys, cap * sizeof(*grown));
+        if (!grown) {
+            perror("realloc");
+            return false;
+        }
+        a->keys = grown;
+        a->cap = cap;
+    }
+    uint32_t trigram = fold((unsigned char) text[0]) << 8 | fold((unsigned char) text[1]);
+    for (size_t i = 2; i < len; i++) {
+        trigram = (trigram << 8 | fold((unsigned char) text[i])) & 0xffffff;
+        a->keys[a->count++] = (uint64_t) trigram << SLOT_BITS | local;
+    }
+    return true;
+}
+
+/// LSD radix sort of 24 + SLOT_BITS bit keys, three passes of 13 bits
+static bool keys_sort(KeyArray *a) {
+    remind_trace.allocations++;
+    uint64_t *tmp = malloc((a->count ? a->count : 1) * sizeof(*tmp));
+    if (!tmp) {
+        perror("malloc");
+        return false;
+    }
+    uint64_t *from = a->keys, *to = tmp;
+    for (int shift = 0; shift < 24 + SLOT_BITS; shift += 13) {
+        static size_t counts[1 << 13];
+        memset(counts, 0, sizeof(counts));
+        for (size_t i = 0; i < a->count; i++) counts[(from[i] >> shift) & 0x1fff]++;
+        size_t sum = 0;
+        for (size_t i = 0; i < (1 << 13); i++) {
+            size_t c = counts[i];
+            counts[i] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < a->count; i++) to[counts[(from[i] >> shift) & 0x1fff]++] = from[i];
+        uint64_t *swap = from;
+        from = to;
+        to = swap;
+    }
+    if (from != a->keys) {
+        memcpy(a->keys, from, a->count * sizeof(*from));
+    }
+    free(tmp);
+    return true;
+}
+
+static void put_varint(Output *out, uint32_t v) {
+    char bytes[5];
+    int n = 0;
+    while (v >= 0x80) {
+        bytes[n++] = (char) (v | 0x80);
+        v >>= 7;
+    }
+    bytes[n++] = (char) v;
+    output_append(out, bytes, n);
+}
+
+static const unsigned char *get_varint(const unsigned char *p, uint32_t *v) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        value |= (uint32_t) (*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) break;
+    }
+    *v = value;
+    return p;
+}
+
+/// Appends a segment for the keys (sorted here) to out, padded to 8 bytes
+static bool segment_encode(Output *out, uint64_t prev, uint32_t first_slot, uint32_t lines, KeyArray *keys) {
+    if (!keys_sort(keys)) return false;
+    Output terms = { .fd = -1 };
+    Output postings = { .fd = -1 };
+    for (size_t i = 0; i < keys->count; ) {
+        uint32_t trigram = (uint32_t) (keys->keys[i] >> SLOT_BITS);
+        TrigramTerm term = { .trigram = trigram, .offset = (uint32_t) postings.len };
+        uint32_t last = 0;
+        for (; i < keys->count && (uint32_t) (keys->keys[i] >> SLOT_BITS) == trigram; i++) {
+            uint32_t local = (uint32_t) (keys->keys[i] & SLOT_MASK);
+            if (term.count > 0 && local == last) continue;
+            put_varint(&postings, term.count > 0 ? local - last : local);
+            last = local;
+            term.count++;
+        }
+        output_append(&terms, (const char *) &term, sizeof(term));
+    }
+    TrigramSegment segment = {
+        .prev = prev,
+        .first_slot = first_slot,
+        .lines = lines,
+        .terms = (uint32_t) (terms.len / sizeof(TrigramTerm)),
+        .postings_size = (uint32_t) postings.len,
+    };
+    output_append(out, (const char *) &segment, sizeof(segment));
+    output_append(out, terms.data, terms.len);
+    output_append(out, postings.data, postings.len);
+    output_repeat(out, '\0', (int) ((8 - out->len % 8) % 8));
+    output_free(&terms);
+    output_free(&postings);
+    return true;
+}
+
+static size_t segment_size(const TrigramSegment *segment) {
+    size_t size = sizeof(*segment) + segment->terms * sizeof(TrigramTerm) + segment->postings_size;
+    return (size + 7) & ~(size_t) 7;
+}
+
+static const TrigramTerm *segment_terms(const TrigramSegment *segment) {
+    return (const TrigramTerm *) (segment + 1);
+}
+
+static const unsigned char *segment_postings(const TrigramSegment *segment) {
+    return (const unsigned char *) (segment_terms(segment) + segment->terms);
+}
+
+/// Adds a segment's keys back to keys, with slots moved up by shift
+static bool segment_decode(const TrigramSegment *segment, KeyArray *keys, uint32_t shift) {
+    const TrigramTerm *terms = segment_terms(segment);
+    size_t total = 0;
+    for (uint32_t t = 0; t < segment->terms; t++) total += terms[t].count;
+    if (keys->count + total > keys->cap) {
+        remind_trace.allocations++;
+        uint64_t *grown = realloc(keys->keys, (keys->count + total) * sizeof(*grown));
+        if (!grown) {
+            perror("realloc");
+            return false;
+        }
+        keys->keys = grown;
+        keys->cap = keys->count + total;
+    }
+    for (uint32_t t = 0; t < segment->terms; t++) {
+        const unsigned char *p = segment_postings(segment) + terms[t].offset;
+        uint32_t local = 0;
+        for (uint32_t c = 0; c < terms[t].count; c++) {
+            uint32_t v;
+            p = get_varint(p, &v);
+            local = c ? local + v : v;
+            keys->keys[keys->count++] = (uint64_t) terms[t].trigram << SLOT_BITS | (local + shift);
+        }
+    }
+    return true;
+}
+
+/// A mapped index, checked from the header through every segment, so the
+/// readers below never leave the mapping
+typedef struct {
+    const char *data;
+    size_t size;
+    TrigramHeader header;
+    uint64_t *segments;     // offsets, oldest first
+    size_t segment_count;
+    const uint32_t *removed;
+} TrigramMap;
+
+static void map_close(TrigramMap *map) {
+    if (map->data) TRACED(munmap((void *) map->data, map->size));
+    free(map->segments);
+    memset(map, 0, sizeof(*map));
+}
+
+static bool map_check(TrigramMap *map) {
+    if (map->size < sizeof(TrigramHeader)) return false;
+    memcpy(&map->header, map->data, sizeof(map->header));
+    const TrigramHeader *h = &map->header;
+    if (memcmp(h->magic, TRIGRAM_MAGIC, sizeof(h->magic)) != 0 || h->version != TRIGRAM_VERSION ||
+        h->header_size != sizeof(*h) || h->removed_at % 4 != 0 ||
+        h->removed_at + (uint64_t) h->removed_count * sizeof(uint32_t) > map->size) {
+        return false;
+    }
+    map->removed = (const uint32_t *) (map->data + h->removed_at);
+
+    // Walk newest to oldest, then flip
+    size_t cap = 0;
+    for (uint64_t at = h->last_segment; at != 0; ) {
+        if (at % 8 != 0 || at < sizeof(*h) || at + sizeof(TrigramSegment) > map->size) return false;
+        const TrigramSegment *segment = (const TrigramSegment *) (map->data + at);
+        if (at + segment_size(segment) > map->size || segment->prev >= at ||
+            segment->lines > TRIGRAM_SEGMENT_LINES) {
+            return false;
+        }
+        if (map->segment_count == cap) {
+            cap = cap ? cap * 2 : 64;
+            remind_trace.allocations++;
+            uint64_t *grown = realloc(map->segments, cap * sizeof(*grown));
+            if (!grown) return false;
+            map->segments = grown;
+        }
+        map->segments[map->segment_count++] = at;
+        at = segment->prev;
+    }
+    for (size_t i = 0; i < map->segment_count / 2; i++) {
+        uint64_t swap = map->segments[i];
+        map->segments[i] = map->segments[map->segment_count - 1 - i];
+        map->segments[map->segment_count - 1 - i] = swap;
+    }
+    return true;
+}
+
+/// Maps the index if it describes the list as identified by st
+static bool map_open(TrigramMap *map, const char *file_path, const struct stat *st) {
+    memset(map, 0, sizeof(*map));
+    char path[PATH_MAX];
+    if (!trigram_path(path, sizeof(path), file_path)) return false;
+    int fd = TRACED(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd < 0) return false;
+    struct stat index_st;
+    if (TRACED(fstat(fd, &index_st)) != 0 || index_st.st_size == 0) {
+        TRACED(close(fd));
+        return false;
+    }
+    map->size = (size_t) index_st.st_size;
+    void *data = TRACED(mmap(NULL, map->size, PROT_READ, MAP_SHARED, fd, 0));
+    TRACED(close(fd));
+    if (data == MAP_FAILED) return false;
+    map->data = data;
+
+    FileStamp stamp = file_stamp(st);
+    if (!map_check(map) || !file_stamp_equal(&map->header.source, &stamp)) {
+        map_close(map);
+        return false;
+    }
+    return true;
+}
+
+/// Indexes every physical line of a mapped list, tombstoned or not, unless
+/// it changed too recently to be told apart from its next version (see
+/// file_stamp_settled())
+static int trigrams_build(const RemindList *list, const char *file_path) {
+    if (!file_stamp_settled(&list->st)) return -1;
+    char path[PATH_MAX];
+    if (!trigram_path(path, sizeof(path), file_path)) return -1;
+
+    TrigramHeader header = {
+        .version = TRIGRAM_VERSION,
+        .header_size = sizeof(header),
+        .source = file_stamp(&list->st),
+    };
+    memcpy(header.magic, TRIGRAM_MAGIC, sizeof(header.magic));
+    Output out = { .fd = -1 };
+    output_append(&out, (const char *) &header, sizeof(header));
+
+    KeyArray keys = {0};
+    uint32_t lines = 0;
+    bool ok = true;
+    const char *data = list->data, *end = list->data + list->size;
+    for (const char *p = data; p < end && ok; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *line_end = nl ? nl : end;
+        ok = keys_add_line(&keys, p, line_end - p, lines);
+        lines++;
+        p = line_end + 1;
+        if (ok && (lines == TRIGRAM_SEGMENT_LINES || p >= end)) {
+            uint64_t at = out.len;
+            ok = segment_encode(&out, header.last_segment, header.slots + 1, lines, &keys);
+            header.last_segment = at;
+            header.slots += lines;
+            lines = 0;
+            keys.count = 0;
+        }
+    }
+    free(keys.keys);
+
+    int rc = -1;
+    if (ok) {
+        header.removed_at = out.len;
+        header.live_bytes = out.len - sizeof(header);
+        memcpy(out.data, &header, sizeof(header));
+        struct iovec parts[] = { { out.data, out.len } };
+        rc = remind_replace_file(path, parts, 1, false);
+    }
+    output_free(&out);
+    return rc;
+}
+
+static const TrigramTerm *find_term(const TrigramSegment *segment, uint32_t trigram) {
+    const TrigramTerm *terms = segment_terms(segment);
+    size_t low = 0, high = segment->terms;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (terms[mid].trigram < trigram) low = mid + 1;
+        else high = mid;
+    }
+    return low < segment->terms && terms[low].trigram == trigram ? &terms[low] : NULL;
+}
+
+/// Decodes a posting list to segment-local slots
+static size_t term_slots(const TrigramSegment *segment, const TrigramTerm *term, uint32_t *out) {
+    const unsigned char *p = segment_postings(segment) + term->offset;
+    uint32_t local = 0;
+    for (uint32_t c = 0; c < term->count; c++) {
+        uint32_t v;
+        p = get_varint(p, &v);
+        local = c ? local + v : v;
+        out[c] = local;
+    }
+    return term->count;
+}
+
+/// Keeps the slots of `slots` that are also in other; both sorted
+static size_t intersect(uint32_t *slots, size_t count, const uint32_t *other, size_t other_count) {
+    size_t kept = 0, j = 0;
+    for (size_t i = 0; i < count; i++) {
+        while (j < other_count && other[j] < slots[i]) j++;
+        if (j < other_count && other[j] == slots[i]) slots[kept++] = slots[i];
+    }
+    return kept;
+}
+
+/// Answers a search from the index: the live lines that match, in order,
+/// in a malloc'd array. Returns -1 when the index cannot answer (regex or
+/// short pattern, no current index, or so many candidates that a scan is
+/// cheaper) and the caller should scan instead.
+long remind_trigrams_search(const RemindList *list, const char *file_path, const RemindPattern *pattern,
+                            RemindLine **matches) {
+    *matches = NULL;
+    if (pattern->is_regex || pattern->len < 3 || !list->data || list->copied ||
+        memchr(pattern->text, '\n', pattern->len)) {
+        return -1;
+    }
+    TrigramMap map;
+    if (!map_open(&map, file_path, &list->st)) {
+        if (!remind_trigrams_wanted() || trigrams_build(list, file_path) != 0 ||
+            !map_open(&map, file_path, &list->st)) {
+            return -1;
+        }
+    }
+
+    uint32_t grams[QUERY_TRIGRAMS];
+    int gram_count = 0;
+    for (size_t i = 0; i + 2 < pattern->len && gram_count < QUERY_TRIGRAMS; i++) {
+        uint32_t gram = fold((unsigned char) pattern->text[i]) << 16 |
+                        fold((unsigned char) pattern->text[i + 1]) << 8 |
+                        fold((unsigned char) pattern->text[i + 2]);
+        bool seen = false;
+        for (int g = 0; g < gram_count && !seen; g++) seen = grams[g] == gram;
+        if (!seen) grams[gram_count++] = gram;
+    }
+
+    // Rarest term per segment; past a sixteenth of the list, scanning wins
+    uint64_t budget = map.header.slots / 16 + 64, candidates = 0;
+    for (size_t s = 0; s < map.segment_count && candidates <= budget; s++) {
+        const TrigramSegment *segment = (const TrigramSegment *) (map.data + map.segments[s]);
+        uint32_t rarest = UINT32_MAX;
+        for (int g = 0; g < gram_count; g++) {
+            const TrigramTerm *term = find_term(segment, grams[g]);
+            uint32_t count = term ? term->count : 0;
+            if (count < rarest) rarest = count;
+        }
+        candidates += rarest;
+    }
+    if (candidates > budget) {
+        map_close(&map);
+        return -1;
+    }
+
+    remind_trace.allocations += 3;
+    uint32_t *slots = malloc(TRIGRAM_SEGMENT_LINES * sizeof(*slots));
+    uint32_t *other = malloc(TRIGRAM_SEGMENT_LINES * sizeof(*other));
+    RemindLine *found = malloc((candidates ? candidates : 1) * sizeof(*found));
+    if (!slots || !other || !found) {
+        perror("malloc");
+        free(slots);
+        free(other);
+        free(found);
+        map_close(&map);
+        return -1;
+    }
+
+    long count = 0;
+    LineCursor cursor = { .line = 1, .offset = 0 };
+    remind_index_map(list, file_path, &cursor.index);
+    size_t removed = 0;
+    for (size_t s = 0; s < map.segment_count; s++) {
+        const TrigramSegment *segment = (const TrigramSegment *) (map.data + map.segments[s]);
+        // Terms rarest first. Every candidate is confirmed anyway, so a
+        // term much more common than the candidates left costs more to
+        // decode than it could save.
+        const TrigramTerm *terms[QUERY_TRIGRAMS] = { 0 };
+        bool all = true;
+        for (int g = 0; g < gram_count && all; g++) {
+            const TrigramTerm *term = find_term(segment, grams[g]);
+            all = term != NULL;
+            int at = g;
+            for (; all && at > 0 && terms[at - 1]->count > term->count; at--) terms[at] = terms[at - 1];
+            terms[at] = term;
+        }
+        if (!all) continue;
+        size_t slot_count = term_slots(segment, terms[0], slots);
+        for (int g = 1; g < gram_count && slot_count > 0 && terms[g]->count <= 16 * slot_count; g++) {
+            slot_count = intersect(slots, slot_count, other, term_slots(segment, terms[g], other));
+        }
+
+        for (size_t i = 0; i < slot_count; i++) {
+            // Removed slots are gone from the list; the rest moved up past them
+            uint32_t slot = segment->first_slot + slots[i];
+            while (removed < map.header.removed_count && map.removed[removed] < slot) removed++;
+            if (removed < map.header.removed_count && map.removed[removed] == slot) continue;
+            if (!remind_cursor_seek(list, &cursor, (long) (slot - removed))) break;
+
+            const char *text = list->data + cursor.offset;
+            const char *nl = memchr(text, '\n', list->size - cursor.offset);
+            size_t len = nl ? (size_t) (nl - text) : list->size - cursor.offset;
+            size_t dead = remind_dead_before(list, cursor.offset);
+            if (dead < list->dead_count && list->dead[dead] == cursor.offset) continue;
+            if (!remind_line_matches(pattern, text, len)) continue;
+            found[count++] = (RemindLine) {
+                .text = text,
+                .len = len,
+                .number = cursor.line - (long) dead,
+                .next_dead = dead,
+            };
+        }
+    }
+    free(slots);
+    free(other);
+    remind_index_unmap(&cursor.index);
+    map_close(&map);
+    *matches = found;
+    return count;
+}
+
+/// Opens an existing index for an update and locks it against other
+/// updaters. Returns -1 unless it matches the list as it was before.
+static int open_for_update(const char *file_path, const struct stat *before, TrigramHeader *header) {
+    char path[PATH_MAX];
+    if (!trigram_path(path, sizeof(path), file_path)) return -1;
+    int fd = TRACED(open(path, O_RDWR | O_CLOEXEC));
+    if (fd < 0) return -1;
+    FileStamp stamp = file_stamp(before);
+    if (TRACED(flock(fd, LOCK_EX)) != 0 ||
+        TRACED(pread(fd, header, sizeof(*header), 0)) != (ssize_t) sizeof(*header) ||
+        memcmp(header->magic, TRIGRAM_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRIGRAM_VERSION || header->header_size != sizeof(*header) ||
+        !file_stamp_equal(&header->source, &stamp)) {
+        TRACED(close(fd));
+        return -1;
+    }
+    return fd;
+}
+
+/// Writes out at the end of the index (rounded up to 8 bytes, where the
+/// offsets in header and out already place it) and then the header that
+/// points at it. When the file has grown to more than twice what is still reachable,
+/// it is rewritten with only the live segments instead.
+static void commit_update(const char *file_path, int fd, TrigramHeader *header, Output *out) {
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) != 0) return;
+    uint64_t end = ((uint64_t) st.st_size + 7) & ~(uint64_t) 7;
+
+    if (end + out->len > 2 * (header->live_bytes + sizeof(*header)) + 64 * 1024) {
+        TrigramMap map = { .size = (size_t) end + out->len };
+        char *whole = malloc(map.size);
+        remind_trace.allocations++;
+        if (!whole) return;
+        memset(whole, 0, map.size);
+        if (TRACED(pread(fd, whole, (size_t) st.st_size, 0)) != st.st_size) {
+            free(whole);
+            return;
+        }
+        memcpy(whole, header, sizeof(*header));
+        memcpy(whole + end, out->data, out->len);
+        map.data = whole;
+
+        // Copy the reachable segments, oldest first, relinked
+        Output compact = { .fd = -1 };
+        TrigramHeader fresh = *header;
+        fresh.last_segment = 0;
+        output_append(&compact, (const char *) &fresh, sizeof(fresh));
+        bool ok = map_check(&map);
+        for (size_t s = 0; ok && s < map.segment_count; s++) {
+            TrigramSegment segment;
+            memcpy(&segment, whole + map.segments[s], sizeof(segment));
+            size_t size = segment_size(&segment);
+            segment.prev = fresh.last_segment;
+            fresh.last_segment = compact.len;
+            output_append(&compact, (const char *) &segment, sizeof(segment));
+            output_append(&compact, whole + map.segments[s] + sizeof(segment), size - sizeof(segment));
+        }
+        fresh.removed_at = compact.len;
+        output_append(&compact, (const char *) map.removed, header->removed_count * sizeof(uint32_t));
+        fresh.live_bytes = compact.len - sizeof(fresh);
+        memcpy(compact.data, &fresh, sizeof(fresh));
+        free(map.segments);
+        free(whole);
+
+        char path[PATH_MAX];
+        if (ok && trigram_path(path, sizeof(path), file_path)) {
+            struct iovec parts[] = { { compact.data, compact.len } };
+            remind_replace_file(path, parts, 1, false);
+        }
+        output_free(&compact);
+        return;
+    }
+
+    char pad[8] = {0};
+    size_t pad_len = (size_t) (end - (uint64_t) st.st_size);
+    if ((pad_len == 0 || TRACED(pwrite(fd, pad, pad_len, st.st_size)) == (ssize_t) pad_len) &&
+        TRACED(pwrite(fd, out->data, out->len, (off_t) end)) == (ssize_t) out->len &&
+        TRACED(pwrite(fd, header, sizeof(*header), 0)) == (ssize_t) sizeof(*header)) {
+        remind_trace.bytes_written += pad_len + out->len + sizeof(*header);
+    }
+}
+
+/// Indexes lines appended to a list that matched the index before. Their
+/// slots follow the existing ones. A newline written first to end an
+/// unterminated last line changes nothing here: that line keeps its slot.
+void remind_trigrams_append(const char *file_path, const struct stat *before, const struct stat *after,
+                            const char *data, size_t len) {
+    TrigramHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+
+    struct stat st;
+    TrigramMap map = {0};
+    if (TRACED(fstat(fd, &st)) == 0 && st.st_size > 0) {
+        map.size = (size_t) st.st_size;
+        void *mapped = TRACED(mmap(NULL, map.size, PROT_READ, MAP_SHARED, fd, 0));
+        map.data = mapped == MAP_FAILED ? NULL : mapped;
+    }
+    if (!map.data || !map_check(&map)) {
+        map_close(&map);
+        TRACED(close(fd));
+        return;
+    }
+
+    // New segments are built in out, to be written from file_end on
+    Output out = { .fd = -1 };
+    KeyArray keys = {0};
+    size_t kept_segments = map.segment_count;
+    uint64_t file_end = ((uint64_t) map.size + 7) & ~(uint64_t) 7;
+    bool ok = true;
+    const char *end = data + len;
+    for (const char *p = data; p < end && ok; ) {
+        uint32_t first_slot = header.slots + 1;
+        uint32_t lines = 0;
+        keys.count = 0;
+        while (p < end && lines < TRIGRAM_SEGMENT_LINES && ok) {
+            const char *nl = memchr(p, '\n', end - p);
+            const char *line_end = nl ? nl : end;
+            ok = keys_add_line(&keys, p, line_end - p, lines++);
+            p = line_end + 1;
+        }
+        header.slots += lines;
+
+        // Binary counter: absorb older segments no bigger than this one.
+        // Only segments already on disk are merged; ones written by this
+        // call are full.
+        while (ok && kept_segments > 0 && out.len == 0) {
+            const TrigramSegment *last = (const TrigramSegment *) (map.data + map.segments[kept_segments - 1]);
+            if (last->lines > lines || last->lines + lines > TRIGRAM_SEGMENT_LINES) break;
+            for (size_t k = 0; k < keys.count; k++) keys.keys[k] += last->lines;
+            ok = segment_decode(last, &keys, 0);
+            first_slot = last->first_slot;
+            lines += last->lines;
+            header.live_bytes -= segment_size(last);
+            header.last_segment = last->prev;
+            kept_segments--;
+        }
+        if (!ok) break;
+        uint64_t at = file_end + out.len;
+        ok = segment_encode(&out, header.last_segment, first_slot, lines, &keys);
+        header.last_segment = at;
+        header.live_bytes += out.len - (at - file_end);
+    }
+    free(keys.keys);
+    map_close(&map);
+
+    if (ok) {
+        header.source = file_stamp(after);
+        commit_update(file_path, fd, &header, &out);
+    }
+    output_free(&out);
+    TRACED(close(fd));
+}
+
+/// Records lines deleted from a plain list (numbers as -d took them; the
+/// list had no tombstones) as removed slots
+void remind_trigrams_delete(const char *file_path, const struct stat *before, const struct stat *after,
+                            const LineSet *set) {
+    TrigramHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+
+    remind_trace.allocations++;
+    uint32_t *removed = malloc((header.removed_count ? header.removed_count : 1) * sizeof(*removed));
+    size_t old_bytes = header.removed_count * sizeof(*removed);
+    if (!removed || (old_bytes > 0 &&
+                     TRACED(pread(fd, removed, old_bytes, (off_t) header.removed_at)) != (ssize_t) old_bytes)) {
+        free(removed);
+        TRACED(close(fd));
+        return;
+    }
+
+    // Merge the slots of the deleted lines into the removed list. The
+    // slot of physical line p is p plus the removed slots at or below it.
+    Output merged = { .fd = -1 };
+    long physical_lines = (long) header.slots - (long) header.removed_count;
+    size_t j = 0;
+    for (int r = 0; r < set->count; r++) {
+        long last = set->ranges[r].last < physical_lines ? set->ranges[r].last : physical_lines;
+        for (long line = set->ranges[r].first; line <= last; line++) {
+            uint32_t slot = (uint32_t) line + (uint32_t) j;
+            while (j < header.removed_count && removed[j] <= slot) {
+                output_append(&merged, (const char *) &removed[j], sizeof(*removed));
+                slot++;
+                j++;
+            }
+            output_append(&merged, (const char *) &slot, sizeof(slot));
+        }
+    }
+    output_append(&merged, (const char *) (removed + j), (header.removed_count - j) * sizeof(*removed));
+    free(removed);
+
+    header.live_bytes += merged.len - old_bytes;
+    header.removed_count = (uint32_t) (merged.len / sizeof(uint32_t));
+    header.source = file_stamp(after);
+    struct stat st;
+    if (TRACED(fstat(fd, &st)) == 0) {
+        header.removed_at = ((uint64_t) st.st_size + 7) & ~(uint64_t) 7;
+        commit_update(file_path, fd, &header, &merged);
+    }
+    output_free(&merged);
+    TRACED(close(fd));
+}
+
+/// Moves the index from before to after when only the list's stamp changed,
+/// as it does when tombstones are written
+void remind_trigrams_restamp(const char *file_path, const struct stat *before, const struct stat *after) {
+    TrigramHeader header;
+    int fd = open_for_update(file_path, before, &header);
+    if (fd < 0) return;
+    if (before->st_size == after->st_size) {
+        header.source = file_stamp(after);
+        TRACED(pwrite(fd, &header, sizeof(header), 0));
+    }
+    TRACED(close(fd));
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+
+#include "remind.h"
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+/*
+ * remind -w: keeps what -c shows on the terminal, redrawn the moment the
+ * list changes or a scheduled reminder comes due.
+ *
+ * Between changes it blocks in poll() on an inotify watch of the list's
+ * directory, with a timeout only when the due heap says something will
+ * appear or disappear, so an idle watch uses no CPU. Each change renders
+ * the list again and compares it with what is on the screen row by row:
+ * only rows that differ are rewritten, each addressed with a cursor move,
+ * and rows past the new end are cleared. The banner is part of the
+ * comparison, so it is only redrawn when its width changes with the
+ * longest line. Rows are clipped to the terminal so none of them wraps
+ * and throws the addressing off.
+ */
+
+/// One row of a rendering, as a slice of its text
+typedef struct {
+    size_t offset;
+    size_t len;
+} Row;
+
+typedef struct {
+    Output text;
+    Row *rows;
+    size_t row_count;
+    size_t row_cap;
+} Frame;
+
+static volatile sig_atomic_t stopping;
+static volatile sig_atomic_t resized;
+
+static void stop_watching(int signo) {
+    (void) signo;
+    stopping = 1;
+}
+
+static void note_resize(int signo) {
+    (void) signo;
+    resized = 1;
+}
+
+/// Splits the frame's text into rows at each newline
+static bool split_rows(Frame *frame) {
+    frame->row_count = 0;
+    const char *data = frame->text.data;
+    const char *end = data + frame->text.len;
+    for (const char *p = data; p < end; ) {
+        const char *nl = memchr(p, '\n', end - p);
+        const char *row_end = nl ? nl : end;
+        if (frame->row_count == frame->row_cap) {
+            frame->row_cap = frame->row_cap ? frame->row_cap * 2 : 64;
+            remind_trace.allocations++;
+            Row *rows = realloc(frame->rows, frame->row_cap * sizeof(*rows));
+            if (!rows) {
+                perror("realloc");
+                return false;
+            }
+            frame->rows = rows;
+        }
+        frame->rows[frame->row_count++] = (Row) { (size_t) (p - data), (size_t) (row_end - p) };
+        p = row_end + 1;
+    }
+    return true;
+}
+
+/// Renders what -c (or the window) shows now into frame
+static int render_frame(const char *file_path, const LineWindow *window, Frame *frame, int64_t *valid_until) {
+    frame->text.len = 0;
+    *valid_until = REMIND_NEVER;
+    struct stat st;
+    if (remind_list_stat(file_path, &st) == 0 && st.st_size > 0) {
+        RemindList list;
+        if (remind_list_open(&list, file_path) != 0) return -1;
+        if (list.data && window->kind == WINDOW_ALL) {
+            remind_render_due(&frame->text, &list, file_path, (int64_t) time(NULL), valid_until);
+        } else if (list.data) {
+            remind_render_window(&frame->text, &list, file_path, window);
+        }
+        remind_list_close(&list);
+    }
+    return split_rows(frame) ? 0 : -1;
+}
+
+/// Length in bytes of the first `columns` characters of a UTF-8 row
+static size_t clip_row(const char *text, size_t len, int columns) {
+    if (columns <= 0) return len;
+    int seen = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (((unsigned char) text[i] & 0xC0) != 0x80 && seen++ == columns) return i;
+    }
+    return len;
+}
+
+static bool rows_equal(const Frame *a, size_t i, const Frame *b) {
+    const Row *x = &a->rows[i], *y = &b->rows[i];
+    return x->len == y->len && memcmp(a->text.data + x->offset, b->text.data + y->offset, x->len) == 0;
+}
+
+/// Brings the screen from showing old to showing new with one write.
+/// full redraws every row, as after a resize or on the first frame.
+static void draw(int fd, const Frame *old, const Frame *new, bool full) {
+    struct winsize ws = {0};
+    ioctl(fd, TIOCGWINSZ, &ws);
+    size_t height = ws.ws_row ? ws.ws_row : SIZE_MAX;
+
+    Output out = { .fd = fd };
+    if (full) output_str(&out, "\033[H\033[2J");
+    size_t shown = new->row_count < height ? new->row_count : height;
+    for (size_t i = 0; i < shown; i++) {
+        if (!full && i < old->row_count && rows_equal(old, i, new)) continue;
+        char move[32];
+        snprintf(move, sizeof(move), "\033[%zu;1H", i + 1);
+        output_str(&out, move);
+        const char *text = new->text.data + new->rows[i].offset;
+        output_append(&out, text, clip_row(text, new->rows[i].len, ws.ws_col));
+        output_str(&out, "\033[K");
+    }
+    if (!full && shown < old->row_count) {
+        char move[32];
+        snprintf(move, sizeof(move), "\033[%zu;1H\033[J", shown + 1);
+        output_str(&out, move);
+    }
+    output_flush(&out);
+    output_free(&out);
+}
+
+#ifdef __linux__
+/// Milliseconds from now until the wall clock reaches `when`, for poll()
+static int timeout_until(int64_t when) {
+    if (when == REMIND_NEVER) return -1;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t ms = (when - (int64_t) ts.tv_sec) * 1000 - ts.tv_nsec / 1000000;
+    if (ms < 0) return 0;
+    return ms > INT_MAX ? INT_MAX : (int) ms;
+}
+
+/// Shows the list on fd until SIGINT or SIGTERM, on the terminal's
+/// alternate screen. Returns -1 when it cannot start.
+int remind_watch(const char *file_path, int fd, const LineWindow *window) {
+    ListWatch watch;
+    if (remind_watch_list(&watch, file_path) != 0) return -1;
+
+    struct sigaction stop = { .sa_handler = stop_watching };
+    struct sigaction resize = { .sa_handler = note_resize };
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    sigaction(SIGWINCH, &resize, NULL);
+
+    Frame frames[2] = { { .text = { .fd = -1 } }, { .text = { .fd = -1 } } };
+    Frame *shown = &frames[0], *next = &frames[1];
+    int64_t valid_until;
+    write_all(fd, "\033[?1049h\033[?25l", 14);
+    int rc = render_frame(file_path, window, shown, &valid_until);
+    if (rc == 0) draw(fd, next, shown, true);
+
+    while (rc == 0 && !stopping) {
+        struct pollfd pfd = { .fd = watch.fd, .events = POLLIN };
+        int ready = TRACED(poll(&pfd, 1, timeout_until(valid_until)));
+        if (ready < 0 && errno != EINTR) {
+            perror("poll");
+            rc = -1;
+            break;
+        }
+        bool full = resized;
+        resized = 0;
+        // Woken by a change, a reminder coming due, or a resize
+        bool changed = ready > 0 && remind_watch_changed(&watch);
+        if (!changed && !full && ready != 0) continue;
+
+        if (render_frame(file_path, window, next, &valid_until) != 0) {
+            rc = -1;
+            break;
+        }
+        draw(fd, shown, next, full);
+        Frame *swap = shown;
+        shown = next;
+        next = swap;
+    }
+
+    write_all(fd, "\033[?25h\033[?1049l", 14);
+    for (int i = 0; i < 2; i++) {
+        output_free(&frames[i].text);
+        free(frames[i].rows);
+    }
+    TRACED(close(watch.fd));
+    return rc;
+}
+#else
+int remind_watch(const char *file_path, int fd, const LineWindow *window) {
+    (void) file_path;
+    (void) fd;
+    (void) window;
+    fprintf(stderr, "remind -w needs inotify, which this system does not have\n");
+    return -1;
+}
+#endif
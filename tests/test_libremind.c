@@ -0,0 +1,1197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "remind.h"
+
+#define MAX_PATH_SIZE 512
+#define MAX_CMD_SIZE 1024
+
+// Colors
+#define GREEN "\033[0;32m"
+#define RED "\033[0;31m"
+#define NC "\033[0m"
+
+static int tests_passed = 0;
+static int tests_failed = 0;
+static char test_dir[MAX_PATH_SIZE];
+static char remind_file[MAX_PATH_SIZE];
+
+void pass_test(const char* test_name) {
+    printf("%s" GREEN "✓ PASS" NC "\n", test_name);
+    tests_passed++;
+}
+
+void fail_test(const char* test_name, const char* reason) {
+    printf("%s" RED "✗ FAIL: %s" NC "\n", test_name, reason);
+    tests_failed++;
+}
+
+// Replace the reminders file with exact contents
+int write_file(const char* path, const char* contents, size_t len) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+    fwrite(contents, 1, len, fp);
+    fclose(fp);
+    return 0;
+}
+
+// Read a whole file into a malloc'd, NUL-terminated buffer
+char* read_file(const char* path, size_t* len) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char* buf = malloc(size + 1);
+    *len = fread(buf, 1, size, fp);
+    buf[*len] = '\0';
+    fclose(fp);
+    return buf;
+}
+
+double now_ms() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// Test 1: Line selections parse into sorted, merged ranges
+void test_line_set_parse() {
+    printf("Test 1: Line selection parsing\n");
+
+    struct {
+        const char* spec;
+        const char* expected;   // "first-last ..." or NULL when invalid
+    } cases[] = {
+        { "3", "3-3" },
+        { "7-20", "7-20" },
+        { "1,4,7-20", "1-1 4-4 7-20" },
+        { "9,2-3,1", "1-3 9-9" },
+        { "5-8,6-10,11", "5-11" },
+        { "2,2,2", "2-2" },
+        { "0", NULL },
+        { "-1", NULL },
+        { "3-1", NULL },
+        { "1,", NULL },
+        { ",1", NULL },
+        { "1-", NULL },
+        { "a", NULL },
+        { "1;2", NULL },
+        { "", "" },
+    };
+
+    int ok = 1;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        LineSet set = {0};
+        bool parsed = line_set_parse(&set, cases[i].spec);
+        char got[256] = "";
+        for (int r = 0; r < set.count; r++) {
+            char part[64];
+            snprintf(part, sizeof(part), "%s%ld-%ld", r ? " " : "", set.ranges[r].first, set.ranges[r].last);
+            strcat(got, part);
+        }
+        if (cases[i].expected == NULL ? parsed : (!parsed || strcmp(got, cases[i].expected) != 0)) {
+            printf("  \"%s\" gave %s\n", cases[i].spec, parsed ? got : "an error");
+            ok = 0;
+        }
+        line_set_free(&set);
+    }
+
+    if (ok) {
+        pass_test("");
+    } else {
+        fail_test("", "Selections should parse, sort and merge correctly");
+    }
+}
+
+// Test 2: Iteration, counting and line lookup agree with each other
+void test_iterate_count_find() {
+    printf("Test 2: Iterate, count and find lines\n");
+
+    const char contents[] = "one\n\nthree\nlast without newline";
+    write_file(remind_file, contents, sizeof(contents) - 1);
+
+    RemindList list;
+    int ok = remind_list_open(&list, remind_file) == 0;
+    const char* expected[] = { "one", "", "three", "last without newline" };
+    RemindLine line = {0};
+    long n = 0;
+    while (ok && remind_next_line(&list, &line)) {
+        ok = n < 4 && line.number == n + 1 &&
+             line.len == strlen(expected[n]) &&
+             memcmp(line.text, expected[n], line.len) == 0;
+
+        size_t start, end;
+        ok = ok && remind_find_line(list.data, list.size, line.number, &start, &end) &&
+             list.data + start == line.text;
+        n++;
+    }
+    ok = ok && n == 4 && remind_count_lines(list.data, list.size) == 4;
+    remind_list_close(&list);
+
+    if (ok) {
+        pass_test("");
+    } else {
+        fail_test("", "Every line, blank or unterminated, should be numbered once");
+    }
+}
+
+// Test 3: Rendering produces the banner and numbered lines
+void test_render() {
+    printf("Test 3: Render banner and list\n");
+
+    const char contents[] = "Buy groceries\nCall mom\n";
+    Output out = { .fd = -1 };
+    remind_render(&out, contents, sizeof(contents) - 1);
+
+    const char expected[] =
+        "#################\n"
+        "#   Reminders   #\n"
+        "#################\n"
+        "1. Buy groceries\n"
+        "2. Call mom\n"
+        "\n";
+    if (out.len == sizeof(expected) - 1 && memcmp(out.data, expected, out.len) == 0) {
+        pass_test("");
+    } else {
+        fail_test("", "Rendering should match the classic -c output byte for byte");
+    }
+    output_free(&out);
+}
+
+// Test 4: Appends fold line breaks and repair a missing final newline
+void test_append() {
+    printf("Test 4: Append formatting\n");
+
+    write_file(remind_file, "hand edited", 11);
+    remind_add(remind_file, "two\nlines");
+
+    Output batch = { .fd = -1 };
+    const char input[] = "a\r\n\n   \nb";
+    remind_format_lines(&batch, input, sizeof(input) - 1);
+    remind_append(remind_file, batch.data, batch.len);
+    output_free(&batch);
+
+    size_t len;
+    char* contents = read_file(remind_file, &len);
+    if (contents && strcmp(contents, "hand edited\ntwo lines\na\nb\n") == 0) {
+        pass_test("");
+    } else {
+        fail_test("", "Appends should produce exactly one line per reminder");
+    }
+    free(contents);
+}
+
+/* Reference model for deletes: keep every line whose number is not in the
+ * set. Slow and obvious on purpose.
+ */
+size_t model_delete(const char* in, size_t len, const LineSet* set, char* out) {
+    size_t out_len = 0;
+    long lineno = 1;
+    for (size_t i = 0; i < len; ) {
+        size_t end = i;
+        while (end < len && in[end] != '\n') end++;
+        if (end < len) end++;
+
+        int deleted = 0;
+        for (int r = 0; r < set->count; r++) {
+            if (lineno >= set->ranges[r].first && lineno <= set->ranges[r].last) deleted = 1;
+        }
+        if (!deleted) {
+            memcpy(out + out_len, in + i, end - i);
+            out_len += end - i;
+        }
+        i = end;
+        lineno++;
+    }
+    return out_len;
+}
+
+// Test 5: Randomised deletes match the reference model in both write modes
+void test_delete_matches_model() {
+    printf("Test 5: Randomised deletes against a reference model\n");
+
+    const int rounds = 2000;
+    char contents[2048];
+    char expected[2048];
+    unsigned int seed = 12345;
+    int ok = 1;
+    double start = now_ms();
+
+    // Out-of-range numbers are expected here; keep their warnings quiet
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+
+    for (int round = 0; round < rounds && ok; round++) {
+        // Random list of short lines, some blank, sometimes unterminated
+        size_t len = 0;
+        int lines = rand_r(&seed) % 30;
+        for (int i = 0; i < lines; i++) {
+            int width = rand_r(&seed) % 4 == 0 ? 0 : 1 + rand_r(&seed) % 12;
+            for (int j = 0; j < width; j++) contents[len++] = 'a' + rand_r(&seed) % 26;
+            if (i < lines - 1 || rand_r(&seed) % 3) contents[len++] = '\n';
+        }
+        write_file(remind_file, contents, len);
+
+        LineSet set = {0};
+        char spec[128] = "";
+        int parts = 1 + rand_r(&seed) % 4;
+        for (int i = 0; i < parts; i++) {
+            char part[32];
+            long first = 1 + rand_r(&seed) % (lines + 3);
+            long last = rand_r(&seed) % 2 ? first : first + rand_r(&seed) % 5;
+            snprintf(part, sizeof(part), i ? ",%ld-%ld" : "%ld-%ld", first, last);
+            strcat(spec, part);
+        }
+        line_set_parse(&set, spec);
+
+        if (round % 2) setenv("REMIND_SAFE_WRITES", "1", 1);
+        else unsetenv("REMIND_SAFE_WRITES");
+
+        size_t expected_len = model_delete(contents, len, &set, expected);
+        remind_delete(remind_file, &set);
+
+        size_t got_len;
+        char* got = read_file(remind_file, &got_len);
+        ok = got && got_len == expected_len && memcmp(got, expected, got_len) == 0;
+        if (!ok) {
+            printf("  round %d: deleting %s gave a different list\n", round, spec);
+        }
+        free(got);
+        line_set_free(&set);
+    }
+
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    unsetenv("REMIND_SAFE_WRITES");
+    printf("  %d rounds in %.1f ms\n", rounds, now_ms() - start);
+
+    if (ok) {
+        pass_test("");
+    } else {
+        fail_test("", "remind_delete should remove exactly the selected lines");
+    }
+}
+
+// Rebuild the bytes a list shows, with tombstoned lines left out
+size_t live_view(const char* path, char* out) {
+    RemindList list;
+    size_t len = 0;
+    if (remind_list_open(&list, path) != 0) return 0;
+    RemindLine line = {0};
+    while (remind_next_line(&list, &line)) {
+        memcpy(out + len, line.text, line.len);
+        len += line.len;
+        if (line.text + line.len < list.data + list.size) out[len++] = '\n';
+    }
+    remind_list_close(&list);
+    return len;
+}
+
+// Test 6: Tombstone deletes show the same list as real ones, and compact to it
+void test_log_storage_matches_model() {
+    printf("Test 6: Tombstone deletes against a reference model\n");
+
+    const int rounds = 600;
+    char model[4096];
+    char next[4096];
+    char got[4096];
+    size_t model_len = 0;
+    unsigned int seed = 777;
+    int ok = 1;
+
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+    setenv("REMIND_STORAGE", "log", 1);
+
+    for (int round = 0; round < rounds && ok; round++) {
+        // A fresh list every so often; in between tombstones pile up
+        if (round % 12 == 0) {
+            char tomb_file[MAX_PATH_SIZE];
+            snprintf(tomb_file, sizeof(tomb_file), "%s.tomb", remind_file);
+            unlink(tomb_file);
+            model_len = 0;
+            int lines = 1 + rand_r(&seed) % 60;
+            for (int i = 0; i < lines; i++) {
+                int width = rand_r(&seed) % 5 == 0 ? 0 : 1 + rand_r(&seed) % 3;
+                for (int j = 0; j < width; j++) model[model_len++] = 'a' + rand_r(&seed) % 3;
+                if (i < lines - 1 || rand_r(&seed) % 3) model[model_len++] = '\n';
+            }
+            write_file(remind_file, model, model_len);
+        }
+
+        LineSet set = {0};
+        char spec[64];
+        long first = 1 + rand_r(&seed) % 20;
+        snprintf(spec, sizeof(spec), "%ld-%ld", first, first + rand_r(&seed) % 3);
+        line_set_parse(&set, spec);
+
+        size_t next_len = model_delete(model, model_len, &set, next);
+        memcpy(model, next, next_len);
+        model_len = next_len;
+        remind_delete(remind_file, &set);
+        line_set_free(&set);
+
+        size_t got_len = live_view(remind_file, got);
+        ok = got_len == model_len && memcmp(got, model, got_len) == 0 &&
+             remind_count(remind_file) == remind_count_lines(model, model_len);
+
+        // Rendering must not depend on whether dead lines are still on disk
+        Output expected = { .fd = -1 }, shown = { .fd = -1 };
+        remind_render(&expected, model, model_len);
+        RemindList list;
+        if (ok && remind_list_open(&list, remind_file) == 0) {
+            remind_render_list(&shown, &list);
+            remind_list_close(&list);
+            ok = shown.len == expected.len && memcmp(shown.data, expected.data, shown.len) == 0;
+        }
+        output_free(&expected);
+        output_free(&shown);
+        if (!ok) {
+            printf("  round %d: deleting %s showed a different list\n", round, spec);
+        }
+    }
+
+    // Compaction leaves exactly the live lines on disk
+    remind_compact(remind_file);
+    size_t raw_len;
+    char* raw = read_file(remind_file, &raw_len);
+    int compacted = raw && raw_len == model_len && memcmp(raw, model, raw_len) == 0;
+    free(raw);
+
+    unsetenv("REMIND_STORAGE");
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+
+    if (ok && compacted) {
+        pass_test("");
+    } else {
+        fail_test("", "Tombstoned lines should vanish from every view and from disk on compaction");
+    }
+}
+
+// Test 7: Chunked storage shows the same list as a plain file through
+// appends and deletes, and joins back into it
+void test_chunked_storage_matches_model() {
+    printf("Test 7: Chunked storage against a reference model\n");
+
+    // Enough lines for several chunks
+    const int lines = 12000;
+    size_t cap = (size_t) lines * 32 + 4096;
+    char* model = malloc(cap);
+    char* next = malloc(cap);
+    char* got = malloc(cap);
+    size_t model_len = 0;
+    for (int i = 0; i < lines; i++) {
+        model_len += snprintf(model + model_len, cap - model_len, "reminder %d\n", i);
+    }
+    write_file(remind_file, model, model_len);
+
+    fflush(stderr);
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    close(null_fd);
+    setenv("REMIND_STORAGE", "chunked", 1);
+
+    unsigned int seed = 4242;
+    int ok = 1;
+    for (int round = 0; round < 150 && ok; round++) {
+        if (round % 10 == 5) {
+            // Appends top up the last chunk and spill into new ones
+            char text[32];
+            snprintf(text, sizeof(text), "added %d", round);
+            remind_add(remind_file, text);
+            model_len += snprintf(model + model_len, cap - model_len, "%s\n", text);
+        } else {
+            long count = (long) remind_count_lines(model, model_len);
+            long first = 1 + rand_r(&seed) % (count + 2);
+            char spec[64];
+            snprintf(spec, sizeof(spec), "%ld-%ld", first, first + rand_r(&seed) % 400);
+            LineSet set = {0};
+            line_set_parse(&set, spec);
+            size_t next_len = model_delete(model, model_len, &set, next);
+            memcpy(model, next, next_len);
+            model_len = next_len;
+            remind_delete(remind_file, &set);
+            line_set_free(&set);
+        }
+
+        size_t got_len = live_view(remind_file, got);
+        ok = got_len == model_len && memcmp(got, model, got_len) == 0 &&
+             remind_count(remind_file) == remind_count_lines(model, model_len);
+
+        // -c streams the chunks rather than reading them into one buffer
+        Output streamed = { .fd = -1 }, expected = { .fd = -1 };
+        struct stat manifest_st;
+        int64_t valid_until;
+        remind_render(&expected, model, model_len);
+        ok = ok && remind_chunks_render(&streamed, remind_file, (int64_t) time(NULL), &valid_until, &manifest_st) == 0 &&
+             streamed.len == expected.len && memcmp(streamed.data, expected.data, expected.len) == 0 &&
+             valid_until == REMIND_NEVER;
+        output_free(&streamed);
+        output_free(&expected);
+        if (!ok) {
+            printf("  round %d: the chunked list differs from the model\n", round);
+        }
+    }
+
+    struct stat st;
+    int chunked = stat(remind_file, &st) != 0;
+    remind_compact(remind_file);
+    size_t raw_len;
+    char* raw = read_file(remind_file, &raw_len);
+    int joined = raw && raw_len == model_len && memcmp(raw, model, raw_len) == 0;
+    free(raw);
+
+    unsetenv("REMIND_STORAGE");
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    free(model);
+    free(next);
+    free(got);
+
+    if (ok && chunked && joined) {
+        pass_test("");
+    } else {
+        fail_test("", "Chunked storage should behave exactly like the plain file");
+    }
+}
+
+// Push a file's mtime an hour back so sidecars that skip fresh files are written
+void age_file(const char* path) {
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 3600;
+    times[1] = times[0];
+    utimes(path, times);
+}
+
+// True when reminders.index describes the list as it is now. The stamp
+// follows the 16-byte magic, version and header size.
+int index_is_current(const char* index_file) {
+    FileStamp indexed, now;
+    struct stat st;
+    FILE* fp = fopen(index_file, "r");
+    int ok = fp && fseek(fp, 16, SEEK_SET) == 0 && fread(&indexed, sizeof(indexed), 1, fp) == 1 &&
+             stat(remind_file, &st) == 0;
+    if (fp) fclose(fp);
+    now = file_stamp(&st);
+    return ok && file_stamp_equal(&indexed, &now);
+}
+
+// Step from a seek to line target; returns the line's text or NULL
+const char* seek_to(const RemindList* list, long target, size_t* len) {
+    RemindLine line;
+    remind_seek_line(list, remind_file, target, &line);
+    while (line.number < target && remind_next_line(list, &line)) {}
+    *len = line.len;
+    return line.number == target ? line.text : NULL;
+}
+
+// Test 8: Seeking through the offset index lands on the same lines as a scan
+void test_index_seek() {
+    printf("Test 8: Line-offset index\n");
+
+    const int lines = 5000;
+    Output contents = { .fd = -1 };
+    for (int i = 1; i <= lines; i++) {
+        char text[32];
+        int n = snprintf(text, sizeof(text), i % 7 ? "line %d\n" : "\n", i);
+        output_append(&contents, text, n);
+    }
+    write_file(remind_file, contents.data, contents.len);
+    output_free(&contents);
+    age_file(remind_file);
+
+    char index_file[MAX_PATH_SIZE];
+    snprintf(index_file, sizeof(index_file), "%s.index", remind_file);
+    unlink(index_file);
+
+    int ok = 1;
+    unsigned int seed = 99;
+    RemindList list;
+    ok = remind_list_open(&list, remind_file) == 0;
+    for (int i = 0; i < 500 && ok; i++) {
+        long target = 1 + rand_r(&seed) % (lines + 2);
+        size_t start, end, len;
+        bool exists = remind_find_line(list.data, list.size, target, &start, &end);
+        const char* text = seek_to(&list, target, &len);
+        ok = exists ? text == list.data + start : text == NULL;
+        if (!ok) printf("  line %ld was not found through the index\n", target);
+    }
+    remind_list_close(&list);
+    struct stat st;
+    int built = stat(index_file, &st) == 0;
+
+    // Appends extend the index in place rather than invalidating it
+    remind_add(remind_file, "appended");
+    int extended = index_is_current(index_file);
+    ok = ok && remind_list_open(&list, remind_file) == 0;
+    size_t len;
+    const char* text = ok ? seek_to(&list, lines + 1, &len) : NULL;
+    ok = ok && text && len == 8 && memcmp(text, "appended", 8) == 0;
+    remind_list_close(&list);
+
+    // A batch that spans several index entries
+    Output batch = { .fd = -1 };
+    for (int i = 0; i < 200; i++) {
+        char item[32];
+        output_append(&batch, item, snprintf(item, sizeof(item), "batch %d\n", i));
+    }
+    remind_append(remind_file, batch.data, batch.len);
+    output_free(&batch);
+    extended = extended && index_is_current(index_file);
+    ok = ok && remind_list_open(&list, remind_file) == 0;
+    text = ok ? seek_to(&list, lines + 1 + 150, &len) : NULL;
+    ok = ok && text && len == 9 && memcmp(text, "batch 149", 9) == 0;
+    remind_list_close(&list);
+
+    // Tombstones shift live numbers; the seek must account for them
+    setenv("REMIND_STORAGE", "log", 1);
+    LineSet set = {0};
+    line_set_parse(&set, "10-19,2000");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+    int restamped = index_is_current(index_file);
+    ok = ok && remind_list_open(&list, remind_file) == 0;
+    for (long target = 1; ok && target < lines; target += 97) {
+        RemindLine line = {0};
+        while (remind_next_line(&list, &line) && line.number < target) {}
+        text = seek_to(&list, target, &len);
+        ok = text == line.text;
+        if (!ok) printf("  live line %ld was not found through the index\n", target);
+    }
+    remind_list_close(&list);
+    remind_compact(remind_file);
+
+    if (ok && built && extended && restamped) {
+        pass_test("");
+    } else {
+        fail_test("", "Index seeks should agree with a scan from the top");
+    }
+}
+
+// Skip n lines of rendered output
+const char* skip_lines(const char* p, int n) {
+    while (n-- > 0 && p) {
+        p = strchr(p, '\n');
+        if (p) p++;
+    }
+    return p;
+}
+
+// Test 9: Windows show exactly the matching lines of the full listing
+void test_windows() {
+    printf("Test 9: Head, tail and range windows\n");
+
+    const int lines = 3000;
+    Output contents = { .fd = -1 };
+    unsigned int seed = 7;
+    for (int i = 1; i <= lines; i++) {
+        char text[64];
+        int n = snprintf(text, sizeof(text), "item %d %.*s\n", i, rand_r(&seed) % 20, "xxxxxxxxxxxxxxxxxxxx");
+        output_append(&contents, text, n);
+    }
+    write_file(remind_file, contents.data, contents.len);
+    output_free(&contents);
+    age_file(remind_file);
+
+    // Tombstones shift numbers, which the windows must follow
+    setenv("REMIND_STORAGE", "log", 1);
+    LineSet set = {0};
+    line_set_parse(&set, "5,100-140,2990-2995");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+    long live = lines - 1 - 41 - 6;
+
+    RemindList list;
+    int ok = remind_list_open(&list, remind_file) == 0;
+    Output full = { .fd = -1 };
+    if (ok) remind_render_list(&full, &list);
+    output_append(&full, "", 1);
+    const char* body = skip_lines(full.data, 3);
+
+    for (int i = 0; i < 300 && ok; i++) {
+        LineWindow window = { .kind = WINDOW_HEAD + i % 3 };
+        long first, last;
+        long a = 1 + rand_r(&seed) % (live + 10), b = 1 + rand_r(&seed) % (live + 10);
+        if (window.kind == WINDOW_HEAD) {
+            window.count = a;
+            first = 1;
+            last = a;
+        } else if (window.kind == WINDOW_TAIL) {
+            window.count = a;
+            first = a >= live ? 1 : live - a + 1;
+            last = live;
+        } else {
+            window.first = first = a < b ? a : b;
+            window.last = last = a < b ? b : a;
+        }
+        if (last > live) last = live;
+
+        Output got = { .fd = -1 };
+        remind_render_window(&got, &list, remind_file, &window);
+        output_append(&got, "", 1);
+        if (first > last) {
+            ok = got.len == 1;
+        } else {
+            const char* want = skip_lines(body, (int) first - 1);
+            const char* want_end = skip_lines(want, (int) (last - first + 1));
+            const char* shown = skip_lines(got.data, 3);
+            size_t n = want_end - want;
+            ok = shown && strlen(shown) == n + 1 && memcmp(shown, want, n) == 0 && shown[n] == '\n';
+        }
+        if (!ok) printf("  window %d (%ld-%ld) did not match the full list\n", window.kind, first, last);
+        output_free(&got);
+    }
+    output_free(&full);
+    remind_list_close(&list);
+    remind_compact(remind_file);
+
+    if (ok) {
+        pass_test("");
+    } else {
+        fail_test("", "Windows should match the same lines of the full list");
+    }
+}
+
+// Reference matcher: a byte-at-a-time substring test with ASCII folding
+int naive_contains(const char* text, size_t len, const char* pattern, int icase) {
+    size_t plen = strlen(pattern);
+    for (size_t i = 0; i + plen <= len; i++) {
+        size_t j = 0;
+        while (j < plen && (icase ? tolower((unsigned char) text[i + j]) == tolower((unsigned char) pattern[j])
+                                  : text[i + j] == pattern[j])) j++;
+        if (j == plen) return 1;
+    }
+    return 0;
+}
+
+// Test 10: Searches find the same lines, with the same numbers, as a scan
+void test_search() {
+    printf("Test 10: Literal and regex search\n");
+
+    // Short alphabet so patterns hit often, and in every kernel lane
+    const int lines = 4000;
+    Output contents = { .fd = -1 };
+    unsigned int seed = 11;
+    for (int i = 1; i <= lines; i++) {
+        char text[128];
+        int n = rand_r(&seed) % 90;
+        for (int j = 0; j < n; j++) text[j] = "abcAB xyz"[rand_r(&seed) % 9];
+        text[n] = '\n';
+        output_append(&contents, text, n + 1);
+    }
+    // An unterminated last line that matches right at the end of the file
+    output_str(&contents, "tail ends with needle");
+    write_file(remind_file, contents.data, contents.len);
+    output_free(&contents);
+
+    setenv("REMIND_STORAGE", "log", 1);
+    LineSet set = {0};
+    line_set_parse(&set, "3,50-80,3999");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+
+    static const char* literals[] = { "a", "ab", "abc", "cab x", "needle", "aBc", "zzzzzz", "",
+                                      "abcabcabcabcabcab", "ab ab ab ab ab ab ab ab ab ab ab ab ab" };
+    static const char* regexes[] = { "^ab", "c$", "a(b|c)a", "^$", "[xyz]{3}", "B.?A" };
+    int ok = 1;
+    RemindList list;
+    ok = remind_list_open(&list, remind_file) == 0;
+    for (int r = 0; r < 2 && ok; r++) {
+        const char** patterns = r ? regexes : literals;
+        size_t count = r ? sizeof(regexes) / sizeof(*regexes) : sizeof(literals) / sizeof(*literals);
+        for (size_t i = 0; i < count && ok; i++) {
+            for (int icase = 0; icase < 2 && ok; icase++) {
+                RemindPattern pattern;
+                regex_t reference;
+                ok = remind_pattern_compile(&pattern, patterns[i], icase) == 0 && pattern.is_regex == r &&
+                     regcomp(&reference, patterns[i], REG_EXTENDED | REG_NOSUB | (icase ? REG_ICASE : 0)) == 0;
+                RemindLine line = {0}, match = {0};
+                while (ok && remind_next_line(&list, &line)) {
+                    char copy[256];
+                    snprintf(copy, sizeof(copy), "%.*s", (int) line.len, line.text);
+                    int expected = r ? regexec(&reference, copy, 0, NULL, 0) == 0
+                                     : naive_contains(line.text, line.len, patterns[i], icase);
+                    if (!expected) continue;
+                    ok = remind_next_match(&list, &pattern, &match) && match.number == line.number &&
+                         match.text == line.text && match.len == line.len;
+                }
+                ok = ok && !remind_next_match(&list, &pattern, &match);
+                if (!ok) printf("  pattern \"%s\" (icase %d) disagreed with a scan\n", patterns[i], icase);
+                remind_pattern_free(&pattern);
+                regfree(&reference);
+            }
+        }
+    }
+    remind_list_close(&list);
+    remind_compact(remind_file);
+
+    RemindPattern broken;
+    int saved_stderr = dup(STDERR_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDERR_FILENO);
+    int rejected = remind_pattern_compile(&broken, "a(b", false) != 0;
+    dup2(saved_stderr, STDERR_FILENO);
+    close(saved_stderr);
+    close(null_fd);
+
+    if (ok && rejected) {
+        pass_test("");
+    } else {
+        fail_test("", "Search should match exactly the lines a scan finds");
+    }
+}
+
+// Compares an index-backed search with a scan; -1 when the index did not answer
+int indexed_search_agrees(const char* text, int icase) {
+    RemindList list;
+    if (remind_list_open(&list, remind_file) != 0) return 0;
+    RemindPattern pattern;
+    remind_pattern_compile(&pattern, text, icase);
+    RemindLine* matches;
+    long count = remind_trigrams_search(&list, remind_file, &pattern, &matches);
+    int ok = count >= 0 ? 1 : -1;
+    RemindLine line = {0};
+    long i = 0;
+    while (ok == 1 && remind_next_match(&list, &pattern, &line)) {
+        ok = i < count && matches[i].text == line.text && matches[i].len == line.len &&
+             matches[i].number == line.number;
+        i++;
+    }
+    if (ok == 1 && i != count) ok = 0;
+    free(matches);
+    remind_pattern_free(&pattern);
+    remind_list_close(&list);
+    return ok;
+}
+
+// Test 11: The trigram index answers searches exactly as a scan would, and
+// stays usable through adds and every kind of delete
+void test_trigram_index() {
+    printf("Test 11: Trigram index\n");
+
+    const int lines = 40000;
+    Output contents = { .fd = -1 };
+    unsigned int seed = 5;
+    for (int i = 1; i <= lines; i++) {
+        char text[64];
+        int n = snprintf(text, sizeof(text), "task %d %s due %c%c\n", i,
+                         rand_r(&seed) % 3 ? "Review" : "deploy", 'a' + rand_r(&seed) % 26, 'a' + rand_r(&seed) % 26);
+        output_append(&contents, text, n);
+    }
+    write_file(remind_file, contents.data, contents.len);
+    output_free(&contents);
+    age_file(remind_file);
+
+    static const char* patterns[] = { "task 1234", "review", "due qx", "DEPLOY due", "task 399", "zzz" };
+    int patterns_count = sizeof(patterns) / sizeof(patterns[0]);
+    int ok = 1, answered = 1;
+    setenv("REMIND_TRIGRAMS", "1", 1);
+    for (int i = 0; i < patterns_count && ok; i++) {
+        for (int icase = 0; icase < 2 && ok; icase++) {
+            int agrees = indexed_search_agrees(patterns[i], icase);
+            ok = agrees != 0;
+            // Common patterns fall back to a scan; the rare ones must not
+            if (i == 0 || i == 2 || i == 4) answered = answered && agrees == 1;
+        }
+    }
+    unsetenv("REMIND_TRIGRAMS");
+
+    // Adds one at a time exercise segment merges; then the three deletes
+    for (int i = 0; i < 300 && ok; i++) {
+        char text[64];
+        snprintf(text, sizeof(text), "added %d due qx", i);
+        remind_add(remind_file, text);
+    }
+    LineSet set = {0};
+    line_set_parse(&set, "2,1000-1100,40150");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    setenv("REMIND_STORAGE", "log", 1);
+    line_set_parse(&set, "7,39999-40010");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+
+    for (int i = 0; i < patterns_count && ok; i++) {
+        int agrees = indexed_search_agrees(patterns[i], 1);
+        ok = agrees != 0;
+        if (i == 0 || i == 2 || i == 4) answered = answered && agrees == 1;
+    }
+    answered = answered && indexed_search_agrees("added 12", 0) == 1;
+    remind_compact(remind_file);
+
+    if (ok && answered) {
+        pass_test("");
+    } else {
+        fail_test("", ok ? "Rare patterns should be answered from the index"
+                         : "Index-backed searches should match a scan");
+    }
+}
+
+// Compares remind_tags_search() with a scan of every line: 1 when they
+// agree, 0 when they differ, -1 when the index could not answer
+int tag_search_agrees(const char* tag) {
+    RemindList list;
+    if (remind_list_open(&list, remind_file) != 0) return 0;
+    RemindLine* matches;
+    long count = remind_tags_search(&list, remind_file, tag, &matches);
+    int ok = count >= 0 ? 1 : -1;
+    RemindLine line = {0};
+    long i = 0;
+    while (ok == 1 && remind_next_line(&list, &line)) {
+        if (!remind_line_has_tag(line.text, line.len, tag)) continue;
+        ok = i < count && matches[i].text == line.text && matches[i].number == line.number;
+        i++;
+    }
+    if (ok == 1 && i != count) ok = 0;
+    free(matches);
+    remind_list_close(&list);
+    return ok;
+}
+
+// Appends `count` reminders with a mix of tags, in one write
+void add_tagged(int first, int count, unsigned int* seed) {
+    static const char* forms[] = { "+work task %d", "task %d +home +work", "task %d", "x+work %d",
+                                   "+work-ish %d", "task %d +errands", "+home %d +home" };
+    Output out = { .fd = -1 };
+    for (int i = first; i < first + count; i++) {
+        char text[64];
+        snprintf(text, sizeof(text), forms[rand_r(seed) % 7], i);
+        remind_format(&out, text, strlen(text));
+    }
+    remind_append(remind_file, out.data, out.len);
+    output_free(&out);
+}
+
+// Test 12: The tag index lists exactly the lines a scan finds, and stays
+// usable through single and bulk adds and both kinds of delete
+void test_tag_index() {
+    printf("Test 12: Tag index\n");
+
+    unlink(remind_file);
+    unsigned int seed = 9;
+    add_tagged(1, 8000, &seed);
+    age_file(remind_file);
+
+    static const char* tags[] = { "work", "home", "errands", "work-ish", "nope" };
+    int tags_count = sizeof(tags) / sizeof(tags[0]);
+    int ok = 1;
+    for (int i = 0; i < tags_count && ok; i++) ok = tag_search_agrees(tags[i]) == 1;
+
+    // Singles go to the tail; the bulk adds make it big enough to be sorted in
+    for (int i = 0; i < 50 && ok; i++) add_tagged(9000 + i, 1, &seed);
+    add_tagged(10000, 3000, &seed);
+    add_tagged(20000, 3000, &seed);
+    for (int i = 0; i < tags_count && ok; i++) ok = tag_search_agrees(tags[i]) == 1;
+
+    LineSet set = {0};
+    line_set_parse(&set, "1,3,500-900,8040,14050");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    for (int i = 0; i < tags_count && ok; i++) ok = tag_search_agrees(tags[i]) == 1;
+
+    setenv("REMIND_STORAGE", "log", 1);
+    line_set_parse(&set, "2,7000-7100");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+    for (int i = 0; i < tags_count && ok; i++) ok = tag_search_agrees(tags[i]) == 1;
+    remind_compact(remind_file);
+
+    if (ok) {
+        pass_test("");
+    } else {
+        fail_test("", "Tag listings from the index should match a scan");
+    }
+}
+
+// The instant of a local date and time
+int64_t local_at(int y, int m, int d, int hour, int minute) {
+    struct tm tm = { .tm_year = y - 1900, .tm_mon = m - 1, .tm_mday = d,
+                     .tm_hour = hour, .tm_min = minute, .tm_isdst = -1 };
+    return (int64_t) mktime(&tm);
+}
+
+// Checks one rule at one instant: shown or not, and when that changes
+int schedule_is(const char* text, int64_t now, int shown, int64_t change) {
+    Schedule schedule;
+    int64_t got;
+    if (!remind_schedule_parse(text, strlen(text), &schedule)) return 0;
+    return remind_schedule_shown(&schedule, now, &got) == shown && got == change;
+}
+
+// Compares remind_due_hidden() at now with evaluating every physical line
+int due_heap_agrees(int64_t now) {
+    RemindList list;
+    if (remind_list_open(&list, remind_file) != 0) return 0;
+    uint32_t* hidden;
+    size_t hidden_count;
+    int64_t valid_until;
+    int ok = remind_due_hidden(&list, remind_file, now, &hidden, &hidden_count, &valid_until) == 0;
+
+    int64_t earliest = REMIND_NEVER;
+    size_t h = 0;
+    uint32_t physical = 0;
+    const char* end = list.data + list.size;
+    for (const char* p = list.data; ok && p < end; ) {
+        const char* nl = memchr(p, '\n', end - p);
+        size_t len = nl ? (size_t) (nl - p) : (size_t) (end - p);
+        physical++;
+        Schedule schedule;
+        int64_t change;
+        if (remind_schedule_parse(p, len, &schedule)) {
+            int shown = remind_schedule_shown(&schedule, now, &change);
+            if (change < earliest) earliest = change;
+            if (!shown) ok = h < hidden_count && hidden[h++] == physical;
+        }
+        p += len + 1;
+    }
+    ok = ok && h == hidden_count && valid_until == earliest;
+    free(hidden);
+    remind_list_close(&list);
+    return ok;
+}
+
+// Formats the local date `days` from now as YYYY-MM-DD
+void date_in(char* out, size_t size, int64_t now, int days) {
+    time_t t = (time_t) (now + days * 86400);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(out, size, "%Y-%m-%d", &tm);
+}
+
+// Appends reminders with a mix of schedules around now, in one write
+void add_scheduled(int first, int count, int64_t now, unsigned int* seed) {
+    static const char* rules[] = { "", "every:day", "every:3d", "every:2w", "every:month",
+                                   "every:mon,thu", "every:weekends" };
+    Output out = { .fd = -1 };
+    for (int i = first; i < first + count; i++) {
+        char date[16], text[128];
+        date_in(date, sizeof(date), now, (int) (rand_r(seed) % 30) - 10);
+        switch (rand_r(seed) % 4) {
+            case 0:
+                snprintf(text, sizeof(text), "task %d", i);
+                break;
+            case 1:
+                snprintf(text, sizeof(text), "task %d due:%sT%02d:%02d %s", i, date, rand_r(seed) % 24,
+                         rand_r(seed) % 60, rules[rand_r(seed) % 7]);
+                break;
+            case 2:
+                snprintf(text, sizeof(text), "task %d %s due:%s", i, rules[rand_r(seed) % 7], date);
+                break;
+            default:
+                snprintf(text, sizeof(text), "task %d snooze:%s every:weekdays", i, date);
+                break;
+        }
+        remind_format(&out, text, strlen(text));
+    }
+    remind_append(remind_file, out.data, out.len);
+    output_free(&out);
+}
+
+// Test 13: Schedules are evaluated right, and the due heap hides exactly
+// the lines a full evaluation would, through time, adds and deletes
+void test_schedule() {
+    printf("Test 13: Due dates, recurrence and the due heap\n");
+
+    int64_t nine = local_at(2026, 3, 10, 9, 0);
+    int rules = schedule_is("x due:2026-03-10T09:00", nine - 60, 0, nine) &&
+                schedule_is("x due:2026-03-10T09:00", nine, 1, REMIND_NEVER) &&
+                schedule_is("x every:2d due:2026-03-10T09:00", local_at(2026, 3, 11, 12, 0), 0,
+                            local_at(2026, 3, 12, 9, 0)) &&
+                schedule_is("x every:2d due:2026-03-10T09:00", local_at(2026, 3, 12, 10, 0), 1,
+                            local_at(2026, 3, 13, 0, 0)) &&
+                schedule_is("x every:month due:2026-01-31", local_at(2026, 2, 28, 10, 0), 1,
+                            local_at(2026, 3, 1, 0, 0)) &&
+                schedule_is("x every:month due:2026-01-31", local_at(2026, 3, 1, 10, 0), 0,
+                            local_at(2026, 3, 31, 0, 0)) &&
+                schedule_is("x every:mon,fri", local_at(2026, 10, 16, 8, 0), 1, local_at(2026, 10, 17, 0, 0)) &&
+                schedule_is("x every:mon,fri", local_at(2026, 10, 17, 8, 0), 0, local_at(2026, 10, 19, 0, 0)) &&
+                schedule_is("x due:2026-01-01 snooze:2026-10-20", local_at(2026, 10, 19, 8, 0), 0,
+                            local_at(2026, 10, 20, 0, 0)) &&
+                schedule_is("x due:2026-01-01 snooze:2026-10-20", local_at(2026, 10, 21, 8, 0), 1, REMIND_NEVER);
+    Schedule schedule;
+    int ignored = !remind_schedule_parse("due:2026-02-30 every:fortnight due: x", 37, &schedule);
+
+    unlink(remind_file);
+    int64_t now = (int64_t) time(NULL);
+    unsigned int seed = 13;
+    add_scheduled(1, 3000, now, &seed);
+    age_file(remind_file);
+    int ok = due_heap_agrees(now) && due_heap_agrees(now + 3 * 86400 + 7200);
+
+    add_scheduled(5000, 200, now, &seed);
+    ok = ok && due_heap_agrees(now + 5 * 86400);
+    LineSet set = {0};
+    line_set_parse(&set, "1,10-400,3100");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    ok = ok && due_heap_agrees(now + 12 * 86400 + 600);
+    setenv("REMIND_STORAGE", "log", 1);
+    line_set_parse(&set, "5,2000-2100");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    unsetenv("REMIND_STORAGE");
+    ok = ok && due_heap_agrees(now + 40 * 86400);
+    remind_compact(remind_file);
+
+    if (rules && ignored && ok) {
+        pass_test("");
+    } else {
+        fail_test("", !rules || !ignored ? "Schedules should be evaluated as documented"
+                                         : "The due heap should hide what a full evaluation hides");
+    }
+}
+
+// Test 14: Edits in place leave the list a model says they should, and keep
+// the line index valid whichever way the line changed length
+void test_edit_in_place() {
+    printf("Test 14: Editing a reminder in place\n");
+
+    const int lines = 1000;
+    char model[1000][48];
+    Output contents = { .fd = -1 };
+    for (int i = 0; i < lines; i++) {
+        snprintf(model[i], sizeof(model[i]), "line %d", i + 1);
+        output_str(&contents, model[i]);
+        output_append(&contents, "\n", 1);
+    }
+    write_file(remind_file, contents.data, contents.len);
+    output_free(&contents);
+    age_file(remind_file);
+
+    char index_file[MAX_PATH_SIZE];
+    snprintf(index_file, sizeof(index_file), "%s.index", remind_file);
+    unlink(index_file);
+    RemindList list;
+    size_t len;
+    int ok = remind_list_open(&list, remind_file) == 0 && seek_to(&list, lines, &len) != NULL;
+    remind_list_close(&list);
+
+    // Shorter, longer and same-length replacements, checked through the index
+    unsigned int seed = 14;
+    int indexed = 1;
+    for (int i = 0; i < 60 && ok; i++) {
+        long target = 1 + rand_r(&seed) % lines;
+        char text[48];
+        int n = (int) strlen(model[target - 1]) + (int) (rand_r(&seed) % 9) - 4;
+        snprintf(text, sizeof(text), "%.*s", n > 0 ? n : 1, "edited xxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        ok = remind_edit(remind_file, target, text, strlen(text)) == 0;
+        snprintf(model[target - 1], sizeof(model[target - 1]), "%s", text);
+        indexed = indexed && index_is_current(index_file);
+
+        long probe = 1 + rand_r(&seed) % lines;
+        ok = ok && remind_list_open(&list, remind_file) == 0;
+        const char *found = ok ? seek_to(&list, probe, &len) : NULL;
+        ok = ok && found && len == strlen(model[probe - 1]) && memcmp(found, model[probe - 1], len) == 0;
+        remind_list_close(&list);
+    }
+
+    // Tombstoned lines stay dead as the bytes after an edit move, and the
+    // numbers stay the live ones
+    setenv("REMIND_STORAGE", "log", 1);
+    LineSet set = {0};
+    line_set_parse(&set, "1-10");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    line_set_parse(&set, "20-29");
+    remind_delete(remind_file, &set);
+    line_set_free(&set);
+    ok = ok && remind_edit(remind_file, 1, "first\nlive and much longer", 26) == 0;
+    unsetenv("REMIND_STORAGE");
+    snprintf(model[10], sizeof(model[10]), "first live and much longer");
+    // A rewrite gives the list a new inode, which the tombstones follow
+    setenv("REMIND_SAFE_WRITES", "1", 1);
+    ok = ok && remind_edit(remind_file, 2, "2nd", 3) == 0;
+    unsetenv("REMIND_SAFE_WRITES");
+    snprintf(model[11], sizeof(model[11]), "2nd");
+    ok = ok && remind_edit(remind_file, 5000, "nowhere", 7) != 0;
+
+    Output expected = { .fd = -1 }, live = { .fd = -1 };
+    for (int i = 10; i < lines; i++) {
+        if (i >= 29 && i < 39) continue;
+        output_str(&expected, model[i]);
+        output_append(&expected, "\n", 1);
+    }
+    ok = ok && remind_list_open(&list, remind_file) == 0 && list.dead_count == 20;
+    RemindLine line = {0};
+    while (ok && remind_next_line(&list, &line)) {
+        output_append(&live, line.text, line.len);
+        output_append(&live, "\n", 1);
+    }
+    ok = ok && live.len == expected.len && memcmp(live.data, expected.data, expected.len) == 0;
+    remind_list_close(&list);
+    output_free(&expected);
+    output_free(&live);
+
+    if (ok && indexed) {
+        pass_test("");
+    } else {
+        fail_test("", ok ? "Edits should keep the index current" : "Edits should change exactly the one line");
+    }
+    unlink(remind_file);
+}
+
+int main(int argc, char* argv[]) {
+    printf("In-process Tests for libremind\n");
+    printf("==============================================\n");
+
+    snprintf(test_dir, sizeof(test_dir), "/tmp/remind_test_lib_%d", getpid());
+    if (mkdir(test_dir, 0755) != 0) {
+        perror("mkdir test_dir");
+        return 1;
+    }
+    snprintf(remind_file, sizeof(remind_file), "%s/reminders", test_dir);
+
+    test_line_set_parse();
+    test_iterate_count_find();
+    test_render();
+    test_append();
+    test_delete_matches_model();
+    test_log_storage_matches_model();
+    test_chunked_storage_matches_model();
+    test_index_seek();
+    test_windows();
+    test_search();
+    test_trigram_index();
+    test_tag_index();
+    test_schedule();
+    test_edit_in_place();
+
+    char cmd[MAX_CMD_SIZE];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", test_dir);
+    system(cmd);
+
+    // Summary
+    printf("\nTest Summary:\n");
+    printf("Passed: %d\n", tests_passed);
+    printf("Failed: %d\n", tests_failed);
+
+    if (tests_failed == 0) {
+        printf(GREEN "All tests passed!" NC "\n");
+        return 0;
+    } else {
+        printf(RED "Some tests failed." NC "\n");
+        return 1;
+    }
+}
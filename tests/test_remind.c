@@ -2,8 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
 
 #define MAX_OUTPUT_SIZE 4096
 #define MAX_PATH_SIZE 512
@@ -92,6 +98,25 @@ int file_contains(const char* path, const char* search) {
     return 0;
 }
 
+// Read a whole file into buf, returns bytes read or -1
+long read_file(const char* path, char* buf, size_t buf_size) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return -1;
+    size_t n = fread(buf, 1, buf_size - 1, fp);
+    buf[n] = '\0';
+    fclose(fp);
+    return (long) n;
+}
+
+// Replace the reminders file with exact contents
+int write_file(const char* path, const char* contents) {
+    FILE* fp = fopen(path, "w");
+    if (!fp) return -1;
+    fputs(contents, fp);
+    fclose(fp);
+    return 0;
+}
+
 // Create temporary directory and set up test environment
 int setup_test_env() {
     // Create temporary directory
@@ -260,6 +285,990 @@ void test_help_long_flag() {
     }
 }
 
+// Test 9: Directory setup does not shell out
+void test_no_fork_directory_setup() {
+    printf("Test 9: Directory setup without fork/exec\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char fresh_home[MAX_PATH_SIZE];
+    char fresh_file[MAX_PATH_SIZE];
+    snprintf(fresh_home, sizeof(fresh_home), "%s/fresh/home", test_home);
+    snprintf(fresh_file, sizeof(fresh_file), "%s/.local/state/remind/reminders", fresh_home);
+
+    // With an empty PATH neither `sh -c mkdir` nor any other helper binary
+    // can be found, so the directory only appears if remind creates it itself.
+    snprintf(cmd, sizeof(cmd), "env -i PATH=/nonexistent HOME=%s %s -c 2>&1",
+             fresh_home, binary_path);
+    run_command(cmd, output, sizeof(output));
+
+    if (strlen(output) == 0 && file_exists(fresh_file)) {
+        pass_test("");
+    } else {
+        fail_test("", "Should create the reminders directory without external commands");
+    }
+}
+
+// Test 10: Startup latency of -c
+void test_check_startup_latency() {
+    printf("Test 10: Startup latency of -c\n");
+
+    const int runs = 100;
+    char cmd[MAX_CMD_SIZE];
+    snprintf(cmd, sizeof(cmd), "%s -c > /dev/null", binary_path);
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    for (int i = 0; i < runs; i++) {
+        system(cmd);
+    }
+    gettimeofday(&end, NULL);
+
+    double total_ms = (end.tv_sec - start.tv_sec) * 1000.0 +
+                      (end.tv_usec - start.tv_usec) / 1000.0;
+    printf("  %.3f ms per run (including the test's own sh)\n", total_ms / runs);
+
+    // Generous bound: this only catches gross regressions such as a
+    // return of per-call subprocesses, not scheduler noise.
+    if (total_ms / runs < 50.0) {
+        pass_test("");
+    } else {
+        fail_test("", "remind -c is too slow to run at shell startup");
+    }
+}
+
+// Test 11: No line count or line length limits
+void test_large_list_no_limits() {
+    printf("Test 11: Large list without line limits\n");
+
+    FILE* fp = fopen(remind_file, "w");
+    if (!fp) {
+        fail_test("", "Could not write reminders file");
+        return;
+    }
+    for (int i = 1; i <= 5000; i++) {
+        if (i == 2500) {
+            for (int j = 0; j < 3000; j++) fputc('x', fp);
+            fputc('\n', fp);
+        } else {
+            fprintf(fp, "Reminder %d\n", i);
+        }
+    }
+    fclose(fp);
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+
+    // Count numbered lines and report the length of the longest one
+    snprintf(cmd, sizeof(cmd),
+             "%s -c 2>&1 | awk '/^[0-9]+\\. /{n++; if (length > m) m = length} END{print n, m}'",
+             binary_path);
+    run_command(cmd, output, sizeof(output));
+
+    if (strcmp(output, "5000 3006\n") == 0) {
+        pass_test("");
+    } else {
+        fail_test("", "Should print every line in full");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 12: Delete splices one line and keeps blank lines
+void test_delete_splice_keeps_blank_lines() {
+    printf("Test 12: Delete keeps blank lines and unterminated last line\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char contents[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "one\n\nthree\nfour");
+    snprintf(cmd, sizeof(cmd), "%s -d 3", binary_path);
+    system(cmd);
+    read_file(remind_file, contents, sizeof(contents));
+    int in_place_ok = strcmp(contents, "one\n\nfour") == 0;
+
+    snprintf(cmd, sizeof(cmd), "REMIND_SAFE_WRITES=1 %s -d 1", binary_path);
+    system(cmd);
+    read_file(remind_file, contents, sizeof(contents));
+    int safe_ok = strcmp(contents, "\nfour") == 0;
+
+    if (in_place_ok && safe_ok) {
+        pass_test("");
+    } else {
+        fail_test("", "Should remove exactly the numbered line in both write modes");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 13: Batch and range deletes use the original numbering
+void test_delete_ranges() {
+    printf("Test 13: Batch and range deletes\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char contents[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n");
+    snprintf(cmd, sizeof(cmd), "%s -d 1,4,7-9 -d 12", binary_path);
+    system(cmd);
+    read_file(remind_file, contents, sizeof(contents));
+
+    if (strcmp(contents, "2\n3\n5\n6\n10\n11\n") == 0) {
+        pass_test("");
+    } else {
+        fail_test("", "Should delete 1, 4, 7-9 and 12 as numbered before the delete");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 14: Bulk add from stdin plus repeated -a
+void test_bulk_add_from_stdin() {
+    printf("Test 14: Bulk add from stdin\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char contents[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "existing\n");
+    snprintf(cmd, sizeof(cmd),
+             "printf 'first\\r\\nsecond\\n\\n  \\nthird' | %s -a - -a \"$(printf 'two\\nlines')\"",
+             binary_path);
+    system(cmd);
+    read_file(remind_file, contents, sizeof(contents));
+
+    if (strcmp(contents, "existing\nfirst\nsecond\nthird\ntwo lines\n") == 0) {
+        pass_test("");
+    } else {
+        fail_test("", "Should append every non-blank stdin line and each -a text");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 15: Parallel adders and deleters never lose reminders
+void test_concurrent_add_delete() {
+    printf("Test 15: Concurrent adds and deletes\n");
+
+    const int workers = 4;
+    const int ops_per_worker = 40;
+    const int victims = workers * ops_per_worker;
+
+    // Deleters always remove line 1, and adds only ever go to the end, so
+    // exactly the pre-seeded victim lines should disappear.
+    FILE* fp = fopen(remind_file, "w");
+    if (!fp) {
+        fail_test("", "Could not write reminders file");
+        return;
+    }
+    for (int i = 0; i < victims; i++) {
+        fprintf(fp, "victim %d\n", i);
+    }
+    fclose(fp);
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    pid_t pids[8];
+    for (int w = 0; w < 2 * workers; w++) {
+        pids[w] = fork();
+        if (pids[w] == 0) {
+            char cmd[MAX_CMD_SIZE];
+            for (int i = 0; i < ops_per_worker; i++) {
+                if (w < workers) {
+                    snprintf(cmd, sizeof(cmd), "%s -a \"adder %d item %d\"", binary_path, w, i);
+                } else {
+                    snprintf(cmd, sizeof(cmd), "%s -d 1", binary_path);
+                }
+                system(cmd);
+            }
+            _exit(0);
+        }
+    }
+    for (int w = 0; w < 2 * workers; w++) {
+        waitpid(pids[w], NULL, 0);
+    }
+
+    gettimeofday(&end, NULL);
+    double total_ms = (end.tv_sec - start.tv_sec) * 1000.0 +
+                      (end.tv_usec - start.tv_usec) / 1000.0;
+    printf("  %d operations in %.1f ms (%.0f ops/s)\n",
+           2 * workers * ops_per_worker, total_ms,
+           2 * workers * ops_per_worker / (total_ms / 1000.0));
+
+    int all_added = 1;
+    for (int w = 0; w < workers && all_added; w++) {
+        for (int i = 0; i < ops_per_worker && all_added; i++) {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "adder %d item %d\n", w, i);
+            all_added = file_contains(remind_file, expected);
+        }
+    }
+
+    if (all_added &&
+        !file_contains(remind_file, "victim") &&
+        count_lines(remind_file) == workers * ops_per_worker &&
+        total_ms < 30000.0) {
+        pass_test("");
+    } else {
+        fail_test("", "Every added reminder should survive concurrent deletes");
+    }
+
+    unlink(remind_file);
+}
+
+// Age a file so it is old enough for remind to cache its rendering
+void age_file(const char* path) {
+    struct timeval times[2];
+    gettimeofday(&times[0], NULL);
+    times[0].tv_sec -= 3600;
+    times[1] = times[0];
+    utimes(path, times);
+}
+
+// True when the sidecar remind_file<suffix> is stamped with the list as it
+// is now. The stamp follows the 16-byte magic, version and header size.
+int sidecar_is_current(const char* suffix) {
+    char path[MAX_PATH_SIZE];
+    snprintf(path, sizeof(path), "%s%s", remind_file, suffix);
+    struct {
+        uint64_t size;
+        int64_t mtime_sec;
+        int64_t mtime_nsec;
+        uint64_t ino;
+        uint64_t dev;
+    } stamp;
+    struct stat st;
+    FILE* fp = fopen(path, "r");
+    int ok = fp && fseek(fp, 16, SEEK_SET) == 0 && fread(&stamp, sizeof(stamp), 1, fp) == 1 &&
+             stat(remind_file, &st) == 0;
+    if (fp) fclose(fp);
+    return ok && stamp.size == (uint64_t) st.st_size && stamp.mtime_sec == (int64_t) st.st_mtime &&
+           stamp.mtime_nsec == (int64_t) st.st_mtim.tv_nsec && stamp.ino == (uint64_t) st.st_ino &&
+           stamp.dev == (uint64_t) st.st_dev;
+}
+
+// Test 16: -c serves an unchanged list from the render cache
+void test_render_cache() {
+    printf("Test 16: Render cache for -c\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char cache_file[MAX_PATH_SIZE];
+    snprintf(cache_file, sizeof(cache_file), "%s.cache", remind_file);
+
+    write_file(remind_file, "cached item\n");
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int built = file_exists(cache_file) && strstr(output, "1. cached item") != NULL;
+
+    // Tamper with the cached bytes; a cache hit must print them verbatim
+    FILE* fp = fopen(cache_file, "r+");
+    int tampered = 0;
+    if (fp) {
+        fseek(fp, -6, SEEK_END);  // "item\n\n"
+        fputs("XXXX", fp);
+        fclose(fp);
+        run_command(cmd, output, sizeof(output));
+        tampered = strstr(output, "cached XXXX") != NULL;
+    }
+
+    // Any change to the list must bypass the stale cache
+    write_file(remind_file, "fresh item\n");
+    run_command(cmd, output, sizeof(output));
+    int refreshed = strstr(output, "1. fresh item") != NULL;
+
+    if (built && tampered && refreshed) {
+        pass_test("");
+    } else {
+        fail_test("", "Should reuse the cached rendering only while the list is unchanged");
+    }
+
+    unlink(remind_file);
+    unlink(cache_file);
+}
+
+// Test 17: --count and -q for prompt integration
+void test_count_and_quiet() {
+    printf("Test 17: --count and -q\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char count_file[MAX_PATH_SIZE];
+    snprintf(count_file, sizeof(count_file), "%s.count", remind_file);
+
+    write_file(remind_file, "");
+    snprintf(cmd, sizeof(cmd), "%s -q", binary_path);
+    int empty_quiet = run_command(cmd, output, sizeof(output)) == 1 && strlen(output) == 0;
+
+    write_file(remind_file, "one\ntwo\nthree");
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s --count", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int counted = strcmp(output, "3\n") == 0 && file_exists(count_file);
+
+    // Overwrite the stored count; adds and deletes must carry it forward
+    FILE* fp = fopen(count_file, "r+");
+    unsigned long long fake = 100;
+    if (fp) {
+        fseek(fp, -(long) sizeof(fake), SEEK_END);
+        fwrite(&fake, sizeof(fake), 1, fp);
+        fclose(fp);
+    }
+    snprintf(cmd, sizeof(cmd), "%s -a four && %s -a five && %s -d 1 && %s --count",
+             binary_path, binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int incremental = strcmp(output, "101\n") == 0;
+
+    // A change made behind remind's back falls back to counting newlines
+    write_file(remind_file, "only\n");
+    snprintf(cmd, sizeof(cmd), "%s --count", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int recounted = strcmp(output, "1\n") == 0;
+
+    snprintf(cmd, sizeof(cmd), "%s -q", binary_path);
+    int any_quiet = run_command(cmd, output, sizeof(output)) == 0 && strlen(output) == 0;
+
+    if (empty_quiet && counted && incremental && recounted && any_quiet) {
+        pass_test("");
+    } else {
+        fail_test("", "Should count reminders and keep the stored count in step");
+    }
+
+    unlink(remind_file);
+    unlink(count_file);
+}
+
+// Test 18: REMIND_TRACE reports phases and counters without touching stdout
+void test_trace_report() {
+    printf("Test 18: REMIND_TRACE report\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char plain[MAX_OUTPUT_SIZE];
+    char traced[MAX_OUTPUT_SIZE];
+    char trace_file[MAX_PATH_SIZE];
+    snprintf(trace_file, sizeof(trace_file), "%s/trace.log", test_home);
+
+    write_file(remind_file, "traced item\n");
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, plain, sizeof(plain));
+
+    // A path appends the report to that file, leaving stdout untouched
+    snprintf(cmd, sizeof(cmd), "REMIND_TRACE=%s %s -c", trace_file, binary_path);
+    run_command(cmd, traced, sizeof(traced));
+    int same_output = strcmp(plain, traced) == 0;
+    int to_file = file_contains(trace_file, "remind trace:") &&
+                  file_contains(trace_file, "render=") &&
+                  file_contains(trace_file, "syscalls=");
+
+    // Any other value reports to stderr
+    snprintf(cmd, sizeof(cmd), "REMIND_TRACE=1 %s --count 2>&1 >/dev/null", binary_path);
+    run_command(cmd, traced, sizeof(traced));
+    int to_stderr = strstr(traced, "remind trace:") != NULL;
+
+    // And without it nothing extra is printed
+    snprintf(cmd, sizeof(cmd), "%s --count 2>&1 >/dev/null", binary_path);
+    run_command(cmd, traced, sizeof(traced));
+    int silent = strlen(traced) == 0;
+
+    if (same_output && to_file && to_stderr && silent) {
+        pass_test("");
+    } else {
+        fail_test("", "Tracing should report to stderr or a file and stay silent when off");
+    }
+
+    unlink(trace_file);
+    unlink(remind_file);
+}
+
+// Test 19: REMIND_STORAGE=log deletes by tombstone and compacts for $EDITOR
+void test_log_storage() {
+    printf("Test 19: Tombstone deletes with REMIND_STORAGE=log\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char tomb_file[MAX_PATH_SIZE];
+    snprintf(tomb_file, sizeof(tomb_file), "%s.tomb", remind_file);
+
+    write_file(remind_file, "item 1\nitem 2\nitem 3\nitem 4\nitem 5\nitem 6\nitem 7\nitem 8\n");
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=log %s -d 3", binary_path);
+    run_command(cmd, output, sizeof(output));
+    // The list itself is untouched; only a tombstone was written
+    int logged = count_lines(remind_file) == 8 && file_exists(tomb_file);
+
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int renumbered = strstr(output, "3. item 4") != NULL && strstr(output, "item 3") == NULL;
+    snprintf(cmd, sizeof(cmd), "%s --count", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int counted = strcmp(output, "7\n") == 0;
+
+    // The editor sees a plain list with the deleted line really gone
+    snprintf(cmd, sizeof(cmd), "EDITOR=true %s", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int compacted = count_lines(remind_file) == 7 && !file_exists(tomb_file) &&
+                    !file_contains(remind_file, "item 3");
+
+    if (logged && renumbered && counted && compacted) {
+        pass_test("");
+    } else {
+        fail_test("", "Log storage should hide deleted lines until compaction removes them");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 20: REMIND_STORAGE=chunked keeps the list in chunks behind the same CLI
+void test_chunked_storage() {
+    printf("Test 20: Chunked storage with REMIND_STORAGE=chunked\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char manifest[MAX_PATH_SIZE];
+    snprintf(manifest, sizeof(manifest), "%s.chunks/manifest", remind_file);
+
+    write_file(remind_file, "item 1\nitem 2\n");
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=chunked %s -a 'item 3' && %s -d 1 && %s -a 'item 4'",
+             binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int moved = !file_exists(remind_file) && file_exists(manifest);
+
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int shown = strstr(output, "1. item 2") != NULL && strstr(output, "3. item 4") != NULL;
+    snprintf(cmd, sizeof(cmd), "%s --count", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int counted = strcmp(output, "3\n") == 0;
+
+    // $EDITOR gets the chunks joined back into a plain file
+    snprintf(cmd, sizeof(cmd), "EDITOR=true %s", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int joined = file_exists(remind_file) && !file_exists(manifest) && count_lines(remind_file) == 3;
+
+    if (moved && shown && counted && joined) {
+        pass_test("");
+    } else {
+        fail_test("", "Chunked storage should behave like the plain list and join back for the editor");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 21: --head, --tail and --range show part of the list, numbered as in full
+void test_windows() {
+    printf("Test 21: --head, --tail and --range\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "a\nb\nc\nd\ne\nf\ng\nh\ni\na much longer last reminder\n");
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    size_t full_width = strcspn(output, "\n");
+
+    snprintf(cmd, sizeof(cmd), "%s --head 2", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int head = strstr(output, "1. a\n2. b\n\n") != NULL && strstr(output, "3.") == NULL &&
+               strcspn(output, "\n") < full_width;
+
+    snprintf(cmd, sizeof(cmd), "%s --tail 2", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int tail = strstr(output, "9. i\n10. a much longer last reminder\n\n") != NULL &&
+               strstr(output, "8.") == NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s --range 4-5 && %s --range 99", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int range = strstr(output, "4. d\n5. e\n\n") != NULL && strstr(output, "6.") == NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s --range 5-4 2>&1", binary_path);
+    int rejected = run_command(cmd, output, sizeof(output)) == 1 && strstr(output, "Invalid") != NULL;
+
+    // The line index built for a window follows adds and edits right away
+    char index_file[MAX_PATH_SIZE];
+    snprintf(index_file, sizeof(index_file), "%s.index", remind_file);
+    unlink(index_file);
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s --range 2-3", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int indexed = sidecar_is_current(".index");
+    snprintf(cmd, sizeof(cmd), "%s -a k", binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".index");
+    snprintf(cmd, sizeof(cmd), "%s -e 2 bee && %s --range 11", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".index") && strstr(output, "11. k\n") != NULL;
+    unlink(index_file);
+
+    // A list that cannot be read is an error, not an empty window
+    char manifest[MAX_PATH_SIZE];
+    snprintf(manifest, sizeof(manifest), "%s.chunks", remind_file);
+    mkdir(manifest, 0755);
+    snprintf(manifest, sizeof(manifest), "%s.chunks/manifest", remind_file);
+    write_file(manifest, "not a manifest, but long enough to look like one\n");
+    unlink(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s --range 1-2 2>&1", binary_path);
+    int failed = run_command(cmd, output, sizeof(output)) == 1 && strstr(output, "not a chunk manifest") != NULL;
+    snprintf(cmd, sizeof(cmd), "rm -rf %s.chunks", remind_file);
+    system(cmd);
+
+    if (head && tail && range && rejected && indexed && failed) {
+        pass_test("");
+    } else {
+        fail_test("", "Windows should show only their lines, numbered as in the full list");
+    }
+
+    unlink(remind_file);
+}
+
+// Test 22: -s lists matching reminders under their original numbers
+void test_search() {
+    printf("Test 22: -s search with -i and regexes\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "Buy milk\ncall Bob\nMILKshake\nfix bug 12\n");
+    snprintf(cmd, sizeof(cmd), "%s -s milk", binary_path);
+    int found = run_command(cmd, output, sizeof(output)) == 0 &&
+                strstr(output, "1. Buy milk\n\n") != NULL && strstr(output, "MILK") == NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s -i -s milk", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int folded = strstr(output, "1. Buy milk\n3. MILKshake\n\n") != NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s -s '^[a-z]+ b(ob|ug)'", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int regex = strstr(output, "4. fix bug 12\n") != NULL && strstr(output, "2.") == NULL;
+
+    // Like grep: status 1 and no output when nothing matches
+    snprintf(cmd, sizeof(cmd), "%s -s nothing", binary_path);
+    int missing = run_command(cmd, output, sizeof(output)) == 1 && strlen(output) == 0;
+    snprintf(cmd, sizeof(cmd), "%s -s 'a(b' 2>&1", binary_path);
+    int rejected = run_command(cmd, output, sizeof(output)) == 1 && strstr(output, "Invalid pattern") != NULL;
+
+    // Once REMIND_TRIGRAMS has built the index, adds and deletes keep it
+    // current instead of leaving it for the next search to rebuild
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "REMIND_TRIGRAMS=1 %s -s milk", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int indexed = sidecar_is_current(".trigrams");
+    snprintf(cmd, sizeof(cmd), "%s -a 'oat milk'", binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".trigrams");
+    snprintf(cmd, sizeof(cmd), "%s -d 2", binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".trigrams");
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=log %s -d 1 && %s -s milk", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".trigrams") && strstr(output, "\n3. oat milk\n\n") != NULL;
+
+    if (found && folded && regex && missing && rejected && indexed) {
+        pass_test("");
+    } else {
+        fail_test("", "Search should list matching reminders with their own numbers");
+    }
+
+    snprintf(cmd, sizeof(cmd), "%s.tomb", remind_file);
+    unlink(cmd);
+    snprintf(cmd, sizeof(cmd), "%s.trigrams", remind_file);
+    unlink(cmd);
+    unlink(remind_file);
+}
+
+// Test 23: -t lists the reminders carrying a +tag, and -d still takes
+// the numbers it shows
+void test_tags() {
+    printf("Test 23: -t tag listing\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "");
+    snprintf(cmd, sizeof(cmd), "%s -a '+work deploy review' -a 'buy milk +home' -a 'a+work no' -a 'ship it +work'",
+             binary_path);
+    run_command(cmd, output, sizeof(output));
+    snprintf(cmd, sizeof(cmd), "%s -c -t work", binary_path);
+    int listed = run_command(cmd, output, sizeof(output)) == 0 &&
+                 strstr(output, "1. +work deploy review\n4. ship it +work\n\n") != NULL &&
+                 strstr(output, "a+work") == NULL;
+
+    // The tag index built by -t on a settled list follows adds and deletes
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s -t work && %s -a 'plan +work'", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int indexed = sidecar_is_current(".tags");
+
+    snprintf(cmd, sizeof(cmd), "%s -d 1", binary_path);
+    run_command(cmd, output, sizeof(output));
+    indexed = indexed && sidecar_is_current(".tags");
+    snprintf(cmd, sizeof(cmd), "%s -t +work", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int renumbered = strstr(output, "3. ship it +work\n4. plan +work\n\n") != NULL &&
+                     strstr(output, "deploy") == NULL;
+
+    // No matches is an empty listing, not an error; a bad tag is
+    snprintf(cmd, sizeof(cmd), "%s -t nothing", binary_path);
+    int empty = run_command(cmd, output, sizeof(output)) == 0 && strlen(output) == 0;
+    snprintf(cmd, sizeof(cmd), "%s -t 'no tag' 2>&1", binary_path);
+    int rejected = run_command(cmd, output, sizeof(output)) == 1 && strstr(output, "Invalid tag") != NULL;
+
+    if (listed && indexed && renumbered && empty && rejected) {
+        pass_test("");
+    } else {
+        fail_test("", "-t should list tagged reminders with their own numbers");
+    }
+
+    snprintf(cmd, sizeof(cmd), "%s.tags", remind_file);
+    unlink(cmd);
+    unlink(remind_file);
+}
+
+// Test 24: -c leaves out reminders that are not due, --all shows them
+void test_due_dates() {
+    printf("Test 24: Due dates, recurrence and snooze\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "plain\npaid due:2000-01-01\nlater due:2999-01-01\nnap snooze:2999-01-01T10:00\n"
+                            "daily every:day\nnot a date due:2026-02-30\n");
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int due = strstr(output, "1. plain\n2. paid due:2000-01-01\n5. daily every:day\n6. not a date") != NULL &&
+              strstr(output, "later") == NULL && strstr(output, "nap") == NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s --all", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int all = strstr(output, "3. later due:2999-01-01\n4. nap snooze:2999-01-01T10:00\n") != NULL;
+
+    // The due heap built by -c on a settled list follows adds and deletes
+    age_file(remind_file);
+    snprintf(cmd, sizeof(cmd), "%s -c && %s -a 'soon due:2999-06-01'", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int heaped = sidecar_is_current(".due");
+    snprintf(cmd, sizeof(cmd), "%s -d 7 && %s --count", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    heaped = heaped && sidecar_is_current(".due") && strcmp(output, "4\n") == 0;
+
+    // --count counts what -c shows, also once a hidden line is tombstoned
+    snprintf(cmd, sizeof(cmd), "%s --count && REMIND_STORAGE=log %s -d 3 && %s --count",
+             binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int counted = strcmp(output, "4\n4\n") == 0;
+
+    // Nothing due prints nothing, like an empty list
+    write_file(remind_file, "later due:2999-01-01\n");
+    snprintf(cmd, sizeof(cmd), "%s -c", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int quiet = strlen(output) == 0;
+    snprintf(cmd, sizeof(cmd), "%s -q", binary_path);
+    quiet = quiet && run_command(cmd, output, sizeof(output)) == 1;
+
+    if (due && all && counted && heaped && quiet) {
+        pass_test("");
+    } else {
+        fail_test("", "-c should show only the reminders that are due");
+    }
+
+    snprintf(cmd, sizeof(cmd), "%s.due", remind_file);
+    unlink(cmd);
+    unlink(remind_file);
+}
+
+// Test 25: --daemon runs the hook when a reminder comes due
+void test_daemon() {
+    printf("Test 25: Daemon announces reminders as they come due\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char notes[MAX_PATH_SIZE];
+    char hook[MAX_CMD_SIZE];
+    snprintf(notes, sizeof(notes), "%s/notes", test_home);
+    snprintf(hook, sizeof(hook), "echo \"$REMIND_LINE $REMIND_TEXT\" >> %s", notes);
+    unlink(notes);
+
+    write_file(remind_file, "plain\n");
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execl(binary_path, "remind", "--notify", hook, (char *) NULL);
+        _exit(127);
+    }
+    usleep(200000);
+
+    // Added after the daemon started, due two seconds from now
+    char when[32];
+    time_t soon = time(NULL) + 2;
+    strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", localtime(&soon));
+    snprintf(cmd, sizeof(cmd), "%s -a \"tea due:%s\"", binary_path, when);
+    run_command(cmd, output, sizeof(output));
+
+    char expected[64];
+    snprintf(expected, sizeof(expected), "2 tea due:%s\n", when);
+    int announced = 0;
+    for (int i = 0; i < 50 && !announced; i++) {
+        usleep(100000);
+        FILE *fp = fopen(notes, "r");
+        if (fp) {
+            size_t n = fread(output, 1, sizeof(output) - 1, fp);
+            output[n] = '\0';
+            fclose(fp);
+            announced = strcmp(output, expected) == 0;
+        }
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (announced) {
+        pass_test("");
+    } else {
+        fail_test("", "the hook should run once when the reminder comes due");
+    }
+
+    unlink(notes);
+    unlink(remind_file);
+}
+
+// Test 26: --serve answers -c, --count, -a and -d, and sees outside edits
+void test_serve() {
+    printf("Test 26: Server keeps the list in memory\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char sock[MAX_PATH_SIZE];
+    snprintf(sock, sizeof(sock), "%s.sock", remind_file);
+
+    write_file(remind_file, "one\nlater due:2999-01-01\n");
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execl(binary_path, "remind", "--serve", (char *) NULL);
+        _exit(127);
+    }
+    for (int i = 0; i < 50 && !file_exists(sock); i++) {
+        usleep(20000);
+    }
+    int listening = file_exists(sock);
+
+    snprintf(cmd, sizeof(cmd), "%s -a two && %s -d 1 && %s -c", binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int served = strstr(output, "2. two\n") != NULL && strstr(output, "one") == NULL &&
+                 strstr(output, "later") == NULL && file_contains(remind_file, "later due:2999-01-01");
+
+    // Edits that bypass the server are picked up on the next request
+    FILE *fp = fopen(remind_file, "a");
+    fputs("three\n", fp);
+    fclose(fp);
+    snprintf(cmd, sizeof(cmd), "%s -c && %s --count", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int fresh = strstr(output, "2. two\n3. three\n") != NULL && strstr(output, "\n2\n") != NULL;
+
+    // The server's complaint comes back on the client's stderr
+    snprintf(cmd, sizeof(cmd), "%s -d 9 2>&1", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int relayed = strstr(output, "No reminder at line 9") != NULL;
+
+    // A chunked list changes inside reminders.chunks/, which is watched too
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=chunked %s -e 2 TWO && %s -c", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    snprintf(cmd, sizeof(cmd), "printf 'add four\\n' | %s --batch - && %s -e 3 THREE && %s -c && %s --count",
+             binary_path, binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int chunked = strstr(output, "2. TWO\n3. THREE\n4. four\n") != NULL && strstr(output, "\n3\n") != NULL;
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    int removed = !file_exists(sock);
+
+    if (listening && served && fresh && relayed && chunked && removed) {
+        pass_test("");
+    } else {
+        fail_test("", "requests should go through the server and see every change");
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s.chunks", remind_file);
+    system(cmd);
+    unlink(remind_file);
+}
+
+// Test 27: -w redraws only the rows that changed
+void test_watch() {
+    printf("Test 27: Watch mode redraws changed rows\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char screen[MAX_PATH_SIZE];
+    snprintf(screen, sizeof(screen), "%s/screen", test_home);
+
+    write_file(remind_file, "one\ntwo\n");
+    pid_t pid = fork();
+    if (pid == 0) {
+        int screen_fd = open(screen, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(screen_fd, STDOUT_FILENO);
+        execl(binary_path, "remind", "-w", (char *) NULL);
+        _exit(127);
+    }
+    usleep(200000);
+    snprintf(cmd, sizeof(cmd), "%s -a three", binary_path);
+    run_command(cmd, output, sizeof(output));
+    usleep(200000);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    read_file(screen, output, sizeof(output));
+    // The first frame draws everything; the add only rewrites rows 6 and 7
+    const char *first = "2. two\033[K\033[6;1H\033[K";
+    const char *rows = "\033[6;1H3. three\033[K\033[7;1H\033[K\033[?25h";
+    const char *update = strstr(output, first);
+    int incremental = update && strncmp(update + strlen(first), rows, strlen(rows)) == 0;
+    int restored = strstr(output, "\033[?1049l") != NULL;
+
+    // An edit of a chunked list only touches reminders.chunks/
+    write_file(remind_file, "one\n");
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=chunked %s -a two", binary_path);
+    run_command(cmd, output, sizeof(output));
+    pid = fork();
+    if (pid == 0) {
+        int screen_fd = open(screen, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        dup2(screen_fd, STDOUT_FILENO);
+        execl(binary_path, "remind", "-w", (char *) NULL);
+        _exit(127);
+    }
+    usleep(200000);
+    snprintf(cmd, sizeof(cmd), "%s -e 2 TWO", binary_path);
+    run_command(cmd, output, sizeof(output));
+    usleep(200000);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    read_file(screen, output, sizeof(output));
+    int chunked = strstr(output, "\033[5;1H2. TWO\033[K") != NULL;
+
+    if (incremental && restored && chunked) {
+        pass_test("");
+    } else {
+        fail_test("", "-w should redraw only the rows that changed");
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s.chunks", remind_file);
+    system(cmd);
+    unlink(screen);
+    unlink(remind_file);
+}
+
+// Test 28: --batch applies commands in order, all or nothing
+void test_batch() {
+    printf("Test 28: Batch commands against one load of the list\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char contents[MAX_OUTPUT_SIZE];
+
+    // Each command numbers the list as the ones before it left it
+    write_file(remind_file, "one\ntwo\nthree\nfour\n");
+    snprintf(cmd, sizeof(cmd), "printf '# tidy up\\nadd five\\ndelete 1,3\\nmove 3 1\\nedit 2 TWO\\ncheck\\n' | %s --batch -",
+             binary_path);
+    run_command(cmd, output, sizeof(output));
+    read_file(remind_file, contents, sizeof(contents));
+    int applied = strcmp(contents, "five\nTWO\nfour\n") == 0 && strstr(output, "1. five\n2. TWO\n3. four\n") != NULL;
+
+    // A failing command leaves the list as it was, and prints no checks
+    snprintf(cmd, sizeof(cmd), "printf 'add six\\ncheck\\nedit 9 nine\\n' | %s --batch - 2>&1", binary_path);
+    int status = run_command(cmd, output, sizeof(output));
+    read_file(remind_file, contents, sizeof(contents));
+    int atomic = status == 1 && strstr(output, "batch line 3") != NULL && strstr(output, "six") == NULL &&
+                 strcmp(contents, "five\nTWO\nfour\n") == 0;
+
+    // Without the lock nothing is written at all
+    char lock_file[MAX_PATH_SIZE];
+    snprintf(lock_file, sizeof(lock_file), "%s.lock", remind_file);
+    unlink(lock_file);
+    mkdir(lock_file, 0755);
+    snprintf(cmd, sizeof(cmd), "printf 'add six\\n' | %s --batch - 2>&1", binary_path);
+    status = run_command(cmd, output, sizeof(output));
+    rmdir(lock_file);
+    read_file(remind_file, contents, sizeof(contents));
+    int locked = status == 1 && strstr(output, "nothing was changed") != NULL &&
+                 strcmp(contents, "five\nTWO\nfour\n") == 0;
+
+    // A chunked list stays chunked, and a batch that only checks writes nothing
+    char manifest[MAX_PATH_SIZE];
+    struct stat before, checked, after;
+    snprintf(manifest, sizeof(manifest), "%s.chunks/manifest", remind_file);
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=chunked %s -a six", binary_path);
+    run_command(cmd, output, sizeof(output));
+    stat(manifest, &before);
+    snprintf(cmd, sizeof(cmd), "printf 'check\\n' | %s --batch -", binary_path);
+    run_command(cmd, output, sizeof(output));
+    int untouched = strstr(output, "4. six\n") != NULL && stat(manifest, &checked) == 0 &&
+                    checked.st_ino == before.st_ino;
+    snprintf(cmd, sizeof(cmd), "printf 'delete 1\\n' | %s --batch - && %s -c", binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int chunked = untouched && !file_exists(remind_file) && stat(manifest, &after) == 0 &&
+                  after.st_ino != before.st_ino && strstr(output, "1. TWO\n2. four\n3. six\n") != NULL;
+
+    if (applied && atomic && locked && chunked) {
+        pass_test("");
+    } else {
+        fail_test("", "--batch should apply every command in order or none");
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s.chunks", remind_file);
+    system(cmd);
+    unlink(remind_file);
+}
+
+// Test 29: -e replaces one reminder's text and keeps its place
+void test_edit_line() {
+    printf("Test 29: Edit a reminder in place\n");
+
+    char cmd[MAX_CMD_SIZE];
+    char output[MAX_OUTPUT_SIZE];
+    char contents[MAX_OUTPUT_SIZE];
+
+    write_file(remind_file, "one\ntwo\nthree\n");
+    snprintf(cmd, sizeof(cmd), "%s -e 2 'TWO' && %s -e 1 'the first one' && %s -e 3 '3' && %s -c",
+             binary_path, binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    read_file(remind_file, contents, sizeof(contents));
+    int edited = strcmp(contents, "the first one\nTWO\n3\n") == 0 && strstr(output, "2. TWO\n") != NULL;
+
+    snprintf(cmd, sizeof(cmd), "%s -e 7 'nope' 2>&1", binary_path);
+    int status = run_command(cmd, output, sizeof(output));
+    int missing = status == 1 && strstr(output, "No reminder at line 7") != NULL;
+
+    // Tombstones stay on the lines they deleted when the bytes move
+    write_file(remind_file, "a\nb\nc\nd\n");
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=log %s -d 3 && %s -e 1 'a much longer a' && %s -e 2 'B' && %s -c",
+             binary_path, binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    read_file(remind_file, contents, sizeof(contents));
+    int logged = strcmp(contents, "a much longer a\nB\nc\nd\n") == 0 &&
+                 strstr(output, "1. a much longer a\n2. B\n3. d\n") != NULL;
+
+    // A chunked list is edited in its chunks
+    char manifest[MAX_PATH_SIZE];
+    snprintf(manifest, sizeof(manifest), "%s.chunks/manifest", remind_file);
+    snprintf(cmd, sizeof(cmd), "REMIND_STORAGE=chunked %s -a e && %s -e 4 'E' && %s -c",
+             binary_path, binary_path, binary_path);
+    run_command(cmd, output, sizeof(output));
+    int chunked = !file_exists(remind_file) && file_exists(manifest) &&
+                  strstr(output, "1. a much longer a\n2. B\n3. d\n4. E\n") != NULL;
+
+    if (edited && missing && logged && chunked) {
+        pass_test("");
+    } else {
+        fail_test("", "-e should replace exactly the one reminder");
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s.chunks", remind_file);
+    system(cmd);
+    unlink(remind_file);
+}
+
 int main(int argc, char* argv[]) {
     printf("Simple Functional Tests for Remind (C Version)\n");
     printf("==============================================\n");
@@ -285,6 +1294,27 @@ int main(int argc, char* argv[]) {
     test_display_after_deletion();
     test_help_short_flag();
     test_help_long_flag();
+    test_no_fork_directory_setup();
+    test_check_startup_latency();
+    test_large_list_no_limits();
+    test_delete_splice_keeps_blank_lines();
+    test_delete_ranges();
+    test_bulk_add_from_stdin();
+    test_concurrent_add_delete();
+    test_render_cache();
+    test_count_and_quiet();
+    test_trace_report();
+    test_log_storage();
+    test_chunked_storage();
+    test_windows();
+    test_search();
+    test_tags();
+    test_due_dates();
+    test_daemon();
+    test_serve();
+    test_watch();
+    test_batch();
+    test_edit_line();
 
     // Cleanup
     cleanup_test_env();